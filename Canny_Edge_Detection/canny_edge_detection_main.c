@@ -1,3 +1,15 @@
+/****************************************************************************************************************
+This file contains the source code for a Canny edge detection. It detects edges in raw video files
+(256 x 256 pixels frame size by default, see --geometry, 2 bytes per pixel) and writes one byte per pixel edge maps (0 or 255).
+
+The pipeline (Gaussian smoothing, Sobel gradients, non-maximum suppression, double-threshold hysteresis)
+runs over each frame as a stream of rows. Every stage keeps only the few rows its neighbour needs in a small
+ring of line buffers, so the intermediate images stay in L1/L2 and only the final edge map is written out.
+Hysteresis links edges as connected components: a union-find pass per tile (in parallel with OpenMP),
+then a merge along the tile borders.
+****************************************************************************************************************/
+
+/* standard c libraries */
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -5,70 +17,1920 @@
 #include <time.h>
 #include <string.h>
 
-#define IMAGE_WIDTH 256
-#define IMAGE_HEIGHT 256
-#define DIM 65536 //IMAGE_WIDTH * IMAGE_HEIGHT
+/* shared project sources */
+#include "cli_options.h"
+#include "frame_geometry.h"
+#include "frame_metrics.h"
+#include "frame_pipeline.h"
+#include "frame_source.h"
+#include "frame_writer.h"
+#include "thread_placement.h"
+
+/* x86 SIMD intrinsics, kernels are compiled per target and selected at runtime */
+#if defined(__x86_64__) || defined(__i386__)
+#define CANNY_X86 1
+#include <immintrin.h>
+#else
+#define CANNY_X86 0
+#endif
+
+#define CANNY_SIGMA 1.0f // standard deviation of the Gaussian
+#define CANNY_LOW_THRESHOLD 800.0f // default weak edge threshold on gradient magnitude
+#define CANNY_HIGH_THRESHOLD 2000.0f // default strong edge threshold on gradient magnitude
+
+#define CANNY_TAN_22_5 0.41421356f // tan(22.5 deg), boundary between horizontal and diagonal directions
+#define CANNY_TAN_67_5 2.41421356f // tan(67.5 deg), boundary between diagonal and vertical directions
+
+/* arithmetic modes */
+#define CANNY_MODE_FLOAT 0 // float pipeline, L2 magnitude (the reference)
+#define CANNY_MODE_FIXED_L1 1 // fixed-point pipeline, L1 magnitude |gx| + |gy|
+#define CANNY_MODE_FIXED_L2 2 // fixed-point pipeline, squared L2 magnitude gx^2 + gy^2
+
+/*
+    Fixed-point format. Gaussian weights are integers summing to 1 << CANNY_GAUSSIAN_BITS. Smoothed pixels
+    keep CANNY_FRACTION_BITS fractional bits, so for any 16-bit input smoothed values stay below 2^20,
+    Sobel gradients within +-2^22 (int32) and L1 magnitudes below 2^23. Squared L2 magnitudes reach 2^45
+    and are stored >> CANNY_L2_SHIFT to fit in 32 bits.
+
+    Tolerance: both modes use the same integer Gaussian weights, so they differ only by rounding. Fixed-point
+    magnitudes, converted back to pixel units, stay within CANNY_FIXED_TOLERANCE_L1 (L1) or
+    CANNY_FIXED_TOLERANCE_L2 (squared L2, one step of the shifted square near zero) plus
+    CANNY_FIXED_TOLERANCE_RELATIVE of the float magnitude in the same norm. The driver checks this on a
+    full-range noise frame and on the first frame. With the same thresholds, fixed-l2 edge maps of
+    Cloud001_10.raw differ from float ones in under 0.01% of pixels.
+*/
+#define CANNY_GAUSSIAN_BITS 10
+#define CANNY_FRACTION_BITS 4
+#define CANNY_HBLUR_SHIFT 6 // CANNY_GAUSSIAN_BITS - CANNY_FRACTION_BITS
+#define CANNY_L2_SHIFT 14
+#define CANNY_TAN_22_5_Q7 53 // tan(22.5 deg) * 128, rounded
+#define CANNY_TAN_67_5_Q7 309 // tan(67.5 deg) * 128, rounded
+#define CANNY_FIXED_TOLERANCE_L1 1.0f
+#define CANNY_FIXED_TOLERANCE_L2 8.0f // sqrt(1 << CANNY_L2_SHIFT) / (1 << CANNY_FRACTION_BITS)
+#define CANNY_FIXED_TOLERANCE_RELATIVE 0.01f
+
+/* line buffer ring sizes (rows kept per stage) */
+#define CANNY_HBLUR_ROWS 5 // vertical Gaussian pass needs 5 horizontally blurred rows
+#define CANNY_SMOOTH_ROWS 3 // Sobel needs 3 smoothed rows
+#define CANNY_GRADIENT_ROWS 3 // non-maximum suppression needs 3 magnitude rows
+
+#define CANNY_TILE_SIZE 64 // hysteresis tiles are CANNY_TILE_SIZE x CANNY_TILE_SIZE pixels
+
+/* incremental mode */
+#define CANNY_DELTA_TILE_SIZE 32 // change detection tiles are CANNY_DELTA_TILE_SIZE x CANNY_DELTA_TILE_SIZE pixels
+#define CANNY_HALO 4 // reach of one input pixel on the classes: Gaussian 2 + Sobel 1 + non-maximum suppression 1
+#define CANNY_WINDOW_ROWS 48 // CANNY_DELTA_TILE_SIZE + 4 * CANNY_HALO, rows of the window recomputed for one tile row
+#define CANNY_DELTA_FULL_FRAME_DIVISOR 2 // recompute the whole frame once more than 1/2 of the tiles changed
+
+/* gradient directions, named after the neighbours compared in non-maximum suppression */
+#define CANNY_DIR_0 0 // left/right
+#define CANNY_DIR_45 1 // up-left/down-right
+#define CANNY_DIR_90 2 // up/down
+#define CANNY_DIR_135 3 // up-right/down-left
+
+/* pixel classes in the edge map */
+#define CANNY_NONE 0
+#define CANNY_WEAK 1
+#define CANNY_STRONG 2
+#define CANNY_EDGE 255
+
+struct canny_params_struct {
+    int mode; // CANNY_MODE_FLOAT, CANNY_MODE_FIXED_L1 or CANNY_MODE_FIXED_L2
+    float gaussian[3]; // 5-tap Gaussian weights: center, +-1, +-2
+    float low_threshold; // magnitude >= low_threshold is a weak edge
+    float high_threshold; // magnitude >= high_threshold is a strong edge
+    int32_t gaussian_fixed[3]; // integer Gaussian weights, sum is 1 << CANNY_GAUSSIAN_BITS
+    uint32_t low_threshold_fixed; // low_threshold in the fixed-point magnitude format of mode
+    uint32_t high_threshold_fixed; // high_threshold in the fixed-point magnitude format of mode
+};
+
+/* row kernels for the separable Gaussian and Sobel passes, one set per instruction set */
+struct canny_kernels_struct {
+    const char *name;
+    void (*gaussian_horizontal_row)(const uint16_t *in, float *out, int width, const float *gaussian);
+    void (*gaussian_vertical_row)(const float *r0, const float *r1, const float *r2, const float *r3, const float *r4,
+                                  float *out, int width, const float *gaussian);
+    void (*sobel_row)(const float *s0, const float *s1, const float *s2, float *magnitude, uint8_t *direction, int width);
+    void (*gaussian_horizontal_row_fixed)(const uint16_t *in, int32_t *out, int width, const int32_t *gaussian);
+    void (*gaussian_vertical_row_fixed)(const int32_t *r0, const int32_t *r1, const int32_t *r2, const int32_t *r3,
+                                        const int32_t *r4, int32_t *out, int width, const int32_t *gaussian);
+    void (*sobel_row_fixed)(const int32_t *s0, const int32_t *s1, const int32_t *s2, uint32_t *magnitude, uint8_t *direction,
+                            int width, int mode);
+};
+
+struct canny_workspace_struct;
+
+/* whole-frame classify functions compiled for one frame geometry, see CANNY_FRAME_PATH */
+struct canny_frame_path_struct {
+    int width;
+    int height;
+    void (*classify_float)(const uint16_t *frame, const struct canny_params_struct *params,
+                           struct canny_workspace_struct *workspace, uint8_t *edges);
+    void (*classify_fixed)(const uint16_t *frame, const struct canny_params_struct *params,
+                           struct canny_workspace_struct *workspace, uint8_t *edges);
+};
+
+struct canny_workspace_struct {
+    int width;
+    int height;
+    const struct canny_frame_path_struct *frame_path; // specialized classify functions for width x height, or NULL
+    const struct canny_kernels_struct *kernels; // Gaussian/Sobel kernels selected for this cpu
+    float *hblur_rows; // ring of CANNY_HBLUR_ROWS rows, horizontal Gaussian pass
+    float *smooth_rows; // ring of CANNY_SMOOTH_ROWS rows, full Gaussian
+    float *magnitude_rows; // ring of CANNY_GRADIENT_ROWS rows, gradient magnitude
+    int32_t *hblur_fixed_rows; // fixed-point mode counterparts of the three rings above
+    int32_t *smooth_fixed_rows;
+    uint32_t *magnitude_fixed_rows;
+    uint8_t *direction_rows; // ring of CANNY_GRADIENT_ROWS rows, quantized gradient direction
+    int32_t *parent; // hysteresis union-find forest, one node per pixel
+    uint8_t *rank; // union-find rank of every root
+    uint8_t *strong; // 1 if the component rooted here contains a strong pixel
+    int noise_threshold; // incremental mode: largest pixel change still treated as noise
+    int has_previous; // incremental mode: classes/previous_edges hold a previous frame
+    uint16_t *reference_frame; // incremental mode: pixels each tile's classes were computed from
+    uint8_t *classes; // incremental mode: non-maximum suppression classes of the whole frame
+    uint8_t *previous_edges; // incremental mode: edge map of the previous frame
+    uint8_t *window_classes; // incremental mode: classes of one recomputed window
+    uint8_t *changed_tiles; // incremental mode: 1 per tile that moved beyond the noise threshold
+    long tiles_total; // incremental mode statistics
+    long tiles_recomputed;
+    struct thread_placement_struct *placement; // credited with the tiles every thread labels, or NULL
+};
+
+/* converts a magnitude threshold in pixel units to the fixed-point magnitude format of mode */
+static uint32_t canny_threshold_fixed(float threshold, int mode)
+{
+    double scaled = (double) threshold * (1 << CANNY_FRACTION_BITS);
+
+    if (mode == CANNY_MODE_FIXED_L2) {
+        scaled = ceil(scaled * scaled / (1 << CANNY_L2_SHIFT));
+    }
+    else {
+        scaled = ceil(scaled);
+    }
+
+    return (scaled > (double) UINT32_MAX) ? UINT32_MAX : (uint32_t) scaled;
+}
+
+/* converts a fixed-point magnitude of mode back to pixel units */
+static float canny_magnitude_from_fixed(uint32_t magnitude, int mode)
+{
+    double value = magnitude;
+
+    if (mode == CANNY_MODE_FIXED_L2) {
+        value = sqrt(value * (1 << CANNY_L2_SHIFT));
+    }
+
+    return (float) (value / (1 << CANNY_FRACTION_BITS));
+}
+
+/********************************************************
+Computes normalized 5-tap Gaussian weights for sigma and
+converts the thresholds to the magnitude format of mode.
+The float weights are the integer weights / 2^10, so both
+modes run the same filter and differ only by rounding.
+Stores output in params.
+********************************************************/
+void canny_init_params(struct canny_params_struct *params, int mode, float sigma, float low_threshold, float high_threshold)
+{
+    float weights[3];
+    float sum = 0.0f;
+
+    for (int k = 0; k < 3; k++) {
+        weights[k] = expf(-(float) (k * k) / (2.0f * sigma * sigma));
+        sum += (k == 0) ? weights[k] : 2.0f * weights[k];
+    }
+
+    /* round the outer weights and give the remainder to the center so the sum is exact */
+    params->gaussian_fixed[1] = (int32_t) lrintf(weights[1] / sum * (1 << CANNY_GAUSSIAN_BITS));
+    params->gaussian_fixed[2] = (int32_t) lrintf(weights[2] / sum * (1 << CANNY_GAUSSIAN_BITS));
+    params->gaussian_fixed[0] = (1 << CANNY_GAUSSIAN_BITS) - 2 * (params->gaussian_fixed[1] + params->gaussian_fixed[2]);
+    for (int k = 0; k < 3; k++) {
+        params->gaussian[k] = (float) params->gaussian_fixed[k] / (1 << CANNY_GAUSSIAN_BITS);
+    }
+
+    params->mode = mode;
+    params->low_threshold = low_threshold;
+    params->high_threshold = high_threshold;
+    params->low_threshold_fixed = canny_threshold_fixed(low_threshold, mode);
+    params->high_threshold_fixed = canny_threshold_fixed(high_threshold, mode);
+
+    return;
+}
+
+/********************************************************
+Allocates line buffers and the hysteresis forest for
+width x height frames. Returns 0 on success.
+********************************************************/
+int canny_alloc_workspace(struct canny_workspace_struct *workspace, int width, int height)
+{
+    workspace->width = width;
+    workspace->height = height;
+    workspace->frame_path = NULL;
+    workspace->placement = NULL;
+    workspace->hblur_rows = (float*)malloc(sizeof(float)*CANNY_HBLUR_ROWS*width);
+    workspace->smooth_rows = (float*)malloc(sizeof(float)*CANNY_SMOOTH_ROWS*width);
+    workspace->magnitude_rows = (float*)malloc(sizeof(float)*CANNY_GRADIENT_ROWS*width);
+    workspace->hblur_fixed_rows = (int32_t*)malloc(sizeof(int32_t)*CANNY_HBLUR_ROWS*width);
+    workspace->smooth_fixed_rows = (int32_t*)malloc(sizeof(int32_t)*CANNY_SMOOTH_ROWS*width);
+    workspace->magnitude_fixed_rows = (uint32_t*)malloc(sizeof(uint32_t)*CANNY_GRADIENT_ROWS*width);
+    workspace->direction_rows = (uint8_t*)malloc(sizeof(uint8_t)*CANNY_GRADIENT_ROWS*width);
+    workspace->parent = (int32_t*)malloc(sizeof(int32_t)*width*height);
+    workspace->rank = (uint8_t*)malloc(sizeof(uint8_t)*width*height);
+    workspace->strong = (uint8_t*)malloc(sizeof(uint8_t)*width*height);
+    workspace->reference_frame = (uint16_t*)malloc(sizeof(uint16_t)*width*height);
+    workspace->classes = (uint8_t*)malloc(sizeof(uint8_t)*width*height);
+    workspace->previous_edges = (uint8_t*)malloc(sizeof(uint8_t)*width*height);
+    workspace->window_classes = (uint8_t*)malloc(sizeof(uint8_t)*CANNY_WINDOW_ROWS*width);
+    workspace->changed_tiles = (uint8_t*)malloc(sizeof(uint8_t)*((width + CANNY_DELTA_TILE_SIZE - 1) / CANNY_DELTA_TILE_SIZE)
+                                                *((height + CANNY_DELTA_TILE_SIZE - 1) / CANNY_DELTA_TILE_SIZE));
+    workspace->noise_threshold = 0;
+    workspace->has_previous = 0;
+    workspace->tiles_total = 0;
+    workspace->tiles_recomputed = 0;
+
+    if (workspace->hblur_rows == NULL || workspace->smooth_rows == NULL || workspace->magnitude_rows == NULL
+        || workspace->hblur_fixed_rows == NULL || workspace->smooth_fixed_rows == NULL
+        || workspace->magnitude_fixed_rows == NULL || workspace->direction_rows == NULL || workspace->parent == NULL
+        || workspace->rank == NULL || workspace->strong == NULL || workspace->reference_frame == NULL
+        || workspace->classes == NULL || workspace->previous_edges == NULL || workspace->window_classes == NULL
+        || workspace->changed_tiles == NULL) {
+        return 1;
+    }
+
+    return 0;
+}
+
+void canny_free_workspace(struct canny_workspace_struct *workspace)
+{
+    free(workspace->hblur_rows);
+    free(workspace->smooth_rows);
+    free(workspace->magnitude_rows);
+    free(workspace->hblur_fixed_rows);
+    free(workspace->smooth_fixed_rows);
+    free(workspace->magnitude_fixed_rows);
+    free(workspace->direction_rows);
+    free(workspace->parent);
+    free(workspace->rank);
+    free(workspace->strong);
+    free(workspace->reference_frame);
+    free(workspace->classes);
+    free(workspace->previous_edges);
+    free(workspace->window_classes);
+    free(workspace->changed_tiles);
+
+    return;
+}
+
+static inline int canny_clamp(int value, int low, int high)
+{
+    return (value < low) ? low : ((value > high) ? high : value);
+}
+
+/* returns the offset of row y (clamped to the frame) in a ring of line buffers holding ring_rows rows */
+static inline int canny_ring_offset(int ring_rows, int y, int height, int width)
+{
+    return (canny_clamp(y, 0, height - 1) % ring_rows) * width;
+}
+
+/********************************************************
+Horizontal 5-tap Gaussian pass over pixels [x0, x1) of
+one row of 16-bit pixels. Borders replicate the edge
+pixel. This is the scalar reference the SIMD kernels
+must match bit for bit.
+********************************************************/
+static void canny_gaussian_horizontal_span(const uint16_t *in, float *out, int width, const float *gaussian, int x0, int x1)
+{
+    for (int x = x0; x < x1; x++) {
+        float m2 = (float) in[canny_clamp(x - 2, 0, width - 1)];
+        float m1 = (float) in[canny_clamp(x - 1, 0, width - 1)];
+        float c = (float) in[x];
+        float p1 = (float) in[canny_clamp(x + 1, 0, width - 1)];
+        float p2 = (float) in[canny_clamp(x + 2, 0, width - 1)];
+
+        out[x] = gaussian[0] * c + gaussian[1] * (m1 + p1) + gaussian[2] * (m2 + p2);
+    }
+
+    return;
+}
+
+void canny_gaussian_horizontal_row(const uint16_t *in, float *out, int width, const float *gaussian)
+{
+    canny_gaussian_horizontal_span(in, out, width, gaussian, 0, width);
+
+    return;
+}
+
+/********************************************************
+Vertical 5-tap Gaussian pass combining five horizontally
+blurred rows r0..r4 into one smoothed row.
+********************************************************/
+void canny_gaussian_vertical_row(const float *r0, const float *r1, const float *r2, const float *r3, const float *r4,
+                                 float *out, int width, const float *gaussian)
+{
+    for (int x = 0; x < width; x++) {
+        out[x] = gaussian[0] * r2[x] + gaussian[1] * (r1[x] + r3[x]) + gaussian[2] * (r0[x] + r4[x]);
+    }
+
+    return;
+}
+
+/********************************************************
+Sobel gradients of pixels [x0, x1) of the middle of three
+smoothed rows. Stores the magnitude and the direction
+quantized to 0/45/90/135 degrees by slope comparison.
+********************************************************/
+static void canny_sobel_span(const float *s0, const float *s1, const float *s2, float *magnitude, uint8_t *direction,
+                             int width, int x0, int x1)
+{
+    for (int x = x0; x < x1; x++) {
+        int xm = canny_clamp(x - 1, 0, width - 1);
+        int xp = canny_clamp(x + 1, 0, width - 1);
+
+        float gx = (s0[xp] - s0[xm]) + 2.0f * (s1[xp] - s1[xm]) + (s2[xp] - s2[xm]);
+        float gy = (s2[xm] + 2.0f * s2[x] + s2[xp]) - (s0[xm] + 2.0f * s0[x] + s0[xp]);
+        float ax = fabsf(gx);
+        float ay = fabsf(gy);
+
+        magnitude[x] = sqrtf(gx * gx + gy * gy);
+
+        if (ay <= CANNY_TAN_22_5 * ax) {
+            direction[x] = CANNY_DIR_0;
+        }
+        else if (ay >= CANNY_TAN_67_5 * ax) {
+            direction[x] = CANNY_DIR_90;
+        }
+        else {
+            direction[x] = ((gx > 0.0f) == (gy > 0.0f)) ? CANNY_DIR_45 : CANNY_DIR_135;
+        }
+    }
+
+    return;
+}
+
+void canny_sobel_row(const float *s0, const float *s1, const float *s2, float *magnitude, uint8_t *direction, int width)
+{
+    canny_sobel_span(s0, s1, s2, magnitude, direction, width, 0, width);
+
+    return;
+}
+
+/********************************************************
+Fixed-point horizontal 5-tap Gaussian pass over pixels
+[x0, x1). Output keeps CANNY_FRACTION_BITS fractional
+bits. Borders replicate the edge pixel.
+********************************************************/
+static void canny_gaussian_horizontal_span_fixed(const uint16_t *in, int32_t *out, int width, const int32_t *gaussian,
+                                                 int x0, int x1)
+{
+    for (int x = x0; x < x1; x++) {
+        int32_t m2 = in[canny_clamp(x - 2, 0, width - 1)];
+        int32_t m1 = in[canny_clamp(x - 1, 0, width - 1)];
+        int32_t c = in[x];
+        int32_t p1 = in[canny_clamp(x + 1, 0, width - 1)];
+        int32_t p2 = in[canny_clamp(x + 2, 0, width - 1)];
+        int32_t sum = gaussian[0] * c + gaussian[1] * (m1 + p1) + gaussian[2] * (m2 + p2);
+
+        out[x] = (sum + (1 << (CANNY_HBLUR_SHIFT - 1))) >> CANNY_HBLUR_SHIFT;
+    }
+
+    return;
+}
+
+void canny_gaussian_horizontal_row_fixed(const uint16_t *in, int32_t *out, int width, const int32_t *gaussian)
+{
+    canny_gaussian_horizontal_span_fixed(in, out, width, gaussian, 0, width);
+
+    return;
+}
+
+/********************************************************
+Fixed-point vertical 5-tap Gaussian pass. Input and
+output keep CANNY_FRACTION_BITS fractional bits.
+********************************************************/
+void canny_gaussian_vertical_row_fixed(const int32_t *r0, const int32_t *r1, const int32_t *r2, const int32_t *r3,
+                                       const int32_t *r4, int32_t *out, int width, const int32_t *gaussian)
+{
+    for (int x = 0; x < width; x++) {
+        int32_t sum = gaussian[0] * r2[x] + gaussian[1] * (r1[x] + r3[x]) + gaussian[2] * (r0[x] + r4[x]);
+
+        out[x] = (sum + (1 << (CANNY_GAUSSIAN_BITS - 1))) >> CANNY_GAUSSIAN_BITS;
+    }
+
+    return;
+}
+
+/********************************************************
+Fixed-point Sobel gradients of pixels [x0, x1). Stores
+the L1 or shifted squared L2 magnitude (mode) and the
+direction from integer slope comparisons against
+tan(22.5) and tan(67.5) in Q7, no atan2.
+********************************************************/
+static void canny_sobel_span_fixed(const int32_t *s0, const int32_t *s1, const int32_t *s2, uint32_t *magnitude,
+                                   uint8_t *direction, int width, int mode, int x0, int x1)
+{
+    for (int x = x0; x < x1; x++) {
+        int xm = canny_clamp(x - 1, 0, width - 1);
+        int xp = canny_clamp(x + 1, 0, width - 1);
+
+        int32_t gx = (s0[xp] - s0[xm]) + 2 * (s1[xp] - s1[xm]) + (s2[xp] - s2[xm]);
+        int32_t gy = (s2[xm] + 2 * s2[x] + s2[xp]) - (s0[xm] + 2 * s0[x] + s0[xp]);
+        int32_t ax = abs(gx);
+        int32_t ay = abs(gy);
+
+        if (mode == CANNY_MODE_FIXED_L2) {
+            magnitude[x] = (uint32_t) (((int64_t) gx * gx + (int64_t) gy * gy) >> CANNY_L2_SHIFT);
+        }
+        else {
+            magnitude[x] = (uint32_t) (ax + ay);
+        }
+
+        if (ay * 128 <= ax * CANNY_TAN_22_5_Q7) {
+            direction[x] = CANNY_DIR_0;
+        }
+        else if (ay * 128 >= ax * CANNY_TAN_67_5_Q7) {
+            direction[x] = CANNY_DIR_90;
+        }
+        else {
+            direction[x] = ((gx > 0) == (gy > 0)) ? CANNY_DIR_45 : CANNY_DIR_135;
+        }
+    }
+
+    return;
+}
+
+void canny_sobel_row_fixed(const int32_t *s0, const int32_t *s1, const int32_t *s2, uint32_t *magnitude, uint8_t *direction,
+                           int width, int mode)
+{
+    canny_sobel_span_fixed(s0, s1, s2, magnitude, direction, width, mode, 0, width);
+
+    return;
+}
+
+#if CANNY_X86
+/********************************************************
+SSE4.1 kernels, 4 pixels per register. They evaluate the
+same expressions in the same order as the scalar
+reference (no FMA contraction), so results are bit
+identical. Border pixels use the scalar spans.
+********************************************************/
+__attribute__((target("sse4.1")))
+static inline __m128 canny_load4_u16_sse41(const uint16_t *in)
+{
+    __m128i v;
+    memcpy(&v, in, sizeof(uint64_t)); // upper half is ignored by the widening below
+    return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(v));
+}
+
+__attribute__((target("sse4.1")))
+void canny_gaussian_horizontal_row_sse41(const uint16_t *in, float *out, int width, const float *gaussian)
+{
+    const __m128 g0 = _mm_set1_ps(gaussian[0]);
+    const __m128 g1 = _mm_set1_ps(gaussian[1]);
+    const __m128 g2 = _mm_set1_ps(gaussian[2]);
+    int x = (width < 2) ? width : 2;
+
+    canny_gaussian_horizontal_span(in, out, width, gaussian, 0, x);
+    for (; x + 4 + 2 <= width; x += 4) {
+        __m128 m2 = canny_load4_u16_sse41(&in[x - 2]);
+        __m128 m1 = canny_load4_u16_sse41(&in[x - 1]);
+        __m128 c = canny_load4_u16_sse41(&in[x]);
+        __m128 p1 = canny_load4_u16_sse41(&in[x + 1]);
+        __m128 p2 = canny_load4_u16_sse41(&in[x + 2]);
+        __m128 sum = _mm_add_ps(_mm_mul_ps(g0, c), _mm_mul_ps(g1, _mm_add_ps(m1, p1)));
+
+        _mm_storeu_ps(&out[x], _mm_add_ps(sum, _mm_mul_ps(g2, _mm_add_ps(m2, p2))));
+    }
+    canny_gaussian_horizontal_span(in, out, width, gaussian, x, width);
+
+    return;
+}
+
+__attribute__((target("sse4.1")))
+void canny_gaussian_vertical_row_sse41(const float *r0, const float *r1, const float *r2, const float *r3, const float *r4,
+                                       float *out, int width, const float *gaussian)
+{
+    const __m128 g0 = _mm_set1_ps(gaussian[0]);
+    const __m128 g1 = _mm_set1_ps(gaussian[1]);
+    const __m128 g2 = _mm_set1_ps(gaussian[2]);
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        __m128 sum = _mm_add_ps(_mm_mul_ps(g0, _mm_loadu_ps(&r2[x])),
+                                _mm_mul_ps(g1, _mm_add_ps(_mm_loadu_ps(&r1[x]), _mm_loadu_ps(&r3[x]))));
+
+        _mm_storeu_ps(&out[x], _mm_add_ps(sum, _mm_mul_ps(g2, _mm_add_ps(_mm_loadu_ps(&r0[x]), _mm_loadu_ps(&r4[x])))));
+    }
+    for (; x < width; x++) {
+        out[x] = gaussian[0] * r2[x] + gaussian[1] * (r1[x] + r3[x]) + gaussian[2] * (r0[x] + r4[x]);
+    }
+
+    return;
+}
+
+/* quantized directions for 4 gradients, same decision order as canny_sobel_span */
+__attribute__((target("sse4.1")))
+static inline __m128i canny_direction_sse41(__m128 gx, __m128 gy, __m128 ax, __m128 ay)
+{
+    const __m128 zero = _mm_setzero_ps();
+    __m128 same_sign = _mm_xor_ps(_mm_cmpgt_ps(gx, zero), _mm_cmpgt_ps(gy, zero));
+    __m128i dir = _mm_blendv_epi8(_mm_set1_epi32(CANNY_DIR_45), _mm_set1_epi32(CANNY_DIR_135), _mm_castps_si128(same_sign));
+
+    dir = _mm_blendv_epi8(dir, _mm_set1_epi32(CANNY_DIR_90),
+                          _mm_castps_si128(_mm_cmpge_ps(ay, _mm_mul_ps(_mm_set1_ps(CANNY_TAN_67_5), ax))));
+    dir = _mm_blendv_epi8(dir, _mm_set1_epi32(CANNY_DIR_0),
+                          _mm_castps_si128(_mm_cmple_ps(ay, _mm_mul_ps(_mm_set1_ps(CANNY_TAN_22_5), ax))));
+
+    return dir;
+}
+
+__attribute__((target("sse4.1")))
+void canny_sobel_row_sse41(const float *s0, const float *s1, const float *s2, float *magnitude, uint8_t *direction, int width)
+{
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    int x = (width < 1) ? width : 1;
+
+    canny_sobel_span(s0, s1, s2, magnitude, direction, width, 0, x);
+    for (; x + 4 + 1 <= width; x += 4) {
+        __m128 s0m = _mm_loadu_ps(&s0[x - 1]), s0c = _mm_loadu_ps(&s0[x]), s0p = _mm_loadu_ps(&s0[x + 1]);
+        __m128 s1m = _mm_loadu_ps(&s1[x - 1]), s1p = _mm_loadu_ps(&s1[x + 1]);
+        __m128 s2m = _mm_loadu_ps(&s2[x - 1]), s2c = _mm_loadu_ps(&s2[x]), s2p = _mm_loadu_ps(&s2[x + 1]);
+
+        __m128 gx = _mm_add_ps(_mm_add_ps(_mm_sub_ps(s0p, s0m), _mm_mul_ps(two, _mm_sub_ps(s1p, s1m))), _mm_sub_ps(s2p, s2m));
+        __m128 gy = _mm_sub_ps(_mm_add_ps(_mm_add_ps(s2m, _mm_mul_ps(two, s2c)), s2p),
+                               _mm_add_ps(_mm_add_ps(s0m, _mm_mul_ps(two, s0c)), s0p));
+        __m128 ax = _mm_and_ps(gx, abs_mask);
+        __m128 ay = _mm_and_ps(gy, abs_mask);
+        __m128i dir = canny_direction_sse41(gx, gy, ax, ay);
+        int packed;
+
+        _mm_storeu_ps(&magnitude[x], _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy))));
+        dir = _mm_packus_epi16(_mm_packs_epi32(dir, dir), dir);
+        packed = _mm_cvtsi128_si32(dir);
+        memcpy(&direction[x], &packed, 4);
+    }
+    canny_sobel_span(s0, s1, s2, magnitude, direction, width, x, width);
+
+    return;
+}
+
+/* fixed-point SSE4.1 kernels, 4 int32 lanes, exact integer arithmetic */
+__attribute__((target("sse4.1")))
+static inline __m128i canny_load4_u16_epi32_sse41(const uint16_t *in)
+{
+    __m128i v;
+    memcpy(&v, in, sizeof(uint64_t)); // upper half is ignored by the widening below
+    return _mm_cvtepu16_epi32(v);
+}
+
+__attribute__((target("sse4.1")))
+void canny_gaussian_horizontal_row_fixed_sse41(const uint16_t *in, int32_t *out, int width, const int32_t *gaussian)
+{
+    const __m128i g0 = _mm_set1_epi32(gaussian[0]);
+    const __m128i g1 = _mm_set1_epi32(gaussian[1]);
+    const __m128i g2 = _mm_set1_epi32(gaussian[2]);
+    const __m128i round = _mm_set1_epi32(1 << (CANNY_HBLUR_SHIFT - 1));
+    int x = (width < 2) ? width : 2;
+
+    canny_gaussian_horizontal_span_fixed(in, out, width, gaussian, 0, x);
+    for (; x + 4 + 2 <= width; x += 4) {
+        __m128i m2 = canny_load4_u16_epi32_sse41(&in[x - 2]);
+        __m128i m1 = canny_load4_u16_epi32_sse41(&in[x - 1]);
+        __m128i c = canny_load4_u16_epi32_sse41(&in[x]);
+        __m128i p1 = canny_load4_u16_epi32_sse41(&in[x + 1]);
+        __m128i p2 = canny_load4_u16_epi32_sse41(&in[x + 2]);
+        __m128i sum = _mm_add_epi32(_mm_mullo_epi32(g0, c), _mm_mullo_epi32(g1, _mm_add_epi32(m1, p1)));
+
+        sum = _mm_add_epi32(sum, _mm_mullo_epi32(g2, _mm_add_epi32(m2, p2)));
+        _mm_storeu_si128((__m128i*) &out[x], _mm_srai_epi32(_mm_add_epi32(sum, round), CANNY_HBLUR_SHIFT));
+    }
+    canny_gaussian_horizontal_span_fixed(in, out, width, gaussian, x, width);
+
+    return;
+}
+
+__attribute__((target("sse4.1")))
+void canny_gaussian_vertical_row_fixed_sse41(const int32_t *r0, const int32_t *r1, const int32_t *r2, const int32_t *r3,
+                                             const int32_t *r4, int32_t *out, int width, const int32_t *gaussian)
+{
+    const __m128i g0 = _mm_set1_epi32(gaussian[0]);
+    const __m128i g1 = _mm_set1_epi32(gaussian[1]);
+    const __m128i g2 = _mm_set1_epi32(gaussian[2]);
+    const __m128i round = _mm_set1_epi32(1 << (CANNY_GAUSSIAN_BITS - 1));
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*) &r0[x]), a1 = _mm_loadu_si128((const __m128i*) &r1[x]);
+        __m128i a2 = _mm_loadu_si128((const __m128i*) &r2[x]), a3 = _mm_loadu_si128((const __m128i*) &r3[x]);
+        __m128i a4 = _mm_loadu_si128((const __m128i*) &r4[x]);
+        __m128i sum = _mm_add_epi32(_mm_mullo_epi32(g0, a2), _mm_mullo_epi32(g1, _mm_add_epi32(a1, a3)));
+
+        sum = _mm_add_epi32(sum, _mm_mullo_epi32(g2, _mm_add_epi32(a0, a4)));
+        _mm_storeu_si128((__m128i*) &out[x], _mm_srai_epi32(_mm_add_epi32(sum, round), CANNY_GAUSSIAN_BITS));
+    }
+    for (; x < width; x++) {
+        int32_t sum = gaussian[0] * r2[x] + gaussian[1] * (r1[x] + r3[x]) + gaussian[2] * (r0[x] + r4[x]);
+        out[x] = (sum + (1 << (CANNY_GAUSSIAN_BITS - 1))) >> CANNY_GAUSSIAN_BITS;
+    }
+
+    return;
+}
+
+/* (gx^2 + gy^2) >> CANNY_L2_SHIFT for 4 lanes, squares are formed in 64 bits on even and odd lanes */
+__attribute__((target("sse4.1")))
+static inline __m128i canny_l2_fixed_sse41(__m128i gx, __m128i gy)
+{
+    __m128i even = _mm_add_epi64(_mm_mul_epi32(gx, gx), _mm_mul_epi32(gy, gy));
+    __m128i gx_odd = _mm_srli_epi64(gx, 32), gy_odd = _mm_srli_epi64(gy, 32);
+    __m128i odd = _mm_add_epi64(_mm_mul_epi32(gx_odd, gx_odd), _mm_mul_epi32(gy_odd, gy_odd));
+
+    even = _mm_srli_epi64(even, CANNY_L2_SHIFT);
+    odd = _mm_slli_epi64(_mm_srli_epi64(odd, CANNY_L2_SHIFT), 32);
+
+    return _mm_blend_epi16(even, odd, 0xcc);
+}
+
+__attribute__((target("sse4.1")))
+void canny_sobel_row_fixed_sse41(const int32_t *s0, const int32_t *s1, const int32_t *s2, uint32_t *magnitude,
+                                 uint8_t *direction, int width, int mode)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int x = (width < 1) ? width : 1;
+
+    canny_sobel_span_fixed(s0, s1, s2, magnitude, direction, width, mode, 0, x);
+    for (; x + 4 + 1 <= width; x += 4) {
+        __m128i s0m = _mm_loadu_si128((const __m128i*) &s0[x - 1]), s0c = _mm_loadu_si128((const __m128i*) &s0[x]);
+        __m128i s0p = _mm_loadu_si128((const __m128i*) &s0[x + 1]);
+        __m128i s1m = _mm_loadu_si128((const __m128i*) &s1[x - 1]), s1p = _mm_loadu_si128((const __m128i*) &s1[x + 1]);
+        __m128i s2m = _mm_loadu_si128((const __m128i*) &s2[x - 1]), s2c = _mm_loadu_si128((const __m128i*) &s2[x]);
+        __m128i s2p = _mm_loadu_si128((const __m128i*) &s2[x + 1]);
+
+        __m128i gx = _mm_add_epi32(_mm_add_epi32(_mm_sub_epi32(s0p, s0m), _mm_slli_epi32(_mm_sub_epi32(s1p, s1m), 1)),
+                                   _mm_sub_epi32(s2p, s2m));
+        __m128i gy = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(s2m, _mm_slli_epi32(s2c, 1)), s2p),
+                                   _mm_add_epi32(_mm_add_epi32(s0m, _mm_slli_epi32(s0c, 1)), s0p));
+        __m128i ax = _mm_abs_epi32(gx);
+        __m128i ay = _mm_abs_epi32(gy);
+        __m128i ay_q7 = _mm_slli_epi32(ay, 7);
+        int packed;
+
+        if (mode == CANNY_MODE_FIXED_L2) {
+            _mm_storeu_si128((__m128i*) &magnitude[x], canny_l2_fixed_sse41(gx, gy));
+        }
+        else {
+            _mm_storeu_si128((__m128i*) &magnitude[x], _mm_add_epi32(ax, ay));
+        }
+
+        __m128i diagonal = _mm_xor_si128(_mm_cmpgt_epi32(gx, zero), _mm_cmpgt_epi32(gy, zero));
+        __m128i dir = _mm_blendv_epi8(_mm_set1_epi32(CANNY_DIR_45), _mm_set1_epi32(CANNY_DIR_135), diagonal);
+        /* ay * 128 >= ax * tan67 is !(ax * tan67 > ay * 128) */
+        __m128i vertical = _mm_cmpgt_epi32(_mm_mullo_epi32(ax, _mm_set1_epi32(CANNY_TAN_67_5_Q7)), ay_q7);
+        dir = _mm_blendv_epi8(_mm_set1_epi32(CANNY_DIR_90), dir, vertical);
+        /* ay * 128 <= ax * tan22 is !(ay * 128 > ax * tan22) */
+        __m128i horizontal = _mm_cmpgt_epi32(ay_q7, _mm_mullo_epi32(ax, _mm_set1_epi32(CANNY_TAN_22_5_Q7)));
+        dir = _mm_blendv_epi8(_mm_set1_epi32(CANNY_DIR_0), dir, horizontal);
+
+        dir = _mm_packus_epi16(_mm_packs_epi32(dir, dir), dir);
+        packed = _mm_cvtsi128_si32(dir);
+        memcpy(&direction[x], &packed, 4);
+    }
+    canny_sobel_span_fixed(s0, s1, s2, magnitude, direction, width, mode, x, width);
+
+    return;
+}
+
+/********************************************************
+AVX2 kernels, 8 pixels per register. Same expressions and
+evaluation order as the scalar reference.
+********************************************************/
+__attribute__((target("avx2")))
+static inline __m256 canny_load8_u16_avx2(const uint16_t *in)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) in)));
+}
+
+__attribute__((target("avx2")))
+void canny_gaussian_horizontal_row_avx2(const uint16_t *in, float *out, int width, const float *gaussian)
+{
+    const __m256 g0 = _mm256_set1_ps(gaussian[0]);
+    const __m256 g1 = _mm256_set1_ps(gaussian[1]);
+    const __m256 g2 = _mm256_set1_ps(gaussian[2]);
+    int x = (width < 2) ? width : 2;
+
+    canny_gaussian_horizontal_span(in, out, width, gaussian, 0, x);
+    for (; x + 8 + 2 <= width; x += 8) {
+        __m256 m2 = canny_load8_u16_avx2(&in[x - 2]);
+        __m256 m1 = canny_load8_u16_avx2(&in[x - 1]);
+        __m256 c = canny_load8_u16_avx2(&in[x]);
+        __m256 p1 = canny_load8_u16_avx2(&in[x + 1]);
+        __m256 p2 = canny_load8_u16_avx2(&in[x + 2]);
+        __m256 sum = _mm256_add_ps(_mm256_mul_ps(g0, c), _mm256_mul_ps(g1, _mm256_add_ps(m1, p1)));
+
+        _mm256_storeu_ps(&out[x], _mm256_add_ps(sum, _mm256_mul_ps(g2, _mm256_add_ps(m2, p2))));
+    }
+    canny_gaussian_horizontal_span(in, out, width, gaussian, x, width);
+
+    return;
+}
+
+__attribute__((target("avx2")))
+void canny_gaussian_vertical_row_avx2(const float *r0, const float *r1, const float *r2, const float *r3, const float *r4,
+                                      float *out, int width, const float *gaussian)
+{
+    const __m256 g0 = _mm256_set1_ps(gaussian[0]);
+    const __m256 g1 = _mm256_set1_ps(gaussian[1]);
+    const __m256 g2 = _mm256_set1_ps(gaussian[2]);
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m256 sum = _mm256_add_ps(_mm256_mul_ps(g0, _mm256_loadu_ps(&r2[x])),
+                                   _mm256_mul_ps(g1, _mm256_add_ps(_mm256_loadu_ps(&r1[x]), _mm256_loadu_ps(&r3[x]))));
+
+        _mm256_storeu_ps(&out[x], _mm256_add_ps(sum, _mm256_mul_ps(g2, _mm256_add_ps(_mm256_loadu_ps(&r0[x]),
+                                                                                      _mm256_loadu_ps(&r4[x])))));
+    }
+    for (; x < width; x++) {
+        out[x] = gaussian[0] * r2[x] + gaussian[1] * (r1[x] + r3[x]) + gaussian[2] * (r0[x] + r4[x]);
+    }
+
+    return;
+}
+
+__attribute__((target("avx2")))
+void canny_sobel_row_avx2(const float *s0, const float *s1, const float *s2, float *magnitude, uint8_t *direction, int width)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    int x = (width < 1) ? width : 1;
+
+    canny_sobel_span(s0, s1, s2, magnitude, direction, width, 0, x);
+    for (; x + 8 + 1 <= width; x += 8) {
+        __m256 s0m = _mm256_loadu_ps(&s0[x - 1]), s0c = _mm256_loadu_ps(&s0[x]), s0p = _mm256_loadu_ps(&s0[x + 1]);
+        __m256 s1m = _mm256_loadu_ps(&s1[x - 1]), s1p = _mm256_loadu_ps(&s1[x + 1]);
+        __m256 s2m = _mm256_loadu_ps(&s2[x - 1]), s2c = _mm256_loadu_ps(&s2[x]), s2p = _mm256_loadu_ps(&s2[x + 1]);
+
+        __m256 gx = _mm256_add_ps(_mm256_add_ps(_mm256_sub_ps(s0p, s0m), _mm256_mul_ps(two, _mm256_sub_ps(s1p, s1m))),
+                                  _mm256_sub_ps(s2p, s2m));
+        __m256 gy = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(s2m, _mm256_mul_ps(two, s2c)), s2p),
+                                  _mm256_add_ps(_mm256_add_ps(s0m, _mm256_mul_ps(two, s0c)), s0p));
+        __m256 ax = _mm256_and_ps(gx, abs_mask);
+        __m256 ay = _mm256_and_ps(gy, abs_mask);
+
+        __m256 diagonal = _mm256_xor_ps(_mm256_cmp_ps(gx, zero, _CMP_GT_OQ), _mm256_cmp_ps(gy, zero, _CMP_GT_OQ));
+        __m256i dir = _mm256_blendv_epi8(_mm256_set1_epi32(CANNY_DIR_45), _mm256_set1_epi32(CANNY_DIR_135),
+                                         _mm256_castps_si256(diagonal));
+        dir = _mm256_blendv_epi8(dir, _mm256_set1_epi32(CANNY_DIR_90),
+                                 _mm256_castps_si256(_mm256_cmp_ps(ay, _mm256_mul_ps(_mm256_set1_ps(CANNY_TAN_67_5), ax), _CMP_GE_OQ)));
+        dir = _mm256_blendv_epi8(dir, _mm256_set1_epi32(CANNY_DIR_0),
+                                 _mm256_castps_si256(_mm256_cmp_ps(ay, _mm256_mul_ps(_mm256_set1_ps(CANNY_TAN_22_5), ax), _CMP_LE_OQ)));
+
+        _mm256_storeu_ps(&magnitude[x], _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy))));
+
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(dir), _mm256_extracti128_si256(dir, 1));
+        _mm_storel_epi64((__m128i*) &direction[x], _mm_packus_epi16(packed, packed));
+    }
+    canny_sobel_span(s0, s1, s2, magnitude, direction, width, x, width);
+
+    return;
+}
+
+/* fixed-point AVX2 kernels, 8 int32 lanes, exact integer arithmetic */
+__attribute__((target("avx2")))
+void canny_gaussian_horizontal_row_fixed_avx2(const uint16_t *in, int32_t *out, int width, const int32_t *gaussian)
+{
+    const __m256i g0 = _mm256_set1_epi32(gaussian[0]);
+    const __m256i g1 = _mm256_set1_epi32(gaussian[1]);
+    const __m256i g2 = _mm256_set1_epi32(gaussian[2]);
+    const __m256i round = _mm256_set1_epi32(1 << (CANNY_HBLUR_SHIFT - 1));
+    int x = (width < 2) ? width : 2;
+
+    canny_gaussian_horizontal_span_fixed(in, out, width, gaussian, 0, x);
+    for (; x + 8 + 2 <= width; x += 8) {
+        __m256i m2 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) &in[x - 2]));
+        __m256i m1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) &in[x - 1]));
+        __m256i c = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) &in[x]));
+        __m256i p1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) &in[x + 1]));
+        __m256i p2 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) &in[x + 2]));
+        __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(g0, c), _mm256_mullo_epi32(g1, _mm256_add_epi32(m1, p1)));
+
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(g2, _mm256_add_epi32(m2, p2)));
+        _mm256_storeu_si256((__m256i*) &out[x], _mm256_srai_epi32(_mm256_add_epi32(sum, round), CANNY_HBLUR_SHIFT));
+    }
+    canny_gaussian_horizontal_span_fixed(in, out, width, gaussian, x, width);
+
+    return;
+}
+
+__attribute__((target("avx2")))
+void canny_gaussian_vertical_row_fixed_avx2(const int32_t *r0, const int32_t *r1, const int32_t *r2, const int32_t *r3,
+                                            const int32_t *r4, int32_t *out, int width, const int32_t *gaussian)
+{
+    const __m256i g0 = _mm256_set1_epi32(gaussian[0]);
+    const __m256i g1 = _mm256_set1_epi32(gaussian[1]);
+    const __m256i g2 = _mm256_set1_epi32(gaussian[2]);
+    const __m256i round = _mm256_set1_epi32(1 << (CANNY_GAUSSIAN_BITS - 1));
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i*) &r0[x]), a1 = _mm256_loadu_si256((const __m256i*) &r1[x]);
+        __m256i a2 = _mm256_loadu_si256((const __m256i*) &r2[x]), a3 = _mm256_loadu_si256((const __m256i*) &r3[x]);
+        __m256i a4 = _mm256_loadu_si256((const __m256i*) &r4[x]);
+        __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(g0, a2), _mm256_mullo_epi32(g1, _mm256_add_epi32(a1, a3)));
+
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(g2, _mm256_add_epi32(a0, a4)));
+        _mm256_storeu_si256((__m256i*) &out[x], _mm256_srai_epi32(_mm256_add_epi32(sum, round), CANNY_GAUSSIAN_BITS));
+    }
+    for (; x < width; x++) {
+        int32_t sum = gaussian[0] * r2[x] + gaussian[1] * (r1[x] + r3[x]) + gaussian[2] * (r0[x] + r4[x]);
+        out[x] = (sum + (1 << (CANNY_GAUSSIAN_BITS - 1))) >> CANNY_GAUSSIAN_BITS;
+    }
+
+    return;
+}
+
+__attribute__((target("avx2")))
+void canny_sobel_row_fixed_avx2(const int32_t *s0, const int32_t *s1, const int32_t *s2, uint32_t *magnitude,
+                                uint8_t *direction, int width, int mode)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int x = (width < 1) ? width : 1;
+
+    canny_sobel_span_fixed(s0, s1, s2, magnitude, direction, width, mode, 0, x);
+    for (; x + 8 + 1 <= width; x += 8) {
+        __m256i s0m = _mm256_loadu_si256((const __m256i*) &s0[x - 1]), s0c = _mm256_loadu_si256((const __m256i*) &s0[x]);
+        __m256i s0p = _mm256_loadu_si256((const __m256i*) &s0[x + 1]);
+        __m256i s1m = _mm256_loadu_si256((const __m256i*) &s1[x - 1]), s1p = _mm256_loadu_si256((const __m256i*) &s1[x + 1]);
+        __m256i s2m = _mm256_loadu_si256((const __m256i*) &s2[x - 1]), s2c = _mm256_loadu_si256((const __m256i*) &s2[x]);
+        __m256i s2p = _mm256_loadu_si256((const __m256i*) &s2[x + 1]);
+
+        __m256i gx = _mm256_add_epi32(_mm256_add_epi32(_mm256_sub_epi32(s0p, s0m),
+                                                       _mm256_slli_epi32(_mm256_sub_epi32(s1p, s1m), 1)),
+                                      _mm256_sub_epi32(s2p, s2m));
+        __m256i gy = _mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(s2m, _mm256_slli_epi32(s2c, 1)), s2p),
+                                      _mm256_add_epi32(_mm256_add_epi32(s0m, _mm256_slli_epi32(s0c, 1)), s0p));
+        __m256i ax = _mm256_abs_epi32(gx);
+        __m256i ay = _mm256_abs_epi32(gy);
+        __m256i ay_q7 = _mm256_slli_epi32(ay, 7);
+
+        if (mode == CANNY_MODE_FIXED_L2) {
+            /* squares are formed in 64 bits on even and odd lanes, then shifted back into 32 bits */
+            __m256i even = _mm256_add_epi64(_mm256_mul_epi32(gx, gx), _mm256_mul_epi32(gy, gy));
+            __m256i gx_odd = _mm256_srli_epi64(gx, 32), gy_odd = _mm256_srli_epi64(gy, 32);
+            __m256i odd = _mm256_add_epi64(_mm256_mul_epi32(gx_odd, gx_odd), _mm256_mul_epi32(gy_odd, gy_odd));
+
+            even = _mm256_srli_epi64(even, CANNY_L2_SHIFT);
+            odd = _mm256_slli_epi64(_mm256_srli_epi64(odd, CANNY_L2_SHIFT), 32);
+            _mm256_storeu_si256((__m256i*) &magnitude[x], _mm256_blend_epi32(even, odd, 0xaa));
+        }
+        else {
+            _mm256_storeu_si256((__m256i*) &magnitude[x], _mm256_add_epi32(ax, ay));
+        }
+
+        __m256i diagonal = _mm256_xor_si256(_mm256_cmpgt_epi32(gx, zero), _mm256_cmpgt_epi32(gy, zero));
+        __m256i dir = _mm256_blendv_epi8(_mm256_set1_epi32(CANNY_DIR_45), _mm256_set1_epi32(CANNY_DIR_135), diagonal);
+        __m256i vertical = _mm256_cmpgt_epi32(_mm256_mullo_epi32(ax, _mm256_set1_epi32(CANNY_TAN_67_5_Q7)), ay_q7);
+        dir = _mm256_blendv_epi8(_mm256_set1_epi32(CANNY_DIR_90), dir, vertical);
+        __m256i horizontal = _mm256_cmpgt_epi32(ay_q7, _mm256_mullo_epi32(ax, _mm256_set1_epi32(CANNY_TAN_22_5_Q7)));
+        dir = _mm256_blendv_epi8(_mm256_set1_epi32(CANNY_DIR_0), dir, horizontal);
+
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(dir), _mm256_extracti128_si256(dir, 1));
+        _mm_storel_epi64((__m128i*) &direction[x], _mm_packus_epi16(packed, packed));
+    }
+    canny_sobel_span_fixed(s0, s1, s2, magnitude, direction, width, mode, x, width);
+
+    return;
+}
+#endif
+
+/* kernel sets, fastest first */
+static const struct canny_kernels_struct canny_kernel_sets[] = {
+#if CANNY_X86
+    {"avx2", canny_gaussian_horizontal_row_avx2, canny_gaussian_vertical_row_avx2, canny_sobel_row_avx2,
+     canny_gaussian_horizontal_row_fixed_avx2, canny_gaussian_vertical_row_fixed_avx2, canny_sobel_row_fixed_avx2},
+    {"sse4.1", canny_gaussian_horizontal_row_sse41, canny_gaussian_vertical_row_sse41, canny_sobel_row_sse41,
+     canny_gaussian_horizontal_row_fixed_sse41, canny_gaussian_vertical_row_fixed_sse41, canny_sobel_row_fixed_sse41},
+#endif
+    {"scalar", canny_gaussian_horizontal_row, canny_gaussian_vertical_row, canny_sobel_row,
+     canny_gaussian_horizontal_row_fixed, canny_gaussian_vertical_row_fixed, canny_sobel_row_fixed},
+};
+#define CANNY_KERNEL_SETS ((int) (sizeof(canny_kernel_sets) / sizeof(canny_kernel_sets[0])))
+
+/* returns 1 if the cpu running the program can execute the named kernel set */
+static int canny_kernels_supported(const char *name)
+{
+#if CANNY_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (strcmp(name, "sse4.1") == 0) {
+        return __builtin_cpu_supports("sse4.1");
+    }
+#endif
+    return strcmp(name, "scalar") == 0;
+}
+
+/********************************************************
+Selects Gaussian/Sobel kernels from CPUID. name may force
+a set ("avx2", "sse4.1" or "scalar"); NULL or "auto"
+picks the fastest one the cpu supports. Returns NULL if
+the forced set is unknown or unsupported.
+********************************************************/
+const struct canny_kernels_struct *canny_select_kernels(const char *name)
+{
+    for (int k = 0; k < CANNY_KERNEL_SETS; k++) {
+        if (name != NULL && strcmp(name, "auto") != 0 && strcmp(name, canny_kernel_sets[k].name) != 0) {
+            continue;
+        }
+        if (canny_kernels_supported(canny_kernel_sets[k].name)) {
+            return &canny_kernel_sets[k];
+        }
+    }
+
+    return NULL;
+}
+
+/********************************************************
+Checks every supported kernel set, float and fixed point,
+against the scalar reference on all rows of frame, bit
+for bit. Returns 0 if they all match.
+********************************************************/
+int canny_verify_kernels(const uint16_t *frame, int width, int height, const struct canny_params_struct *params)
+{
+    const float *gaussian = params->gaussian;
+    const int32_t *gaussian_fixed = params->gaussian_fixed;
+    int32_t *reference_fixed = (int32_t*)malloc(sizeof(int32_t)*6*width);
+    int32_t *result_fixed = (int32_t*)malloc(sizeof(int32_t)*6*width);
+    float *reference = (float*)malloc(sizeof(float)*5*width);
+    float *result = (float*)malloc(sizeof(float)*5*width);
+    float *vertical_reference = (float*)malloc(sizeof(float)*width);
+    float *vertical_result = (float*)malloc(sizeof(float)*width);
+    uint8_t *reference_dir = (uint8_t*)malloc(sizeof(uint8_t)*width);
+    uint8_t *result_dir = (uint8_t*)malloc(sizeof(uint8_t)*width);
+    int mismatch = 0;
+
+    if (reference == NULL || result == NULL || vertical_reference == NULL || vertical_result == NULL
+        || reference_fixed == NULL || result_fixed == NULL || reference_dir == NULL || result_dir == NULL) {
+        printf("Memory could not be allocated for kernel verification\n");
+        exit(1);
+    }
+
+    for (int k = 0; k < CANNY_KERNEL_SETS; k++) {
+        const struct canny_kernels_struct *kernels = &canny_kernel_sets[k];
+        if (!canny_kernels_supported(kernels->name)) {
+            continue;
+        }
+
+        for (int y = 0; y < height && !mismatch; y++) {
+            const uint16_t *rows[5];
+            for (int r = 0; r < 5; r++) {
+                rows[r] = &frame[canny_clamp(y + r - 2, 0, height - 1) * width];
+                canny_gaussian_horizontal_row(rows[r], &reference[r * width], width, gaussian);
+                kernels->gaussian_horizontal_row(rows[r], &result[r * width], width, gaussian);
+            }
+            mismatch |= memcmp(reference, result, sizeof(float)*5*width) != 0;
+
+            /* reuse the five blurred rows as vertical and Sobel inputs */
+            canny_gaussian_vertical_row(&reference[0], &reference[width], &reference[2 * width], &reference[3 * width],
+                                        &reference[4 * width], vertical_reference, width, gaussian);
+            kernels->gaussian_vertical_row(&reference[0], &reference[width], &reference[2 * width], &reference[3 * width],
+                                           &reference[4 * width], vertical_result, width, gaussian);
+            mismatch |= memcmp(vertical_reference, vertical_result, sizeof(float)*width) != 0;
+
+            canny_sobel_row(&reference[width], &reference[2 * width], &reference[3 * width], vertical_reference,
+                            reference_dir, width);
+            kernels->sobel_row(&reference[width], &reference[2 * width], &reference[3 * width], vertical_result,
+                               result_dir, width);
+            mismatch |= memcmp(vertical_reference, vertical_result, sizeof(float)*width) != 0;
+            mismatch |= memcmp(reference_dir, result_dir, width) != 0;
+
+            /* same checks for the fixed-point kernels, row 5 of the buffers holds vertical/Sobel output */
+            for (int r = 0; r < 5; r++) {
+                canny_gaussian_horizontal_row_fixed(rows[r], &reference_fixed[r * width], width, gaussian_fixed);
+                kernels->gaussian_horizontal_row_fixed(rows[r], &result_fixed[r * width], width, gaussian_fixed);
+            }
+            mismatch |= memcmp(reference_fixed, result_fixed, sizeof(int32_t)*5*width) != 0;
+
+            canny_gaussian_vertical_row_fixed(&reference_fixed[0], &reference_fixed[width], &reference_fixed[2 * width],
+                                              &reference_fixed[3 * width], &reference_fixed[4 * width],
+                                              &reference_fixed[5 * width], width, gaussian_fixed);
+            kernels->gaussian_vertical_row_fixed(&reference_fixed[0], &reference_fixed[width], &reference_fixed[2 * width],
+                                                 &reference_fixed[3 * width], &reference_fixed[4 * width],
+                                                 &result_fixed[5 * width], width, gaussian_fixed);
+            mismatch |= memcmp(&reference_fixed[5 * width], &result_fixed[5 * width], sizeof(int32_t)*width) != 0;
+
+            for (int mode = CANNY_MODE_FIXED_L1; mode <= CANNY_MODE_FIXED_L2; mode++) {
+                canny_sobel_row_fixed(&reference_fixed[width], &reference_fixed[2 * width], &reference_fixed[3 * width],
+                                      (uint32_t*) &reference_fixed[5 * width], reference_dir, width, mode);
+                kernels->sobel_row_fixed(&reference_fixed[width], &reference_fixed[2 * width], &reference_fixed[3 * width],
+                                         (uint32_t*) &result_fixed[5 * width], result_dir, width, mode);
+                mismatch |= memcmp(&reference_fixed[5 * width], &result_fixed[5 * width], sizeof(int32_t)*width) != 0;
+                mismatch |= memcmp(reference_dir, result_dir, width) != 0;
+            }
+
+            if (mismatch) {
+                printf("\nKernel set %s does not match the scalar reference on row %d.\n", kernels->name, y);
+            }
+        }
+    }
+
+    free(reference);
+    free(result);
+    free(reference_fixed);
+    free(result_fixed);
+    free(vertical_reference);
+    free(vertical_result);
+    free(reference_dir);
+    free(result_dir);
+
+    return mismatch;
+}
+
+/********************************************************
+Non-maximum suppression and double thresholding of the
+middle of three magnitude rows. Stores CANNY_NONE,
+CANNY_WEAK or CANNY_STRONG per pixel in edges. The first
+and last column are never edges.
+********************************************************/
+static inline void canny_nms_row(const float *m0, const float *m1, const float *m2, const uint8_t *direction, uint8_t *edges,
+                   int width, float low_threshold, float high_threshold)
+{
+    edges[0] = CANNY_NONE;
+    edges[width - 1] = CANNY_NONE;
+
+    for (int x = 1; x < width - 1; x++) {
+        float center = m1[x];
+        float a, b;
+
+        switch (direction[x]) {
+            case CANNY_DIR_0:
+                a = m1[x - 1];
+                b = m1[x + 1];
+                break;
+            case CANNY_DIR_45:
+                a = m0[x - 1];
+                b = m2[x + 1];
+                break;
+            case CANNY_DIR_90:
+                a = m0[x];
+                b = m2[x];
+                break;
+            default:
+                a = m0[x + 1];
+                b = m2[x - 1];
+                break;
+        }
+
+        if (center > a && center >= b && center >= low_threshold) {
+            edges[x] = (center >= high_threshold) ? CANNY_STRONG : CANNY_WEAK;
+        }
+        else {
+            edges[x] = CANNY_NONE;
+        }
+    }
+
+    return;
+}
+
+/********************************************************
+Fixed-point counterpart of canny_nms_row, thresholds are
+in the magnitude format of the fixed-point mode.
+********************************************************/
+static inline void canny_nms_row_fixed(const uint32_t *m0, const uint32_t *m1, const uint32_t *m2, const uint8_t *direction,
+                         uint8_t *edges, int width, uint32_t low_threshold, uint32_t high_threshold)
+{
+    edges[0] = CANNY_NONE;
+    edges[width - 1] = CANNY_NONE;
+
+    for (int x = 1; x < width - 1; x++) {
+        uint32_t center = m1[x];
+        uint32_t a, b;
+
+        switch (direction[x]) {
+            case CANNY_DIR_0:
+                a = m1[x - 1];
+                b = m1[x + 1];
+                break;
+            case CANNY_DIR_45:
+                a = m0[x - 1];
+                b = m2[x + 1];
+                break;
+            case CANNY_DIR_90:
+                a = m0[x];
+                b = m2[x];
+                break;
+            default:
+                a = m0[x + 1];
+                b = m2[x - 1];
+                break;
+        }
+
+        if (center > a && center >= b && center >= low_threshold) {
+            edges[x] = (center >= high_threshold) ? CANNY_STRONG : CANNY_WEAK;
+        }
+        else {
+            edges[x] = CANNY_NONE;
+        }
+    }
+
+    return;
+}
+
+/* root of the component of pixel i, halving the path on the way (single writer only) */
+static inline int32_t canny_find_root(int32_t *parent, int32_t i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+
+    return i;
+}
+
+/* root of the component of pixel i without modifying parent, safe to call from many threads */
+static inline int32_t canny_find_root_readonly(const int32_t *parent, int32_t i)
+{
+    while (parent[i] != i) {
+        i = parent[i];
+    }
+
+    return i;
+}
+
+/* joins the components of pixels a and b by rank, the merged root is strong if either root was */
+static inline void canny_union(struct canny_workspace_struct *workspace, int32_t a, int32_t b)
+{
+    int32_t *parent = workspace->parent;
+    uint8_t *rank = workspace->rank;
+    uint8_t *strong = workspace->strong;
+    int32_t root_a = canny_find_root(parent, a);
+    int32_t root_b = canny_find_root(parent, b);
+
+    if (root_a == root_b) {
+        return;
+    }
+    if (rank[root_a] < rank[root_b] || (rank[root_a] == rank[root_b] && root_b < root_a)) {
+        int32_t swap = root_a;
+        root_a = root_b;
+        root_b = swap;
+    }
+
+    parent[root_b] = root_a;
+    strong[root_a] |= strong[root_b];
+    if (rank[root_a] == rank[root_b]) {
+        rank[root_a]++;
+    }
+
+    return;
+}
+
+/********************************************************
+Local connected components of one tile [x0, x1) x
+[y0, y1). Every weak or strong pixel starts as its own
+component and is joined with its already visited
+8-neighbours inside the tile. Touches only pixels of the
+tile, so tiles can run in parallel.
+********************************************************/
+static void canny_label_tile(const uint8_t *edges, struct canny_workspace_struct *workspace, int x0, int x1, int y0, int y1)
+{
+    const int width = workspace->width;
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            int32_t i = y * width + x;
+            if (edges[i] == CANNY_NONE) {
+                continue;
+            }
+
+            workspace->parent[i] = i;
+            workspace->rank[i] = 0;
+            workspace->strong[i] = (edges[i] == CANNY_STRONG);
+
+            if (x > x0 && edges[i - 1] != CANNY_NONE) {
+                canny_union(workspace, i, i - 1);
+            }
+            if (y > y0) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    if (x + dx >= x0 && x + dx < x1 && edges[i - width + dx] != CANNY_NONE) {
+                        canny_union(workspace, i, i - width + dx);
+                    }
+                }
+            }
+        }
+    }
+
+    return;
+}
+
+/********************************************************
+Double-threshold hysteresis as connected components over
+CANNY_TILE_SIZE tiles: a parallel union-find pass inside
+every tile, a serial merge along the tile borders and a
+parallel relabelling pass. Union by rank bounds every
+tree to log2(pixels) levels, so the cost per frame is
+bounded no matter how many weak edges clutter produces,
+and nothing recurses. Maps pixels of components that
+contain a strong pixel to CANNY_EDGE and everything else
+to 0.
+********************************************************/
+void canny_hysteresis(uint8_t *edges, struct canny_workspace_struct *workspace)
+{
+    const int width = workspace->width;
+    const int height = workspace->height;
+    const int tiles_x = (width + CANNY_TILE_SIZE - 1) / CANNY_TILE_SIZE;
+    const int tiles_y = (height + CANNY_TILE_SIZE - 1) / CANNY_TILE_SIZE;
+    int tile;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (tile = 0; tile < tiles_x * tiles_y; tile++) {
+        int x0 = (tile % tiles_x) * CANNY_TILE_SIZE;
+        int y0 = (tile / tiles_x) * CANNY_TILE_SIZE;
+        int x1 = (x0 + CANNY_TILE_SIZE < width) ? x0 + CANNY_TILE_SIZE : width;
+        int y1 = (y0 + CANNY_TILE_SIZE < height) ? y0 + CANNY_TILE_SIZE : height;
+
+        canny_label_tile(edges, workspace, x0, x1, y0, y1);
+
+        /* the tiles are the work the team shares, so they give the throughput of every socket */
+        if (workspace->placement != NULL) {
+            thread_placement_count(workspace->placement, (size_t) (x1 - x0) * (size_t) (y1 - y0));
+        }
+    }
+
+    /* join components across vertical tile borders (x0 - 1 | x0) */
+    for (int x0 = CANNY_TILE_SIZE; x0 < width; x0 += CANNY_TILE_SIZE) {
+        for (int y = 0; y < height; y++) {
+            int32_t i = y * width + x0;
+            if (edges[i] == CANNY_NONE) {
+                continue;
+            }
+            for (int dy = -1; dy <= 1; dy++) {
+                if (y + dy >= 0 && y + dy < height && edges[i + dy * width - 1] != CANNY_NONE) {
+                    canny_union(workspace, i, i + dy * width - 1);
+                }
+            }
+        }
+    }
+
+    /* join components across horizontal tile borders (y0 - 1 | y0), diagonals cover the tile corners */
+    for (int y0 = CANNY_TILE_SIZE; y0 < height; y0 += CANNY_TILE_SIZE) {
+        for (int x = 0; x < width; x++) {
+            int32_t i = y0 * width + x;
+            if (edges[i] == CANNY_NONE) {
+                continue;
+            }
+            for (int dx = -1; dx <= 1; dx++) {
+                if (x + dx >= 0 && x + dx < width && edges[i - width + dx] != CANNY_NONE) {
+                    canny_union(workspace, i, i - width + dx);
+                }
+            }
+        }
+    }
+
+    /* every pixel takes the strong flag of its root, parent and strong are read only here */
+    int y;
+    #pragma omp parallel for
+    for (y = 0; y < height; y++) {
+        for (int32_t i = y * width; i < (y + 1) * width; i++) {
+            if (edges[i] != CANNY_NONE) {
+                edges[i] = workspace->strong[canny_find_root_readonly(workspace->parent, i)] ? CANNY_EDGE : 0;
+            }
+        }
+    }
+
+    return;
+}
+
+/********************************************************
+Runs the float Canny stages on a width x height window
+of a frame whose rows are stride pixels apart. Rows
+stream through the stages with a fixed lag: at step t
+the horizontal pass produces row t, the vertical pass
+row t-2, Sobel row t-3 and non-maximum suppression row
+t-4, so each stage only needs its ring of line buffers.
+Borders of the window replicate like frame borders.
+Stores CANNY_NONE/WEAK/STRONG per pixel of the window in
+edges (width pixels per row).
+********************************************************/
+static inline __attribute__((always_inline))
+void canny_classify_window_float(const uint16_t *frame, int stride, int width, int height,
+                                 const struct canny_params_struct *params, struct canny_workspace_struct *workspace,
+                                 uint8_t *edges)
+{
+    float *hblur = workspace->hblur_rows;
+    float *smooth = workspace->smooth_rows;
+    float *magnitude = workspace->magnitude_rows;
+    uint8_t *direction = workspace->direction_rows;
+    const struct canny_kernels_struct *kernels = workspace->kernels;
+
+    for (int t = 0; t < height + 4; t++) {
+        int y;
+
+        /* horizontal Gaussian pass */
+        y = t;
+        if (y < height) {
+            kernels->gaussian_horizontal_row(&frame[y * stride], &hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y, height, width)],
+                                             width, params->gaussian);
+        }
 
+        /* vertical Gaussian pass */
+        y = t - 2;
+        if (y >= 0 && y < height) {
+            kernels->gaussian_vertical_row(&hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y - 2, height, width)],
+                                           &hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y - 1, height, width)],
+                                           &hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y, height, width)],
+                                           &hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y + 1, height, width)],
+                                           &hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y + 2, height, width)],
+                                           &smooth[canny_ring_offset(CANNY_SMOOTH_ROWS, y, height, width)],
+                                           width, params->gaussian);
+        }
+
+        /* Sobel gradients */
+        y = t - 3;
+        if (y >= 0 && y < height) {
+            kernels->sobel_row(&smooth[canny_ring_offset(CANNY_SMOOTH_ROWS, y - 1, height, width)],
+                               &smooth[canny_ring_offset(CANNY_SMOOTH_ROWS, y, height, width)],
+                               &smooth[canny_ring_offset(CANNY_SMOOTH_ROWS, y + 1, height, width)],
+                               &magnitude[canny_ring_offset(CANNY_GRADIENT_ROWS, y, height, width)],
+                               &direction[canny_ring_offset(CANNY_GRADIENT_ROWS, y, height, width)], width);
+        }
+
+        /* non-maximum suppression and double threshold, first and last row are never edges */
+        y = t - 4;
+        if (y == 0 || y == height - 1) {
+            memset(&edges[y * width], CANNY_NONE, width);
+        }
+        else if (y > 0 && y < height - 1) {
+            canny_nms_row(&magnitude[canny_ring_offset(CANNY_GRADIENT_ROWS, y - 1, height, width)],
+                          &magnitude[canny_ring_offset(CANNY_GRADIENT_ROWS, y, height, width)],
+                          &magnitude[canny_ring_offset(CANNY_GRADIENT_ROWS, y + 1, height, width)],
+                          &direction[canny_ring_offset(CANNY_GRADIENT_ROWS, y, height, width)], &edges[y * width], width,
+                          params->low_threshold, params->high_threshold);
+        }
+    }
+
+    return;
+}
+
+/********************************************************
+Fixed-point counterpart of canny_classify_window_float,
+same streaming schedule with integer line buffers.
+********************************************************/
+static inline __attribute__((always_inline))
+void canny_classify_window_fixed(const uint16_t *frame, int stride, int width, int height,
+                                 const struct canny_params_struct *params, struct canny_workspace_struct *workspace,
+                                 uint8_t *edges)
+{
+    int32_t *hblur = workspace->hblur_fixed_rows;
+    int32_t *smooth = workspace->smooth_fixed_rows;
+    uint32_t *magnitude = workspace->magnitude_fixed_rows;
+    uint8_t *direction = workspace->direction_rows;
+    const struct canny_kernels_struct *kernels = workspace->kernels;
+
+    for (int t = 0; t < height + 4; t++) {
+        int y;
+
+        /* horizontal Gaussian pass */
+        y = t;
+        if (y < height) {
+            kernels->gaussian_horizontal_row_fixed(&frame[y * stride],
+                                                   &hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y, height, width)],
+                                                   width, params->gaussian_fixed);
+        }
+
+        /* vertical Gaussian pass */
+        y = t - 2;
+        if (y >= 0 && y < height) {
+            kernels->gaussian_vertical_row_fixed(&hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y - 2, height, width)],
+                                                 &hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y - 1, height, width)],
+                                                 &hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y, height, width)],
+                                                 &hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y + 1, height, width)],
+                                                 &hblur[canny_ring_offset(CANNY_HBLUR_ROWS, y + 2, height, width)],
+                                                 &smooth[canny_ring_offset(CANNY_SMOOTH_ROWS, y, height, width)],
+                                                 width, params->gaussian_fixed);
+        }
+
+        /* Sobel gradients */
+        y = t - 3;
+        if (y >= 0 && y < height) {
+            kernels->sobel_row_fixed(&smooth[canny_ring_offset(CANNY_SMOOTH_ROWS, y - 1, height, width)],
+                                     &smooth[canny_ring_offset(CANNY_SMOOTH_ROWS, y, height, width)],
+                                     &smooth[canny_ring_offset(CANNY_SMOOTH_ROWS, y + 1, height, width)],
+                                     &magnitude[canny_ring_offset(CANNY_GRADIENT_ROWS, y, height, width)],
+                                     &direction[canny_ring_offset(CANNY_GRADIENT_ROWS, y, height, width)], width,
+                                     params->mode);
+        }
+
+        /* non-maximum suppression and double threshold, first and last row are never edges */
+        y = t - 4;
+        if (y == 0 || y == height - 1) {
+            memset(&edges[y * width], CANNY_NONE, width);
+        }
+        else if (y > 0 && y < height - 1) {
+            canny_nms_row_fixed(&magnitude[canny_ring_offset(CANNY_GRADIENT_ROWS, y - 1, height, width)],
+                                &magnitude[canny_ring_offset(CANNY_GRADIENT_ROWS, y, height, width)],
+                                &magnitude[canny_ring_offset(CANNY_GRADIENT_ROWS, y + 1, height, width)],
+                                &direction[canny_ring_offset(CANNY_GRADIENT_ROWS, y, height, width)], &edges[y * width],
+                                width, params->low_threshold_fixed, params->high_threshold_fixed);
+        }
+    }
+
+    return;
+}
+
+/* runs the Canny stages of the arithmetic mode of params on a window, see canny_classify_window_float */
+static void canny_classify_window(const uint16_t *frame, int stride, int width, int height,
+                                  const struct canny_params_struct *params, struct canny_workspace_struct *workspace,
+                                  uint8_t *edges)
+{
+    if (params->mode == CANNY_MODE_FLOAT) {
+        canny_classify_window_float(frame, stride, width, height, params, workspace, edges);
+    }
+    else {
+        canny_classify_window_fixed(frame, stride, width, height, params, workspace, edges);
+    }
+
+    return;
+}
+
+/*
+    Whole-frame versions of the classify functions for the common sensor sizes. The window functions are
+    always inlined, so each of these is compiled with the frame width and height as constants: ring offsets,
+    row addressing and the non-maximum suppression loops lose the generic indexing of the runtime geometry.
+*/
+#define CANNY_FRAME_PATH(WIDTH, HEIGHT) \
+    static void canny_classify_frame_float_##WIDTH##x##HEIGHT(const uint16_t *frame, \
+                                                             const struct canny_params_struct *params, \
+                                                             struct canny_workspace_struct *workspace, uint8_t *edges) \
+    { \
+        canny_classify_window_float(frame, WIDTH, WIDTH, HEIGHT, params, workspace, edges); \
+    } \
+    static void canny_classify_frame_fixed_##WIDTH##x##HEIGHT(const uint16_t *frame, \
+                                                             const struct canny_params_struct *params, \
+                                                             struct canny_workspace_struct *workspace, uint8_t *edges) \
+    { \
+        canny_classify_window_fixed(frame, WIDTH, WIDTH, HEIGHT, params, workspace, edges); \
+    }
+
+CANNY_FRAME_PATH(256, 256)
+CANNY_FRAME_PATH(640, 512)
+CANNY_FRAME_PATH(1280, 1024)
+
+static const struct canny_frame_path_struct canny_frame_paths[] = {
+    { 256, 256, canny_classify_frame_float_256x256, canny_classify_frame_fixed_256x256 },
+    { 640, 512, canny_classify_frame_float_640x512, canny_classify_frame_fixed_640x512 },
+    { 1280, 1024, canny_classify_frame_float_1280x1024, canny_classify_frame_fixed_1280x1024 },
+};
+
+#define CANNY_FRAME_PATHS ((int) (sizeof(canny_frame_paths) / sizeof(canny_frame_paths[0])))
+
+/* returns the specialized path for width x height frames, or NULL if the generic one has to be used */
+static const struct canny_frame_path_struct *canny_select_frame_path(int width, int height)
+{
+    for (int i = 0; i < CANNY_FRAME_PATHS; i++) {
+        if (canny_frame_paths[i].width == width && canny_frame_paths[i].height == height) {
+            return &canny_frame_paths[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* runs the Canny stages of the arithmetic mode of params on a whole frame, specialized when the geometry has a path */
+static void canny_classify_frame(const uint16_t *frame, const struct canny_params_struct *params,
+                                 struct canny_workspace_struct *workspace, uint8_t *edges)
+{
+    const struct canny_frame_path_struct *path = workspace->frame_path;
+
+    if (path == NULL) {
+        canny_classify_window(frame, workspace->width, workspace->width, workspace->height, params, workspace, edges);
+    }
+    else if (params->mode == CANNY_MODE_FLOAT) {
+        path->classify_float(frame, params, workspace, edges);
+    }
+    else {
+        path->classify_fixed(frame, params, workspace, edges);
+    }
+
+    return;
+}
+
+/********************************************************
+Runs the Canny pipeline on one frame in the arithmetic
+mode of params. Stores output in edges (one byte per
+pixel, CANNY_EDGE or 0).
+********************************************************/
+void canny_edge_detect_frame(const uint16_t *frame, const struct canny_params_struct *params,
+                             struct canny_workspace_struct *workspace, uint8_t *edges)
+{
+    canny_classify_frame(frame, params, workspace, edges);
+
+    canny_hysteresis(edges, workspace);
+
+    return;
+}
+
+/* returns 1 if any pixel of tile [x0, x1) x [y0, y1) moved by more than threshold from reference */
+static int canny_tile_changed(const uint16_t *frame, const uint16_t *reference, int width, int x0, int x1, int y0, int y1,
+                              int threshold)
+{
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            if (abs((int) frame[y * width + x] - (int) reference[y * width + x]) > threshold) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/********************************************************
+Incremental variant of canny_edge_detect_frame for mostly
+static scenes. The frame is split into
+CANNY_DELTA_TILE_SIZE tiles and a tile is recomputed only
+if one of its pixels moved by more than the workspace
+noise threshold from the pixels its classes were last
+computed from. Changed tiles next to each other in a
+tile row are recomputed together: the classes of the run
+plus a CANNY_HALO pixel halo (everything the run can
+influence) come from a window another CANNY_HALO pixels
+wider, so window borders never reach the copied classes.
+When most tiles changed the whole frame is recomputed
+instead. Hysteresis reruns only if a tile changed,
+otherwise the previous edge map is reused. Stores output
+in edges.
+********************************************************/
+void canny_edge_detect_frame_incremental(const uint16_t *frame, const struct canny_params_struct *params,
+                                         struct canny_workspace_struct *workspace, uint8_t *edges)
+{
+    const int width = workspace->width;
+    const int height = workspace->height;
+    const int tiles_x = (width + CANNY_DELTA_TILE_SIZE - 1) / CANNY_DELTA_TILE_SIZE;
+    const int tiles_y = (height + CANNY_DELTA_TILE_SIZE - 1) / CANNY_DELTA_TILE_SIZE;
+    uint8_t *changed_tiles = workspace->changed_tiles;
+    uint8_t *classes = workspace->classes;
+    int changed = 0;
+
+    for (int tile = 0; tile < tiles_x * tiles_y; tile++) {
+        int x0 = (tile % tiles_x) * CANNY_DELTA_TILE_SIZE;
+        int y0 = (tile / tiles_x) * CANNY_DELTA_TILE_SIZE;
+        int x1 = (x0 + CANNY_DELTA_TILE_SIZE < width) ? x0 + CANNY_DELTA_TILE_SIZE : width;
+        int y1 = (y0 + CANNY_DELTA_TILE_SIZE < height) ? y0 + CANNY_DELTA_TILE_SIZE : height;
+
+        changed_tiles[tile] = !workspace->has_previous
+            || canny_tile_changed(frame, workspace->reference_frame, width, x0, x1, y0, y1, workspace->noise_threshold);
+        changed += changed_tiles[tile];
+    }
+
+    workspace->tiles_total += tiles_x * tiles_y;
+    workspace->tiles_recomputed += changed;
+
+    if (changed == 0) {
+        memcpy(edges, workspace->previous_edges, width * height);
+        return;
+    }
+
+    if (changed * CANNY_DELTA_FULL_FRAME_DIVISOR > tiles_x * tiles_y) {
+        /* most of the frame moved, a single pass over it is cheaper than the windows */
+        canny_classify_frame(frame, params, workspace, classes);
+        memcpy(workspace->reference_frame, frame, sizeof(uint16_t)*width*height);
+    }
+    else {
+        for (int ty = 0; ty < tiles_y; ty++) {
+            for (int tx = 0; tx < tiles_x; tx++) {
+                if (!changed_tiles[ty * tiles_x + tx]) {
+                    continue;
+                }
+
+                /* run of changed tiles [tx, run_end) in this tile row */
+                int run_end = tx + 1;
+                while (run_end < tiles_x && changed_tiles[ty * tiles_x + run_end]) {
+                    run_end++;
+                }
+
+                int x0 = tx * CANNY_DELTA_TILE_SIZE;
+                int x1 = (run_end * CANNY_DELTA_TILE_SIZE < width) ? run_end * CANNY_DELTA_TILE_SIZE : width;
+                int y0 = ty * CANNY_DELTA_TILE_SIZE;
+                int y1 = (y0 + CANNY_DELTA_TILE_SIZE < height) ? y0 + CANNY_DELTA_TILE_SIZE : height;
+
+                /* region whose classes depend on the run, and the window that computes it */
+                int rx0 = canny_clamp(x0 - CANNY_HALO, 0, width), rx1 = canny_clamp(x1 + CANNY_HALO, 0, width);
+                int ry0 = canny_clamp(y0 - CANNY_HALO, 0, height), ry1 = canny_clamp(y1 + CANNY_HALO, 0, height);
+                int wx0 = canny_clamp(rx0 - CANNY_HALO, 0, width), wx1 = canny_clamp(rx1 + CANNY_HALO, 0, width);
+                int wy0 = canny_clamp(ry0 - CANNY_HALO, 0, height), wy1 = canny_clamp(ry1 + CANNY_HALO, 0, height);
+                int window_width = wx1 - wx0;
+
+                canny_classify_window(&frame[wy0 * width + wx0], width, window_width, wy1 - wy0, params, workspace,
+                                      workspace->window_classes);
+                for (int y = ry0; y < ry1; y++) {
+                    memcpy(&classes[y * width + rx0], &workspace->window_classes[(y - wy0) * window_width + (rx0 - wx0)],
+                           rx1 - rx0);
+                }
+                for (int y = y0; y < y1; y++) {
+                    memcpy(&workspace->reference_frame[y * width + x0], &frame[y * width + x0], sizeof(uint16_t)*(x1 - x0));
+                }
+
+                tx = run_end - 1;
+            }
+        }
+    }
+    workspace->has_previous = 1;
+
+    memcpy(edges, classes, width * height);
+    canny_hysteresis(edges, workspace);
+    memcpy(workspace->previous_edges, edges, width * height);
+
+    return;
+}
+
+/********************************************************
+Checks the fixed-point gradient magnitudes of mode
+against float magnitudes in the same norm on every
+interior pixel of frame. Stores the largest error in
+pixel units in max_error. Returns the number of pixels
+outside the documented tolerance of mode.
+********************************************************/
+int canny_check_fixed_tolerance(const uint16_t *frame, int width, int height, const struct canny_params_struct *params,
+                                int mode, float *max_error)
+{
+    float *hblur = (float*)malloc(sizeof(float)*width*height);
+    float *smooth = (float*)malloc(sizeof(float)*width*height);
+    int32_t *hblur_fixed = (int32_t*)malloc(sizeof(int32_t)*width*height);
+    int32_t *smooth_fixed = (int32_t*)malloc(sizeof(int32_t)*width*height);
+    uint32_t *magnitude_fixed = (uint32_t*)malloc(sizeof(uint32_t)*width);
+    uint8_t *direction = (uint8_t*)malloc(sizeof(uint8_t)*width);
+    float tolerance = (mode == CANNY_MODE_FIXED_L2) ? CANNY_FIXED_TOLERANCE_L2 : CANNY_FIXED_TOLERANCE_L1;
+    int failures = 0;
+
+    if (hblur == NULL || smooth == NULL || hblur_fixed == NULL || smooth_fixed == NULL || magnitude_fixed == NULL
+        || direction == NULL) {
+        printf("Memory could not be allocated for fixed-point verification\n");
+        exit(1);
+    }
+
+    /* full-frame smoothed images from the scalar kernels of both modes */
+    for (int y = 0; y < height; y++) {
+        canny_gaussian_horizontal_row(&frame[y * width], &hblur[y * width], width, params->gaussian);
+        canny_gaussian_horizontal_row_fixed(&frame[y * width], &hblur_fixed[y * width], width, params->gaussian_fixed);
+    }
+    for (int y = 0; y < height; y++) {
+        const int r[5] = {canny_clamp(y - 2, 0, height - 1), canny_clamp(y - 1, 0, height - 1), y,
+                          canny_clamp(y + 1, 0, height - 1), canny_clamp(y + 2, 0, height - 1)};
+        canny_gaussian_vertical_row(&hblur[r[0] * width], &hblur[r[1] * width], &hblur[r[2] * width], &hblur[r[3] * width],
+                                    &hblur[r[4] * width], &smooth[y * width], width, params->gaussian);
+        canny_gaussian_vertical_row_fixed(&hblur_fixed[r[0] * width], &hblur_fixed[r[1] * width], &hblur_fixed[r[2] * width],
+                                          &hblur_fixed[r[3] * width], &hblur_fixed[r[4] * width], &smooth_fixed[y * width],
+                                          width, params->gaussian_fixed);
+    }
+
+    *max_error = 0.0f;
+    for (int y = 1; y < height - 1; y++) {
+        const float *s0 = &smooth[(y - 1) * width], *s1 = &smooth[y * width], *s2 = &smooth[(y + 1) * width];
+
+        canny_sobel_row_fixed(&smooth_fixed[(y - 1) * width], &smooth_fixed[y * width], &smooth_fixed[(y + 1) * width],
+                              magnitude_fixed, direction, width, mode);
+
+        for (int x = 1; x < width - 1; x++) {
+            float gx = (s0[x + 1] - s0[x - 1]) + 2.0f * (s1[x + 1] - s1[x - 1]) + (s2[x + 1] - s2[x - 1]);
+            float gy = (s2[x - 1] + 2.0f * s2[x] + s2[x + 1]) - (s0[x - 1] + 2.0f * s0[x] + s0[x + 1]);
+            float reference = (mode == CANNY_MODE_FIXED_L2) ? sqrtf(gx * gx + gy * gy) : fabsf(gx) + fabsf(gy);
+            float error = fabsf(canny_magnitude_from_fixed(magnitude_fixed[x], mode) - reference);
+
+            if (error > *max_error) {
+                *max_error = error;
+            }
+            if (error > tolerance + CANNY_FIXED_TOLERANCE_RELATIVE * reference) {
+                failures++;
+            }
+        }
+    }
+
+    free(hblur);
+    free(smooth);
+    free(hblur_fixed);
+    free(smooth_fixed);
+    free(magnitude_fixed);
+    free(direction);
+
+    return failures;
+}
+
+/*
+    ./program filename.raw low_threshold(optional) high_threshold(optional) kernels(optional: auto, avx2, sse4.1, scalar)
+              mode(optional: float, fixed-l1, fixed-l2) noise_threshold(optional, enables incremental mode)
+              [--geometry=WxH] [--depth=bits] [--placement=spread|compact|none]
+              [--metrics-json=path] [--metrics-csv=path] [--input=mmap|read] [--input-ring=N]
+              [--pipeline=on|off] [--pipeline-depth=N]
+              [--writer=auto|uring|thread] [--writer-direct=on|off] [--writer-depth=N] [--writer-block=bytes]
+*/
 int main(int argc, char **argv)
 {
     char original_filename[50];
-    if (argc > 1) {
-        strcpy(original_filename, argv[1]);
+    float low_threshold = CANNY_LOW_THRESHOLD;
+    float high_threshold = CANNY_HIGH_THRESHOLD;
+    char *kernels_name = NULL;
+    int mode = CANNY_MODE_FLOAT;
+    int noise_threshold = -1; // incremental mode is off unless a noise threshold is given
+
+    printf("\nReading input arguments...\n");
+
+    /* --geometry=WxH and --depth=bits, everything else is positional */
+    argc = cli_options_parse(argc, argv);
+    struct frame_geometry_struct geometry;
+    frame_geometry_from_options(&geometry);
+    const size_t pixels = geometry.pixels;
+
+    if (argc < 2) {
+        printf("\nError: Invalid arguments. Please run the program as follows: ./program filename.raw low_threshold(optional) high_threshold(optional) kernels(optional: auto, avx2, sse4.1, scalar)\n"
+               "              mode(optional: float, fixed-l1, fixed-l2) noise_threshold(optional, enables incremental mode)\n"
+               "              [--geometry=WxH] [--depth=bits] [--placement=spread|compact|none]\n"
+               "              [--metrics-json=path] [--metrics-csv=path] [--input=mmap|read] [--input-ring=N]\n"
+               "              [--pipeline=on|off] [--pipeline-depth=N]\n"
+               "              [--writer=auto|uring|thread] [--writer-direct=on|off] [--writer-depth=N] [--writer-block=bytes]\n");
+        exit(0);
+    }
+
+    strcpy(original_filename, argv[1]);
+
+    printf("\nVideo filename = %s\n", original_filename);
+    frame_geometry_print(&geometry);
+
+    /* the pipeline saves the cpus of the process before the threads are pinned */
+    struct frame_pipeline_struct pipeline; // reader, edge detection and writer stages
+    frame_pipeline_from_options(&pipeline);
+
+    /*
+        Pin the OpenMP threads before anything touches the buffers. The main thread runs the row pipeline of
+        every frame and reads the file, so the frames are first touched on its node, and the hysteresis tiles
+        run on the pinned team.
+    */
+    struct thread_placement_struct placement;
+    thread_placement_from_options(&placement);
+    thread_placement_print(&placement);
+    struct frame_metrics_struct metrics; // wall clock stage times of every frame
+    frame_metrics_from_options(&metrics, pixels);
+    frame_pipeline_print(&pipeline);
+
+    if (argc > 2) {
+        low_threshold = atof(argv[2]);
+    }
+    if (argc > 3) {
+        high_threshold = atof(argv[3]);
+    }
+    if (argc > 4) {
+        kernels_name = argv[4];
+    }
+    if (argc > 5) {
+        if (strcmp(argv[5], "fixed-l1") == 0) {
+            mode = CANNY_MODE_FIXED_L1;
+        }
+        else if (strcmp(argv[5], "fixed-l2") == 0) {
+            mode = CANNY_MODE_FIXED_L2;
+        }
+        else if (strcmp(argv[5], "float") != 0) {
+            printf("\nError: Unknown mode %s. Please use float, fixed-l1 or fixed-l2.\n", argv[5]);
+            exit(1);
+        }
     }
-    
-    char encrypted_filename[50] = "encrypted.txt";
-    
+    if (argc > 6) {
+        noise_threshold = atoi(argv[6]);
+    }
+
+    printf("\nThresholds = %f (low), %f (high)\n", low_threshold, high_threshold);
+    if (noise_threshold >= 0) {
+        printf("\nIncremental mode, noise threshold = %d\n", noise_threshold);
+    }
+    printf("\nMode = %s\n", (mode == CANNY_MODE_FLOAT) ? "float" : ((mode == CANNY_MODE_FIXED_L1) ? "fixed-l1" : "fixed-l2"));
+
+    char edges_filename[50] = "edges.raw";
+
     /* declare file variables */
-	FILE* original_f;
-	FILE* encrypted_f;
-    
-    /* open original file */
+	struct frame_writer_struct edges_f;
+
+    /* map the original file, frames are paged in as they are processed */
 	printf("\nOpening original video file...\n");
-	original_f = fopen(original_filename, "r");
-	if (original_f == NULL){
-		printf("\nError: Pointer to original_f is NULL.\n");
-        exit(1);
-	}
-    
-	/* calculate filesize, number of frames, and identify start and end pointers */
-    printf("\nCalculating filesize, number of frames, and identifying start and end pointers...\n");
-    printf("\nPointer of original_f = %p\n", original_f);
-	long int position;
-    fseek(original_f, 0, SEEK_END); //seek the end of file
-	long const int filesize = ftell(original_f); //get the size of the file
-	int frames = filesize/(DIM*2);
-	printf("\nFrame count = %d\n", frames);
-	position = ftell(original_f);
-	printf("\nOffset of original_f pointer (end) = %ld\n", position);
-	rewind(original_f); //set position back to beginning    
-    position = ftell(original_f);
-	printf("\nOffset of original_f pointer (start) = %ld \n", position);
-    
-    /* allocate memory for buffer to hold original video file */
+    struct frame_source_struct source;
+    frame_source_open(&source, original_filename, 0, geometry.frame_bytes);
+    frame_source_print(&source);
+	long frames = source.frames;
+	printf("\nFrame count = %ld\n", frames);
+
+    /* allocate line buffers for the Canny pipeline */
     printf("\nAllocating memory for buffers...\n");
-    uint16_t * original_buffer;
-	original_buffer = (uint16_t*)malloc(sizeof(uint16_t)*(filesize));
-	if (original_buffer == NULL){
-		printf("Memory could not be allocated for the 16-bit original_buffer\n");
-		exit(1);
-	}
-    
-    /* read original file into original_buffer */
-	printf("\nReading original_f...\n");
-	fread(original_buffer, 2, filesize, original_f);
-	printf("\nOffset of original_f pointer (after reading) = %p\n", original_f);    
-    
-    /* cycle through frames in original_buffer and perform operations on individual frames */
+    struct canny_params_struct canny_params;
+    struct canny_workspace_struct canny_workspace;
+    canny_init_params(&canny_params, mode, CANNY_SIGMA, low_threshold, high_threshold);
+    if (canny_alloc_workspace(&canny_workspace, geometry.width, geometry.height)) {
+        printf("Memory could not be allocated for the Canny workspace\n");
+        exit(1);
+    }
+
+    /* pick Gaussian/Sobel kernels for this cpu */
+    canny_workspace.kernels = canny_select_kernels(kernels_name);
+    if (canny_workspace.kernels == NULL) {
+        printf("\nError: Kernel set %s is unknown or not supported by this cpu.\n", kernels_name);
+        exit(1);
+    }
+    printf("\nKernels = %s\n", canny_workspace.kernels->name);
+
+    /* use the whole-frame functions compiled for this geometry if there are any */
+    canny_workspace.frame_path = canny_select_frame_path(geometry.width, geometry.height);
+    printf("\nFrame path = %s\n", (canny_workspace.frame_path != NULL) ? "specialized" : "generic");
+    canny_workspace.noise_threshold = noise_threshold;
+    canny_workspace.placement = &placement;
+
+    /* the first frame takes part in the kernel checks */
+    const uint16_t *first_frame = (frames > 0) ? (const uint16_t *) frame_source_frames(&source, 0, 1) : NULL;
+
+    /* check SIMD kernels against the scalar reference on the first frame and on full-range noise */
+    printf("\nVerifying kernels...\n");
+    uint16_t *noise_frame = (uint16_t*)malloc(sizeof(uint16_t)*pixels);
+    if (noise_frame == NULL) {
+        printf("Memory could not be allocated for the 16-bit noise_frame\n");
+        exit(1);
+    }
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < pixels; i++) {
+        seed = seed * 1103515245 + 12345;
+        noise_frame[i] = (uint16_t) (seed >> 16) & geometry.max_value;
+    }
+    if ((frames > 0 && canny_verify_kernels(first_frame, geometry.width, geometry.height, &canny_params))
+        || canny_verify_kernels(noise_frame, geometry.width, geometry.height, &canny_params)) {
+        printf("\nSIMD kernels do not match the scalar reference.\n");
+        exit(1);
+    }
+    printf("\nSIMD kernels and scalar reference are identical.\n");
+
+    /* check fixed-point magnitudes against the float reference */
+    if (mode != CANNY_MODE_FLOAT) {
+        float max_error;
+        for (int check = 0; check < 2; check++) {
+            const uint16_t *check_frame = (check == 0) ? noise_frame : first_frame;
+            if (check == 1 && frames == 0) {
+                break;
+            }
+            if (canny_check_fixed_tolerance(check_frame, geometry.width, geometry.height, &canny_params, mode, &max_error)) {
+                printf("\nFixed-point magnitudes exceed the documented tolerance (max error %f).\n", max_error);
+                exit(1);
+            }
+            printf("\nFixed-point magnitudes are within tolerance of the float reference (max error %f).\n", max_error);
+        }
+    }
+    free(noise_frame);
+
+    /* open edges file */
+    printf("\nOpening output file...\n");
+    frame_writer_open(&edges_f, edges_filename);
+    frame_writer_print(&edges_f);
+
+    /* frames are read, processed and written one at a time, the whole video is there from the start */
+    frame_pipeline_init(&pipeline, &source, NULL, &metrics, &edges_f, frames, 1, sizeof(uint8_t)*pixels);
+
+    /* every option has been read, a misspelt one is an error */
+    cli_options_check_used();
+
+    /* wall clock stage times of every frame */
+    frame_metrics_start(&metrics);
+    thread_placement_start(&placement);
+    frame_pipeline_run(&pipeline);
+
+    /* cycle through the frames of the original file and perform operations on individual frames */
     printf("\nStarting operations on original_f...\n");
-	for(int f = 0; f < frames; f++){
-        printf("\nFrame number = %d\n", f);
-        uint16_t * frame = &original_buffer[f*DIM];
-        
-        /* TODO */
-        
-    }
-   
-    free(original_buffer);
-    
-    fclose(original_f);
-}
\ No newline at end of file
+    const struct frame_pipeline_slot_struct *input;
+    while ((input = frame_pipeline_input(&pipeline)) != NULL) {
+        printf("\nFrame number = %ld\n", input->first);
+        const uint16_t * frame = (const uint16_t *) input->data;
+        frame_geometry_check_pixels(frame, pixels, geometry.depth);
+        uint8_t *edges_frame = (uint8_t *) frame_pipeline_output(&pipeline)->data;
+
+        /* detect edges in a frame */
+        if (noise_threshold >= 0) {
+            canny_edge_detect_frame_incremental(frame, &canny_params, &canny_workspace, edges_frame);
+        }
+        else {
+            canny_edge_detect_frame(frame, &canny_params, &canny_workspace, edges_frame);
+        }
+
+        /* hand the edges frame to the writer */
+        frame_pipeline_computed(&pipeline);
+    }
+    frame_pipeline_free(&pipeline);
+
+    frame_metrics_report(&metrics);
+    thread_placement_report(&placement, pixels);
+    if (noise_threshold >= 0 && canny_workspace.tiles_total > 0) {
+        printf("\nRecomputed Tiles:   %ld of %ld (%0.1lf%%)\n", canny_workspace.tiles_recomputed, canny_workspace.tiles_total,
+               100.0 * canny_workspace.tiles_recomputed / canny_workspace.tiles_total);
+    }
+
+    canny_free_workspace(&canny_workspace);
+    thread_placement_free(&placement);
+    frame_metrics_free(&metrics);
+    frame_source_close(&source);
+
+    frame_writer_close(&edges_f);
+
+    return 0;
+}
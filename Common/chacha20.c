@@ -0,0 +1,358 @@
+/****************************************************************************************************************
+ChaCha20 stream cipher for the hybrid mode of the RSA tools, see chacha20.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdint.h>
+#include <string.h>
+
+/* x86 SIMD intrinsics, kernels are compiled per target and selected at runtime */
+#if defined(__x86_64__) || defined(__i386__)
+#define CHACHA20_X86 1
+#include <immintrin.h>
+#else
+#define CHACHA20_X86 0
+#endif
+
+#include "chacha20.h"
+
+#define CHACHA20_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define CHACHA20_QUARTER_ROUND(a, b, c, d) \
+    a += b; d ^= a; d = CHACHA20_ROTL(d, 16); \
+    c += d; b ^= c; b = CHACHA20_ROTL(b, 12); \
+    a += b; d ^= a; d = CHACHA20_ROTL(d, 8); \
+    c += d; b ^= c; b = CHACHA20_ROTL(b, 7)
+
+static inline uint32_t chacha20_load32(const uint8_t *bytes)
+{
+    return (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+void chacha20_init_state(uint32_t state[CHACHA20_STATE_WORDS], const uint8_t key[CHACHA20_KEY_BYTES],
+                         const uint8_t nonce[CHACHA20_NONCE_BYTES], uint32_t counter)
+{
+    /* "expand 32-byte k" */
+    state[0] = 0x61707865;
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) {
+        state[4 + i] = chacha20_load32(&key[4 * i]);
+    }
+    state[12] = counter;
+    for (int i = 0; i < 3; i++) {
+        state[13 + i] = chacha20_load32(&nonce[4 * i]);
+    }
+
+    return;
+}
+
+/* keystream block number counter of state, serialized little-endian */
+static void chacha20_block(const uint32_t state[CHACHA20_STATE_WORDS], uint32_t counter, uint8_t block[CHACHA20_BLOCK_BYTES])
+{
+    uint32_t x[CHACHA20_STATE_WORDS];
+
+    memcpy(x, state, sizeof(x));
+    x[12] = counter;
+    for (int round = 0; round < 10; round++) {
+        /* column round, then diagonal round */
+        CHACHA20_QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+        CHACHA20_QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+        CHACHA20_QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        CHACHA20_QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        CHACHA20_QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        CHACHA20_QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        CHACHA20_QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+        CHACHA20_QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < CHACHA20_STATE_WORDS; i++) {
+        uint32_t word = x[i] + ((i == 12) ? counter : state[i]);
+        block[4 * i] = (uint8_t) word;
+        block[4 * i + 1] = (uint8_t) (word >> 8);
+        block[4 * i + 2] = (uint8_t) (word >> 16);
+        block[4 * i + 3] = (uint8_t) (word >> 24);
+    }
+
+    return;
+}
+
+/* reference kernel, one block at a time; also finishes the tails of the vector kernels */
+static void chacha20_xor_stream(const uint32_t state[CHACHA20_STATE_WORDS], const uint8_t *in, uint8_t *out, size_t bytes)
+{
+    uint8_t block[CHACHA20_BLOCK_BYTES];
+    uint32_t counter = state[12];
+
+    for (size_t start = 0; start < bytes; start += CHACHA20_BLOCK_BYTES, counter++) {
+        size_t count = (bytes - start < CHACHA20_BLOCK_BYTES) ? bytes - start : CHACHA20_BLOCK_BYTES;
+        chacha20_block(state, counter, block);
+        for (size_t i = 0; i < count; i++) {
+            out[start + i] = in[start + i] ^ block[i];
+        }
+    }
+
+    return;
+}
+
+/* runs the reference kernel on the bytes left after blocks full blocks */
+static void chacha20_xor_tail(const uint32_t state[CHACHA20_STATE_WORDS], size_t blocks, const uint8_t *in, uint8_t *out,
+                              size_t bytes)
+{
+    uint32_t tail_state[CHACHA20_STATE_WORDS];
+    size_t done = blocks * CHACHA20_BLOCK_BYTES;
+
+    if (done < bytes) {
+        memcpy(tail_state, state, sizeof(tail_state));
+        tail_state[12] += (uint32_t) blocks;
+        chacha20_xor_stream(tail_state, &in[done], &out[done], bytes - done);
+    }
+
+    return;
+}
+
+#if CHACHA20_X86
+
+/*
+    The vector kernels keep word i of several consecutive blocks in one register (lane j holds block counter + j),
+    run the rounds on all of them at once and transpose the words back into serialized blocks.
+*/
+
+#define CHACHA20_ROTL_SSE2(x, n) _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+
+#define CHACHA20_QUARTER_ROUND_SSE2(a, b, c, d) \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = CHACHA20_ROTL_SSE2(d, 16); \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = CHACHA20_ROTL_SSE2(b, 12); \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = CHACHA20_ROTL_SSE2(d, 8); \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = CHACHA20_ROTL_SSE2(b, 7)
+
+/* four blocks per iteration */
+__attribute__((target("sse2")))
+static void chacha20_xor_stream_sse2(const uint32_t state[CHACHA20_STATE_WORDS], const uint8_t *in, uint8_t *out,
+                                     size_t bytes)
+{
+    size_t blocks = bytes / CHACHA20_BLOCK_BYTES / 4 * 4;
+
+    for (size_t b = 0; b < blocks; b += 4) {
+        __m128i initial[CHACHA20_STATE_WORDS];
+        __m128i x[CHACHA20_STATE_WORDS];
+
+        for (int i = 0; i < CHACHA20_STATE_WORDS; i++) {
+            initial[i] = _mm_set1_epi32((int) state[i]);
+        }
+        initial[12] = _mm_add_epi32(_mm_set1_epi32((int) (state[12] + (uint32_t) b)), _mm_setr_epi32(0, 1, 2, 3));
+        memcpy(x, initial, sizeof(x));
+
+        for (int round = 0; round < 10; round++) {
+            CHACHA20_QUARTER_ROUND_SSE2(x[0], x[4], x[8], x[12]);
+            CHACHA20_QUARTER_ROUND_SSE2(x[1], x[5], x[9], x[13]);
+            CHACHA20_QUARTER_ROUND_SSE2(x[2], x[6], x[10], x[14]);
+            CHACHA20_QUARTER_ROUND_SSE2(x[3], x[7], x[11], x[15]);
+            CHACHA20_QUARTER_ROUND_SSE2(x[0], x[5], x[10], x[15]);
+            CHACHA20_QUARTER_ROUND_SSE2(x[1], x[6], x[11], x[12]);
+            CHACHA20_QUARTER_ROUND_SSE2(x[2], x[7], x[8], x[13]);
+            CHACHA20_QUARTER_ROUND_SSE2(x[3], x[4], x[9], x[14]);
+        }
+
+        /* words 4q..4q+3 of the four blocks, transposed 4x4 */
+        for (int q = 0; q < 4; q++) {
+            __m128i a0 = _mm_add_epi32(x[4 * q], initial[4 * q]);
+            __m128i a1 = _mm_add_epi32(x[4 * q + 1], initial[4 * q + 1]);
+            __m128i a2 = _mm_add_epi32(x[4 * q + 2], initial[4 * q + 2]);
+            __m128i a3 = _mm_add_epi32(x[4 * q + 3], initial[4 * q + 3]);
+            __m128i t0 = _mm_unpacklo_epi32(a0, a1);
+            __m128i t1 = _mm_unpacklo_epi32(a2, a3);
+            __m128i t2 = _mm_unpackhi_epi32(a0, a1);
+            __m128i t3 = _mm_unpackhi_epi32(a2, a3);
+            __m128i words[4] = { _mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1), _mm_unpacklo_epi64(t2, t3),
+                                 _mm_unpackhi_epi64(t2, t3) };
+            for (int j = 0; j < 4; j++) {
+                size_t offset = (b + (size_t) j) * CHACHA20_BLOCK_BYTES + 16 * (size_t) q;
+                __m128i data = _mm_loadu_si128((const __m128i *) &in[offset]);
+                _mm_storeu_si128((__m128i *) &out[offset], _mm_xor_si128(data, words[j]));
+            }
+        }
+    }
+    chacha20_xor_tail(state, blocks, in, out, bytes);
+
+    return;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i chacha20_rotl_avx2(__m256i x, int n)
+{
+    /* byte rotations are a single shuffle */
+    if (n == 16) {
+        return _mm256_shuffle_epi8(x, _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                                       2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+    }
+    if (n == 8) {
+        return _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                                       3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14));
+    }
+    return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+#define CHACHA20_QUARTER_ROUND_AVX2(a, b, c, d) \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = chacha20_rotl_avx2(d, 16); \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); b = chacha20_rotl_avx2(b, 12); \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = chacha20_rotl_avx2(d, 8); \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); b = chacha20_rotl_avx2(b, 7)
+
+/* eight blocks per iteration */
+__attribute__((target("avx2")))
+static void chacha20_xor_stream_avx2(const uint32_t state[CHACHA20_STATE_WORDS], const uint8_t *in, uint8_t *out,
+                                     size_t bytes)
+{
+    size_t blocks = bytes / CHACHA20_BLOCK_BYTES / 8 * 8;
+
+    for (size_t b = 0; b < blocks; b += 8) {
+        __m256i initial[CHACHA20_STATE_WORDS];
+        __m256i x[CHACHA20_STATE_WORDS];
+
+        for (int i = 0; i < CHACHA20_STATE_WORDS; i++) {
+            initial[i] = _mm256_set1_epi32((int) state[i]);
+        }
+        initial[12] = _mm256_add_epi32(_mm256_set1_epi32((int) (state[12] + (uint32_t) b)),
+                                       _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        memcpy(x, initial, sizeof(x));
+
+        for (int round = 0; round < 10; round++) {
+            CHACHA20_QUARTER_ROUND_AVX2(x[0], x[4], x[8], x[12]);
+            CHACHA20_QUARTER_ROUND_AVX2(x[1], x[5], x[9], x[13]);
+            CHACHA20_QUARTER_ROUND_AVX2(x[2], x[6], x[10], x[14]);
+            CHACHA20_QUARTER_ROUND_AVX2(x[3], x[7], x[11], x[15]);
+            CHACHA20_QUARTER_ROUND_AVX2(x[0], x[5], x[10], x[15]);
+            CHACHA20_QUARTER_ROUND_AVX2(x[1], x[6], x[11], x[12]);
+            CHACHA20_QUARTER_ROUND_AVX2(x[2], x[7], x[8], x[13]);
+            CHACHA20_QUARTER_ROUND_AVX2(x[3], x[4], x[9], x[14]);
+        }
+
+        /* words 8h..8h+7 of the eight blocks, transposed 8x8 */
+        for (int h = 0; h < 2; h++) {
+            __m256i a[8];
+            for (int i = 0; i < 8; i++) {
+                a[i] = _mm256_add_epi32(x[8 * h + i], initial[8 * h + i]);
+            }
+            __m256i t0 = _mm256_unpacklo_epi32(a[0], a[1]);
+            __m256i t1 = _mm256_unpackhi_epi32(a[0], a[1]);
+            __m256i t2 = _mm256_unpacklo_epi32(a[2], a[3]);
+            __m256i t3 = _mm256_unpackhi_epi32(a[2], a[3]);
+            __m256i t4 = _mm256_unpacklo_epi32(a[4], a[5]);
+            __m256i t5 = _mm256_unpackhi_epi32(a[4], a[5]);
+            __m256i t6 = _mm256_unpacklo_epi32(a[6], a[7]);
+            __m256i t7 = _mm256_unpackhi_epi32(a[6], a[7]);
+            /* u[j] holds words 8h..8h+3 of blocks j (low half) and j + 4 (high half), v[j] words 8h+4..8h+7 */
+            __m256i u[4] = { _mm256_unpacklo_epi64(t0, t2), _mm256_unpackhi_epi64(t0, t2), _mm256_unpacklo_epi64(t1, t3),
+                             _mm256_unpackhi_epi64(t1, t3) };
+            __m256i v[4] = { _mm256_unpacklo_epi64(t4, t6), _mm256_unpackhi_epi64(t4, t6), _mm256_unpacklo_epi64(t5, t7),
+                             _mm256_unpackhi_epi64(t5, t7) };
+            for (int j = 0; j < 4; j++) {
+                __m256i words[2] = { _mm256_permute2x128_si256(u[j], v[j], 0x20), _mm256_permute2x128_si256(u[j], v[j], 0x31) };
+                for (int k = 0; k < 2; k++) {
+                    size_t offset = (b + (size_t) (j + 4 * k)) * CHACHA20_BLOCK_BYTES + 32 * (size_t) h;
+                    __m256i data = _mm256_loadu_si256((const __m256i *) &in[offset]);
+                    _mm256_storeu_si256((__m256i *) &out[offset], _mm256_xor_si256(data, words[k]));
+                }
+            }
+        }
+    }
+    chacha20_xor_tail(state, blocks, in, out, bytes);
+
+    return;
+}
+
+#endif
+
+/* fastest first */
+static const struct chacha20_kernels_struct chacha20_kernel_sets[] = {
+#if CHACHA20_X86
+    {"avx2", chacha20_xor_stream_avx2},
+    {"sse2", chacha20_xor_stream_sse2},
+#endif
+    {"scalar", chacha20_xor_stream},
+};
+#define CHACHA20_KERNEL_SETS ((int) (sizeof(chacha20_kernel_sets) / sizeof(chacha20_kernel_sets[0])))
+
+/* returns 1 if the cpu running the program can execute the named kernel set */
+static int chacha20_kernels_supported(const char *name)
+{
+#if CHACHA20_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (strcmp(name, "sse2") == 0) {
+        return __builtin_cpu_supports("sse2");
+    }
+#endif
+    return strcmp(name, "scalar") == 0;
+}
+
+const struct chacha20_kernels_struct *chacha20_select_kernels(const char *name)
+{
+    for (int k = 0; k < CHACHA20_KERNEL_SETS; k++) {
+        if (name != NULL && strcmp(name, "auto") != 0 && strcmp(name, chacha20_kernel_sets[k].name) != 0) {
+            continue;
+        }
+        if (chacha20_kernels_supported(chacha20_kernel_sets[k].name)) {
+            return &chacha20_kernel_sets[k];
+        }
+    }
+
+    return NULL;
+}
+
+/********************************************************
+Checks the scalar kernel on the RFC 8439 section 2.4.2
+test vector, then runs every supported kernel set over
+a length that is not a multiple of any block group so
+the tails are covered too, and compares with the scalar
+kernel.
+********************************************************/
+int chacha20_verify_kernels(void)
+{
+    static const char plaintext[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the "
+                                    "future, sunscreen would be it.";
+    static const uint8_t ciphertext[] = {
+        0x6e, 0x2e, 0x35, 0x9a, 0x25, 0x68, 0xf9, 0x80, 0x41, 0xba, 0x07, 0x28, 0xdd, 0x0d, 0x69, 0x81,
+        0xe9, 0x7e, 0x7a, 0xec, 0x1d, 0x43, 0x60, 0xc2, 0x0a, 0x27, 0xaf, 0xcc, 0xfd, 0x9f, 0xae, 0x0b,
+        0xf9, 0x1b, 0x65, 0xc5, 0x52, 0x47, 0x33, 0xab, 0x8f, 0x59, 0x3d, 0xab, 0xcd, 0x62, 0xb3, 0x57,
+        0x16, 0x39, 0xd6, 0x24, 0xe6, 0x51, 0x52, 0xab, 0x8f, 0x53, 0x0c, 0x35, 0x9f, 0x08, 0x61, 0xd8,
+        0x07, 0xca, 0x0d, 0xbf, 0x50, 0x0d, 0x6a, 0x61, 0x56, 0xa3, 0x8e, 0x08, 0x8a, 0x22, 0xb6, 0x5e,
+        0x52, 0xbc, 0x51, 0x4d, 0x16, 0xcc, 0xf8, 0x06, 0x81, 0x8c, 0xe9, 0x1a, 0xb7, 0x79, 0x37, 0x36,
+        0x5a, 0xf9, 0x0b, 0xbf, 0x74, 0xa3, 0x5b, 0xe6, 0xb4, 0x0b, 0x8e, 0xed, 0xf2, 0x78, 0x5e, 0x42,
+        0x87, 0x4d
+    };
+    enum { bytes = 17 * CHACHA20_BLOCK_BYTES + 13 };
+    uint8_t key[CHACHA20_KEY_BYTES];
+    uint8_t nonce[CHACHA20_NONCE_BYTES] = { 0, 0, 0, 0, 0, 0, 0, 0x4a, 0, 0, 0, 0 };
+    uint32_t state[CHACHA20_STATE_WORDS];
+    uint8_t data[bytes];
+    uint8_t expected[bytes];
+    uint8_t result[bytes];
+
+    for (int i = 0; i < CHACHA20_KEY_BYTES; i++) {
+        key[i] = (uint8_t) i;
+    }
+    chacha20_init_state(state, key, nonce, 1);
+    chacha20_xor_stream(state, (const uint8_t *) plaintext, result, sizeof(ciphertext));
+    if (memcmp(result, ciphertext, sizeof(ciphertext)) != 0) {
+        return 1;
+    }
+
+    for (int i = 0; i < bytes; i++) {
+        data[i] = (uint8_t) (i * 7 + 3);
+    }
+    chacha20_xor_stream(state, data, expected, bytes);
+    for (int k = 0; k < CHACHA20_KERNEL_SETS; k++) {
+        if (!chacha20_kernels_supported(chacha20_kernel_sets[k].name)) {
+            continue;
+        }
+        chacha20_kernel_sets[k].xor_stream(state, data, result, bytes);
+        if (memcmp(result, expected, bytes) != 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,35 @@
+/****************************************************************************************************************
+ChaCha20 stream cipher (RFC 8439) for the hybrid mode of the RSA tools. The keystream of a 64-byte block depends
+only on the key, the nonce and the block counter, so any frame can be enciphered or deciphered on its own. Like the
+Montgomery kernels, the block function comes in kernel sets (several blocks per SIMD register on AVX2 and SSE2, one
+at a time on any cpu) that are picked at runtime and verified against the scalar reference.
+****************************************************************************************************************/
+
+#ifndef CHACHA20_H
+#define CHACHA20_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHACHA20_KEY_BYTES 32
+#define CHACHA20_NONCE_BYTES 12
+#define CHACHA20_BLOCK_BYTES 64
+#define CHACHA20_STATE_WORDS 16
+
+/* state[0..3] constants, state[4..11] key, state[12] block counter, state[13..15] nonce, all little-endian */
+void chacha20_init_state(uint32_t state[CHACHA20_STATE_WORDS], const uint8_t key[CHACHA20_KEY_BYTES],
+                         const uint8_t nonce[CHACHA20_NONCE_BYTES], uint32_t counter);
+
+struct chacha20_kernels_struct {
+    const char *name;
+    /* out = in XOR keystream of state from its block counter on, for bytes bytes (any count, in and out may be the same) */
+    void (*xor_stream)(const uint32_t state[CHACHA20_STATE_WORDS], const uint8_t *in, uint8_t *out, size_t bytes);
+};
+
+/* returns the named kernel set ("avx2", "sse2" or "scalar"), or the fastest supported one for NULL or "auto", NULL if unsupported */
+const struct chacha20_kernels_struct *chacha20_select_kernels(const char *name);
+
+/* checks the scalar kernel against the RFC 8439 test vector and every supported kernel set against it, returns 0 if they match */
+int chacha20_verify_kernels(void);
+
+#endif
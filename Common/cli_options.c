@@ -0,0 +1,97 @@
+/****************************************************************************************************************
+Command line options shared by the video processing tools, see cli_options.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli_options.h"
+
+struct cli_option_struct {
+    const char *name; // points into argv, not terminated at the '='
+    size_t name_length;
+    const char *value;
+    int used; // looked up by cli_option
+};
+
+static struct cli_option_struct cli_options[CLI_MAX_OPTIONS];
+static int cli_option_count = 0;
+
+/********************************************************
+Splits the command line into options and positional
+arguments. Every argument of the form --name=value (or
+--name, which gets the value "1") is recorded and removed
+from argv, the positional arguments are moved to the
+front in their original order. Returns the number of
+arguments left in argv, argv[0] included.
+********************************************************/
+int cli_options_parse(int argc, char **argv)
+{
+    int positional = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0 || argv[i][2] == '\0') {
+            argv[positional++] = argv[i];
+            continue;
+        }
+
+        if (cli_option_count == CLI_MAX_OPTIONS) {
+            printf("\nError: Too many options, at most %d are supported.\n", CLI_MAX_OPTIONS);
+            exit(1);
+        }
+
+        const char *name = &argv[i][2];
+        const char *equals = strchr(name, '=');
+        cli_options[cli_option_count].name = name;
+        cli_options[cli_option_count].name_length = (equals != NULL) ? (size_t) (equals - name) : strlen(name);
+        cli_options[cli_option_count].value = (equals != NULL) ? equals + 1 : "1";
+        cli_options[cli_option_count].used = 0;
+        cli_option_count++;
+    }
+    argv[positional] = NULL;
+
+    return positional;
+}
+
+/********************************************************
+Looks up an option recorded by cli_options_parse. When
+an option is given more than once the last one wins, and
+all of its copies count as used.
+********************************************************/
+const char *cli_option(const char *name)
+{
+    size_t length = strlen(name);
+    const char *value = NULL;
+
+    for (int i = cli_option_count - 1; i >= 0; i--) {
+        if (cli_options[i].name_length == length && strncmp(cli_options[i].name, name, length) == 0) {
+            if (value == NULL) {
+                value = cli_options[i].value;
+            }
+            cli_options[i].used = 1;
+        }
+    }
+
+    return value;
+}
+
+/********************************************************
+Options are looked up where they take effect, so an
+option left unused is either unknown to the tool or one
+the other settings leave without effect (for example
+--rsa-kernels with a key on the GMP backend).
+********************************************************/
+void cli_options_check_used(void)
+{
+    for (int i = 0; i < cli_option_count; i++) {
+        if (!cli_options[i].used) {
+            printf("\nError: Unknown option --%.*s, or it has no effect with the other settings.\n",
+                   (int) cli_options[i].name_length, cli_options[i].name);
+            exit(1);
+        }
+    }
+
+    return;
+}
@@ -0,0 +1,22 @@
+/****************************************************************************************************************
+Command line options shared by the video processing tools. Options are written as --name=value anywhere on the
+command line, everything else stays a positional argument in its original order. An option no part of the tool
+looked up is an error (cli_options_check_used), so a misspelt option does not silently fall back to a default.
+****************************************************************************************************************/
+
+#ifndef CLI_OPTIONS_H
+#define CLI_OPTIONS_H
+
+#define CLI_MAX_OPTIONS 32
+
+/* removes --name=value options from argv and returns the new argc (positional arguments only) */
+int cli_options_parse(int argc, char **argv);
+
+/* returns the value of option --name=value, or NULL if it was not given, and marks the option as used */
+const char *cli_option(const char *name);
+
+/* exits with an error if an option was given that no cli_option call looked up, called once the tool has read all
+   of its options */
+void cli_options_check_used(void);
+
+#endif
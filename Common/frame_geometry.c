@@ -0,0 +1,96 @@
+/****************************************************************************************************************
+Frame geometry shared by the video processing tools, see frame_geometry.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli_options.h"
+#include "frame_geometry.h"
+
+int frame_geometry_init(struct frame_geometry_struct *geometry, int width, int height, int depth)
+{
+    if (width < 1 || width > FRAME_MAX_SIDE || height < 1 || height > FRAME_MAX_SIDE
+        || depth < 1 || depth > FRAME_MAX_DEPTH) {
+        return 1;
+    }
+
+    geometry->width = width;
+    geometry->height = height;
+    geometry->depth = depth;
+    geometry->pixels = (size_t) width * height;
+    geometry->frame_bytes = geometry->pixels * sizeof(uint16_t);
+    geometry->max_value = (uint16_t) ((1u << depth) - 1);
+
+    return 0;
+}
+
+/********************************************************
+Reads --geometry=WxH (e.g. 640x512) and --depth=bits.
+Missing options keep the 256 x 256, 16-bit defaults.
+Prints an error and exits on a malformed or out of
+range value.
+********************************************************/
+void frame_geometry_from_options(struct frame_geometry_struct *geometry)
+{
+    const char *size = cli_option("geometry");
+    const char *depth = cli_option("depth");
+    int width = FRAME_DEFAULT_WIDTH;
+    int height = FRAME_DEFAULT_HEIGHT;
+    int bits = FRAME_DEFAULT_DEPTH;
+    char extra;
+
+    if (size != NULL && sscanf(size, "%dx%d%c", &width, &height, &extra) != 2) {
+        printf("\nError: Invalid geometry %s. Please use --geometry=WIDTHxHEIGHT, e.g. --geometry=640x512.\n", size);
+        exit(1);
+    }
+    if (depth != NULL && sscanf(depth, "%d%c", &bits, &extra) != 1) {
+        printf("\nError: Invalid depth %s. Please use --depth=bits, e.g. --depth=14.\n", depth);
+        exit(1);
+    }
+
+    if (frame_geometry_init(geometry, width, height, bits)) {
+        printf("\nError: Unsupported geometry %dx%d, %d bits. Sides must be 1 to %d pixels and depth 1 to %d bits.\n",
+               width, height, bits, FRAME_MAX_SIDE, FRAME_MAX_DEPTH);
+        exit(1);
+    }
+
+    return;
+}
+
+/********************************************************
+The pixels are or'ed together first, a single pass the
+compiler vectorizes; only a frame with a pixel above the
+depth is searched for it, for the error message.
+********************************************************/
+void frame_geometry_check_pixels(const uint16_t *pixels, size_t count, int depth)
+{
+    uint16_t above = 0;
+
+    if (depth >= FRAME_MAX_DEPTH) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        above |= pixels[i];
+    }
+    if ((above >> depth) == 0) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if ((pixels[i] >> depth) != 0) {
+            printf("\nError: Pixel value %u does not fit in %d bits. Please check --depth.\n", (unsigned int) pixels[i], depth);
+            exit(1);
+        }
+    }
+
+    return;
+}
+
+void frame_geometry_print(const struct frame_geometry_struct *geometry)
+{
+    printf("\nFrame geometry = %d x %d pixels, %d bits per pixel\n", geometry->width, geometry->height, geometry->depth);
+
+    return;
+}
@@ -0,0 +1,42 @@
+/****************************************************************************************************************
+Frame geometry shared by the video processing tools. Raw video files are a sequence of width x height frames,
+every pixel stored in 2 bytes (little endian) with depth significant bits. The geometry is given on the command
+line as --geometry=WxH and --depth=bits and defaults to the 256 x 256, 16-bit frames of the original sensor. A
+pixel above the depth is an input error (frame_geometry_check_pixels); the RSA tools size their tables and pack
+their blocks by the depth.
+****************************************************************************************************************/
+
+#ifndef FRAME_GEOMETRY_H
+#define FRAME_GEOMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_DEFAULT_WIDTH 256
+#define FRAME_DEFAULT_HEIGHT 256
+#define FRAME_DEFAULT_DEPTH 16
+#define FRAME_MAX_DEPTH 16 // pixels are stored in 2 bytes whatever their depth
+#define FRAME_MAX_SIDE 16384
+
+struct frame_geometry_struct {
+    int width;
+    int height;
+    int depth; // significant bits per pixel
+    size_t pixels; // width * height
+    size_t frame_bytes; // bytes per frame of 2 byte pixels
+    uint16_t max_value; // largest pixel value, (1 << depth) - 1
+};
+
+/* fills geometry for a width x height frame of depth bit pixels, returns nonzero if the values are out of range */
+int frame_geometry_init(struct frame_geometry_struct *geometry, int width, int height, int depth);
+
+/* fills geometry from the --geometry and --depth options (see cli_options.h), exits with an error if they are invalid */
+void frame_geometry_from_options(struct frame_geometry_struct *geometry);
+
+/* exits with an error if one of the pixels has more than depth bits, returns at once for 16-bit depth */
+void frame_geometry_check_pixels(const uint16_t *pixels, size_t count, int depth);
+
+/* prints the geometry in the style of the tools' other settings */
+void frame_geometry_print(const struct frame_geometry_struct *geometry);
+
+#endif
@@ -0,0 +1,245 @@
+/****************************************************************************************************************
+Per-frame wall clock metrics of the video processing tools, see frame_metrics.h.
+****************************************************************************************************************/
+
+/* clock_gettime and CLOCK_MONOTONIC */
+#define _POSIX_C_SOURCE 200112L
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cli_options.h"
+#include "frame_metrics.h"
+
+#define FRAME_METRICS_STAGES 4
+
+static const char *const frame_metrics_stage_names[FRAME_METRICS_STAGES] = {"ingest", "compute", "write", "end_to_end"};
+static const char *const frame_metrics_stage_labels[FRAME_METRICS_STAGES] = {"Ingest", "Compute", "Write", "End-to-End"};
+
+static FILE *frame_metrics_open(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        printf("\nError: Could not create metrics file %s.\n", path);
+        exit(1);
+    }
+
+    return f;
+}
+
+void frame_metrics_from_options(struct frame_metrics_struct *metrics, size_t frame_pixels)
+{
+    #ifdef _OPENMP
+    metrics->threads = omp_get_max_threads();
+    #else
+    metrics->threads = 1;
+    #endif
+    metrics->frame_pixels = frame_pixels;
+    metrics->buffers = (struct frame_metrics_buffer_struct *) calloc(metrics->threads, sizeof(struct frame_metrics_buffer_struct));
+    if (metrics->buffers == NULL) {
+        printf("Memory could not be allocated for the frame metrics\n");
+        exit(1);
+    }
+
+    /* the files are created up front, so a bad path fails before the frames are processed */
+    metrics->json_path = cli_option("metrics-json");
+    metrics->csv_path = cli_option("metrics-csv");
+    metrics->json = (metrics->json_path != NULL) ? frame_metrics_open(metrics->json_path) : NULL;
+    metrics->csv = (metrics->csv_path != NULL) ? frame_metrics_open(metrics->csv_path) : NULL;
+    metrics->start = frame_metrics_now();
+
+    return;
+}
+
+void frame_metrics_free(struct frame_metrics_struct *metrics)
+{
+    for (int t = 0; t < metrics->threads; t++) {
+        free(metrics->buffers[t].samples);
+    }
+    free(metrics->buffers);
+    if (metrics->json != NULL) {
+        fclose(metrics->json);
+    }
+    if (metrics->csv != NULL) {
+        fclose(metrics->csv);
+    }
+
+    return;
+}
+
+double frame_metrics_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + 1e-9 * (double) now.tv_nsec;
+}
+
+void frame_metrics_start(struct frame_metrics_struct *metrics)
+{
+    for (int t = 0; t < metrics->threads; t++) {
+        metrics->buffers[t].count = 0;
+    }
+    metrics->start = frame_metrics_now();
+
+    return;
+}
+
+/********************************************************
+Appends the stage times of a frame to the buffer of the
+calling thread. No other thread reads or writes that
+buffer before frame_metrics_report, so recording takes
+no lock; a full buffer doubles in place.
+********************************************************/
+void frame_metrics_record(struct frame_metrics_struct *metrics, long frame, const struct frame_metrics_times_struct *times)
+{
+    #ifdef _OPENMP
+    struct frame_metrics_buffer_struct *buffer = &metrics->buffers[omp_get_thread_num()];
+    #else
+    struct frame_metrics_buffer_struct *buffer = &metrics->buffers[0];
+    #endif
+
+    if (buffer->count == buffer->capacity) {
+        size_t capacity = (buffer->capacity > 0) ? 2 * buffer->capacity : FRAME_METRICS_INITIAL_SAMPLES;
+        struct frame_metrics_sample_struct *samples = (struct frame_metrics_sample_struct *) realloc(
+            buffer->samples, sizeof(struct frame_metrics_sample_struct) * capacity);
+        if (samples == NULL) {
+            printf("Memory could not be allocated for the frame metrics\n");
+            exit(1);
+        }
+        buffer->samples = samples;
+        buffer->capacity = capacity;
+    }
+
+    struct frame_metrics_sample_struct *sample = &buffer->samples[buffer->count++];
+    sample->frame = frame;
+    sample->ingest = times->ingested - times->start;
+    sample->compute = times->computed - times->ingested;
+    sample->write = times->written - times->computed;
+    sample->latency = times->written - times->arrival;
+
+    return;
+}
+
+static double frame_metrics_stage(const struct frame_metrics_sample_struct *sample, int stage)
+{
+    switch (stage) {
+        case 0: return sample->ingest;
+        case 1: return sample->compute;
+        case 2: return sample->write;
+        default: return sample->latency;
+    }
+}
+
+static int frame_metrics_compare_values(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+static int frame_metrics_compare_frames(const void *a, const void *b)
+{
+    long x = ((const struct frame_metrics_sample_struct *) a)->frame;
+    long y = ((const struct frame_metrics_sample_struct *) b)->frame;
+
+    return (x > y) - (x < y);
+}
+
+/* nearest-rank percentile of count sorted values */
+static double frame_metrics_percentile(const double *sorted, size_t count, int percent)
+{
+    size_t rank = (count * (size_t) percent + 99) / 100;
+
+    return sorted[(rank > 0) ? rank - 1 : 0];
+}
+
+/********************************************************
+Merges the samples of all threads, prints the execution
+time, frames/s and pixels/s over the wall clock since
+frame_metrics_start and the percentiles of every stage in
+milliseconds, and writes the JSON summary (seconds) and
+the CSV samples in frame order.
+********************************************************/
+void frame_metrics_report(struct frame_metrics_struct *metrics)
+{
+    double seconds = frame_metrics_now() - metrics->start;
+    size_t count = 0;
+
+    for (int t = 0; t < metrics->threads; t++) {
+        count += metrics->buffers[t].count;
+    }
+    struct frame_metrics_sample_struct *samples = (struct frame_metrics_sample_struct *) malloc(
+        sizeof(struct frame_metrics_sample_struct) * (count + 1));
+    double *values = (double *) malloc(sizeof(double) * (count + 1));
+    if (samples == NULL || values == NULL) {
+        printf("Memory could not be allocated for the frame metrics\n");
+        exit(1);
+    }
+    size_t merged = 0;
+    for (int t = 0; t < metrics->threads && count > 0; t++) {
+        memcpy(&samples[merged], metrics->buffers[t].samples, sizeof(struct frame_metrics_sample_struct) * metrics->buffers[t].count);
+        merged += metrics->buffers[t].count;
+    }
+    qsort(samples, count, sizeof(struct frame_metrics_sample_struct), frame_metrics_compare_frames);
+
+    double frame_rate = (seconds > 0.0) ? (double) count / seconds : 0.0;
+    double pixel_rate = frame_rate * (double) metrics->frame_pixels;
+    printf("\nExecution Time:   %0.6lf seconds\n", seconds);
+    printf("\nThroughput:   %0.2lf frames/sec, %0.0lf pixels/sec\n", frame_rate, pixel_rate);
+
+    if (metrics->json != NULL) {
+        fprintf(metrics->json, "{\n  \"frames\": %zu,\n  \"frame_pixels\": %zu,\n  \"seconds\": %.9f,\n", count,
+                metrics->frame_pixels, seconds);
+        fprintf(metrics->json, "  \"frames_per_second\": %.6f,\n  \"pixels_per_second\": %.3f,\n  \"latency_seconds\": {\n",
+                frame_rate, pixel_rate);
+    }
+    if (count > 0) {
+        printf("\nFrame Latency (ms):   %12s %12s %12s %12s\n", "p50", "p90", "p99", "max");
+    }
+    for (int stage = 0; stage < FRAME_METRICS_STAGES && count > 0; stage++) {
+        for (size_t i = 0; i < count; i++) {
+            values[i] = frame_metrics_stage(&samples[i], stage);
+        }
+        qsort(values, count, sizeof(double), frame_metrics_compare_values);
+        double p50 = frame_metrics_percentile(values, count, 50);
+        double p90 = frame_metrics_percentile(values, count, 90);
+        double p99 = frame_metrics_percentile(values, count, 99);
+        double max = values[count - 1];
+
+        printf("    %-18s%12.3lf %12.3lf %12.3lf %12.3lf\n", frame_metrics_stage_labels[stage], 1e3 * p50, 1e3 * p90,
+               1e3 * p99, 1e3 * max);
+        if (metrics->json != NULL) {
+            fprintf(metrics->json, "    \"%s\": {\"p50\": %.9f, \"p90\": %.9f, \"p99\": %.9f, \"max\": %.9f}%s\n",
+                    frame_metrics_stage_names[stage], p50, p90, p99, max, (stage + 1 < FRAME_METRICS_STAGES) ? "," : "");
+        }
+    }
+
+    if (metrics->json != NULL) {
+        fprintf(metrics->json, "  }\n}\n");
+        fflush(metrics->json);
+        printf("\nMetrics written to %s\n", metrics->json_path);
+    }
+    if (metrics->csv != NULL) {
+        fprintf(metrics->csv, "frame,ingest_seconds,compute_seconds,write_seconds,end_to_end_seconds\n");
+        for (size_t i = 0; i < count; i++) {
+            fprintf(metrics->csv, "%ld,%.9f,%.9f,%.9f,%.9f\n", samples[i].frame, samples[i].ingest, samples[i].compute,
+                    samples[i].write, samples[i].latency);
+        }
+        fflush(metrics->csv);
+        printf("\nSamples written to %s\n", metrics->csv_path);
+    }
+
+    free(samples);
+    free(values);
+
+    return;
+}
@@ -0,0 +1,74 @@
+/****************************************************************************************************************
+Per-frame wall clock metrics of the video processing tools. For every frame the tools record when the sensor
+delivered it (frame_pacer_arrival), when they started on it, and when its input was in memory, its result computed
+and written, all on CLOCK_MONOTONIC. From these come the ingest, compute and write time of the frame and its
+end-to-end latency, from arrival to written. Samples go to a buffer of the recording thread, which only that thread
+appends to, so threads never synchronize while recording.
+
+frame_metrics_report prints the wall clock execution time, frames/s, pixels/s and the p50/p90/p99/max of every
+stage. --metrics-json=path also writes that summary as JSON, --metrics-csv=path every sample as one CSV row.
+****************************************************************************************************************/
+
+#ifndef FRAME_METRICS_H
+#define FRAME_METRICS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define FRAME_METRICS_LINE_BYTES 64 // per-thread buffers sit on cache lines of their own
+#define FRAME_METRICS_INITIAL_SAMPLES 256 // first allocation of a thread's buffer, doubled when full
+
+/* when a frame went through the stages of a tool, CLOCK_MONOTONIC seconds (frame_metrics_now) */
+struct frame_metrics_times_struct {
+    double arrival; // the sensor delivered the frame, start of the end-to-end latency
+    double start; // the tool started to ingest the frame
+    double ingested; // the input of the frame is in memory
+    double computed; // the result of the frame is computed
+    double written; // the result of the frame is written
+};
+
+struct frame_metrics_sample_struct {
+    long frame;
+    double ingest; // seconds from start to ingested
+    double compute; // seconds from ingested to computed
+    double write; // seconds from computed to written
+    double latency; // seconds from arrival to written
+};
+
+struct frame_metrics_buffer_struct {
+    struct frame_metrics_sample_struct *samples; // recorded by one thread only
+    size_t count;
+    size_t capacity;
+    char padding[FRAME_METRICS_LINE_BYTES - sizeof(void *) - 2 * sizeof(size_t)];
+};
+
+struct frame_metrics_struct {
+    int threads; // OpenMP threads, 1 without OpenMP
+    size_t frame_pixels; // pixels of a frame, for pixels/s
+    double start; // wall clock at frame_metrics_start
+    struct frame_metrics_buffer_struct *buffers; // samples of every thread
+    const char *json_path; // --metrics-json, or NULL
+    const char *csv_path; // --metrics-csv, or NULL
+    FILE *json;
+    FILE *csv;
+};
+
+/* reads --metrics-json and --metrics-csv and opens the files, exits with an error if one cannot be created */
+void frame_metrics_from_options(struct frame_metrics_struct *metrics, size_t frame_pixels);
+
+/* frees the samples and closes the files */
+void frame_metrics_free(struct frame_metrics_struct *metrics);
+
+/* CLOCK_MONOTONIC in seconds, the clock of frame_metrics_times_struct and frame_pacer_arrival */
+double frame_metrics_now(void);
+
+/* drops the samples recorded so far and starts the wall clock of frame_metrics_report */
+void frame_metrics_start(struct frame_metrics_struct *metrics);
+
+/* adds the sample of frame number frame to the buffer of the calling thread */
+void frame_metrics_record(struct frame_metrics_struct *metrics, long frame, const struct frame_metrics_times_struct *times);
+
+/* prints the summary since frame_metrics_start and writes the JSON and CSV files */
+void frame_metrics_report(struct frame_metrics_struct *metrics);
+
+#endif
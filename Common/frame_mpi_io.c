@@ -0,0 +1,161 @@
+/****************************************************************************************************************
+Parallel file I/O of the MPI tools, see frame_mpi_io.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mpi.h>
+
+#include "cli_options.h"
+#include "frame_mpi_io.h"
+
+void frame_mpi_io_from_options(struct frame_mpi_io_struct *io)
+{
+    const char *mode = cli_option("mpi-io");
+
+    if (mode != NULL && strcmp(mode, "on") != 0 && strcmp(mode, "off") != 0) {
+        printf("\nError: Unknown mpi-io %s. Please use --mpi-io=on or off.\n", mode);
+        exit(1);
+    }
+    io->enabled = mode != NULL && strcmp(mode, "on") == 0;
+
+    return;
+}
+
+void frame_mpi_io_print(const struct frame_mpi_io_struct *io)
+{
+    if (io->enabled) {
+        printf("\nMPI-IO = on, every rank reads and writes its own frames\n");
+    }
+    else {
+        printf("\nMPI-IO = off, rank 0 reads and writes the frames of all ranks\n");
+    }
+
+    return;
+}
+
+/********************************************************
+Opens the input read-only and the output write-only, and
+empties the output in case it is left from an earlier
+run. Prints an error and exits if a file cannot be
+opened.
+********************************************************/
+void frame_mpi_io_open(struct frame_mpi_io_struct *io, const char *input_filename, size_t input_header_bytes,
+                       size_t input_frame_bytes, const char *output_filename, size_t output_header_bytes,
+                       size_t output_frame_bytes)
+{
+    io->input_filename = input_filename;
+    io->output_filename = output_filename;
+    io->input_header_bytes = (MPI_Offset) input_header_bytes;
+    io->output_header_bytes = (MPI_Offset) output_header_bytes;
+    io->input_frame_bytes = input_frame_bytes;
+    io->output_frame_bytes = output_frame_bytes;
+
+    int size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &io->rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    io->times = (struct frame_metrics_times_struct *) malloc(sizeof(struct frame_metrics_times_struct) * size);
+    if (io->times == NULL) {
+        printf("Memory could not be allocated for the MPI-IO frame times\n");
+        exit(1);
+    }
+
+    if (MPI_File_open(MPI_COMM_WORLD, input_filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &io->input) != MPI_SUCCESS) {
+        printf("\nError: Could not open %s.\n", input_filename);
+        exit(1);
+    }
+    if (MPI_File_open(MPI_COMM_WORLD, output_filename, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL,
+                      &io->output) != MPI_SUCCESS
+        || MPI_File_set_size(io->output, 0) != MPI_SUCCESS) {
+        printf("\nError: Could not create %s.\n", output_filename);
+        exit(1);
+    }
+
+    return;
+}
+
+void frame_mpi_io_write_header(struct frame_mpi_io_struct *io, const void *header)
+{
+    MPI_Status status;
+
+    if (MPI_File_write_at(io->output, 0, header, (int) io->output_header_bytes, MPI_BYTE, &status) != MPI_SUCCESS) {
+        printf("\nError: Could not write %s.\n", io->output_filename);
+        exit(1);
+    }
+
+    return;
+}
+
+void frame_mpi_io_read(struct frame_mpi_io_struct *io, long frame, int count, void *buffer)
+{
+    MPI_Offset offset = io->input_header_bytes + (MPI_Offset) frame * (MPI_Offset) io->input_frame_bytes;
+    MPI_Status status;
+    int bytes;
+
+    if (MPI_File_read_at_all(io->input, offset, buffer, (int) io->input_frame_bytes * count, MPI_BYTE, &status) != MPI_SUCCESS
+        || MPI_Get_count(&status, MPI_BYTE, &bytes) != MPI_SUCCESS || (size_t) bytes != io->input_frame_bytes * (size_t) count) {
+        printf("\nError: Could not read frame %ld of %s.\n", frame, io->input_filename);
+        exit(1);
+    }
+
+    return;
+}
+
+void frame_mpi_io_write(struct frame_mpi_io_struct *io, long frame, int count, const void *buffer)
+{
+    MPI_Offset offset = io->output_header_bytes + (MPI_Offset) frame * (MPI_Offset) io->output_frame_bytes;
+    MPI_Status status;
+
+    if (MPI_File_write_at_all(io->output, offset, buffer, (int) io->output_frame_bytes * count, MPI_BYTE, &status) != MPI_SUCCESS) {
+        printf("\nError: Could not write frame %ld of %s.\n", frame, io->output_filename);
+        exit(1);
+    }
+
+    return;
+}
+
+/********************************************************
+The clocks of ranks on different nodes do not agree, but
+all ranks start a group together after a barrier, so the
+times of every rank are shifted by the difference of its
+start and the start of rank 0.
+********************************************************/
+void frame_mpi_io_record(struct frame_mpi_io_struct *io, struct frame_metrics_struct *metrics,
+                         const struct frame_pacer_struct *pacer, long first, int count,
+                         const struct frame_metrics_times_struct *times)
+{
+    const int doubles = (int) (sizeof(struct frame_metrics_times_struct) / sizeof(double));
+
+    MPI_Gather(times, doubles, MPI_DOUBLE, io->times, doubles, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (io->rank) {
+        return;
+    }
+
+    for (int r = 0; r < count; r++) {
+        struct frame_metrics_times_struct frame_times = io->times[r];
+        double shift = times->start - frame_times.start;
+        frame_times.start += shift;
+        frame_times.ingested += shift;
+        frame_times.computed += shift;
+        frame_times.written += shift;
+        frame_times.arrival = frame_pacer_arrival(pacer, first + r);
+        frame_metrics_record(metrics, first + r, &frame_times);
+    }
+
+    return;
+}
+
+void frame_mpi_io_close(struct frame_mpi_io_struct *io)
+{
+    free(io->times);
+    MPI_File_close(&io->input);
+    if (MPI_File_close(&io->output) != MPI_SUCCESS) {
+        printf("\nError: Could not write %s.\n", io->output_filename);
+        exit(1);
+    }
+
+    return;
+}
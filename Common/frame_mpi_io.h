@@ -0,0 +1,69 @@
+/****************************************************************************************************************
+Parallel file I/O of the MPI tools. With --mpi-io=on every rank opens the input and the output video with MPI-IO,
+reads its own frames with MPI_File_read_at_all and writes its results at their offsets with MPI_File_write_at_all,
+so the frames no longer pass through rank 0 (MPI_Scatter / MPI_Gather) and the bandwidth of every node's disk and
+network is used. The collective calls let the MPI library merge the accesses of the ranks into large contiguous
+ones. Rank 0 still counts the frames and handles the stream header, which is metadata only.
+
+Every rank times its own frame and frame_mpi_io_record gathers the times on rank 0 for the frame metrics.
+
+With --mpi-io=off (default) rank 0 reads and writes the whole video through the frame pipeline (frame_pipeline.h).
+Every call except frame_mpi_io_write_header is collective over MPI_COMM_WORLD.
+****************************************************************************************************************/
+
+#ifndef FRAME_MPI_IO_H
+#define FRAME_MPI_IO_H
+
+#include <stddef.h>
+#include <mpi.h>
+
+#include "frame_metrics.h"
+#include "frame_pacer.h"
+
+struct frame_mpi_io_struct {
+    int enabled; // --mpi-io=on
+    const char *input_filename;
+    const char *output_filename;
+    MPI_File input;
+    MPI_File output;
+    MPI_Offset input_header_bytes; // bytes before the first input frame
+    MPI_Offset output_header_bytes; // bytes before the first output frame
+    size_t input_frame_bytes;
+    size_t output_frame_bytes;
+    int rank;
+    struct frame_metrics_times_struct *times; // rank 0: the stage times of the frame of every rank
+};
+
+/* reads --mpi-io, exits with an error on an invalid value */
+void frame_mpi_io_from_options(struct frame_mpi_io_struct *io);
+
+/* prints the mode in the style of the tools' other settings */
+void frame_mpi_io_print(const struct frame_mpi_io_struct *io);
+
+/* opens input_filename for reading and creates output_filename empty, both as a header followed by frames, exits
+   with an error if a file cannot be opened */
+void frame_mpi_io_open(struct frame_mpi_io_struct *io, const char *input_filename, size_t input_header_bytes,
+                       size_t input_frame_bytes, const char *output_filename, size_t output_header_bytes,
+                       size_t output_frame_bytes);
+
+/* writes the output header of output_header_bytes, called by one rank only */
+void frame_mpi_io_write_header(struct frame_mpi_io_struct *io, const void *header);
+
+/* reads count input frames from frame number frame of the calling rank into buffer; a rank without a frame in the
+   last group of a video passes 0 and still joins the collective read */
+void frame_mpi_io_read(struct frame_mpi_io_struct *io, long frame, int count, void *buffer);
+
+/* writes count frames of buffer as output frames from frame number frame of the calling rank, count may be 0 */
+void frame_mpi_io_write(struct frame_mpi_io_struct *io, long frame, int count, const void *buffer);
+
+/* gathers the times of the frame of every rank on rank 0, which records the first count of them as frames first,
+   first + 1, ... in metrics with their arrival from pacer; every rank must have started its frame right after a
+   barrier, the times of the other ranks are moved onto the clock of rank 0 by their start */
+void frame_mpi_io_record(struct frame_mpi_io_struct *io, struct frame_metrics_struct *metrics,
+                         const struct frame_pacer_struct *pacer, long first, int count,
+                         const struct frame_metrics_times_struct *times);
+
+/* closes both files */
+void frame_mpi_io_close(struct frame_mpi_io_struct *io);
+
+#endif
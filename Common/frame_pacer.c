@@ -0,0 +1,151 @@
+/****************************************************************************************************************
+Frame pacing of the video processing tools, see frame_pacer.h.
+****************************************************************************************************************/
+
+/* clock_nanosleep and CLOCK_MONOTONIC */
+#define _POSIX_C_SOURCE 200112L
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "cli_options.h"
+#include "frame_pacer.h"
+
+#define FRAME_PACER_NANOSECONDS 1000000000L
+
+/* CLOCK_MONOTONIC in seconds */
+static double frame_pacer_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec / FRAME_PACER_NANOSECONDS;
+}
+
+/********************************************************
+Reads --pacing=realtime|fast|Nx, N a positive speed-up
+such as 4x or 0.5x. Missing option keeps real time.
+Prints an error and exits on a malformed value.
+********************************************************/
+void frame_pacer_from_options(struct frame_pacer_struct *pacer, double period)
+{
+    const char *pacing = cli_option("pacing");
+    char unit, extra;
+
+    pacer->mode = FRAME_PACING_REALTIME;
+    pacer->speed = 1.0;
+    pacer->period = period;
+    if (pacing != NULL && strcmp(pacing, "fast") == 0) {
+        pacer->mode = FRAME_PACING_FAST;
+    }
+    else if (pacing != NULL && strcmp(pacing, "realtime") != 0) {
+        if (sscanf(pacing, "%lf%c%c", &pacer->speed, &unit, &extra) != 2 || unit != 'x' || !(pacer->speed > 0.0)) {
+            printf("\nError: Invalid pacing %s. Please use --pacing=realtime, fast or Nx (e.g. 4x).\n", pacing);
+            exit(1);
+        }
+        pacer->mode = FRAME_PACING_REPLAY;
+    }
+
+    pacer->deadlines = 0;
+    pacer->misses = 0;
+    pacer->lateness = 0.0;
+    pacer->worst = 0.0;
+
+    return;
+}
+
+void frame_pacer_print(const struct frame_pacer_struct *pacer)
+{
+    if (pacer->mode == FRAME_PACING_FAST) {
+        printf("\nPacing = as fast as possible\n");
+    }
+    else if (pacer->mode == FRAME_PACING_REPLAY) {
+        printf("\nPacing = replay at %gx, a frame every %f sec\n", pacer->speed, pacer->period / pacer->speed);
+    }
+    else {
+        printf("\nPacing = real time, a frame every %f sec\n", pacer->period);
+    }
+
+    return;
+}
+
+void frame_pacer_start(struct frame_pacer_struct *pacer)
+{
+    pacer->start = frame_pacer_now();
+    pacer->ready = pacer->start;
+    pacer->deadlines = 0;
+    pacer->misses = 0;
+    pacer->lateness = 0.0;
+    pacer->worst = 0.0;
+
+    return;
+}
+
+/********************************************************
+Sleeps until the absolute arrival time of frame, which
+only depends on the frame number, so time spent on one
+frame never shifts the arrival of the next. If frame has
+arrived already the tool is behind the sensor: counts a
+miss and how late it is instead of sleeping.
+********************************************************/
+void frame_pacer_wait(struct frame_pacer_struct *pacer, long frame)
+{
+    pacer->deadlines++;
+    if (pacer->mode == FRAME_PACING_FAST) {
+        pacer->ready = frame_pacer_now();
+        return;
+    }
+
+    double arrival = frame_pacer_arrival(pacer, frame);
+    double late = frame_pacer_now() - arrival;
+    if (late > 0.0) {
+        pacer->misses++;
+        pacer->lateness += late;
+        if (late > pacer->worst) {
+            pacer->worst = late;
+        }
+        return;
+    }
+
+    struct timespec deadline;
+    deadline.tv_sec = (time_t) arrival;
+    deadline.tv_nsec = (long) ((arrival - (double) deadline.tv_sec) * FRAME_PACER_NANOSECONDS);
+    if (deadline.tv_nsec >= FRAME_PACER_NANOSECONDS) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= FRAME_PACER_NANOSECONDS;
+    }
+
+    /* signals only interrupt the sleep, the deadline stays the same */
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+
+    return;
+}
+
+double frame_pacer_arrival(const struct frame_pacer_struct *pacer, long frame)
+{
+    if (pacer->mode == FRAME_PACING_FAST) {
+        return pacer->ready;
+    }
+
+    return pacer->start + (double) (frame + 1) * pacer->period / pacer->speed;
+}
+
+void frame_pacer_report(const struct frame_pacer_struct *pacer)
+{
+    if (pacer->mode == FRAME_PACING_FAST) {
+        return;
+    }
+
+    printf("\nDeadline Misses:   %ld of %ld deadlines\n", pacer->misses, pacer->deadlines);
+    if (pacer->misses > 0) {
+        printf("\nLateness:   %0.6lf seconds total, %0.6lf seconds worst, %0.6lf seconds average\n", pacer->lateness,
+               pacer->worst, pacer->lateness / pacer->misses);
+    }
+
+    return;
+}
@@ -0,0 +1,51 @@
+/****************************************************************************************************************
+Frame pacing of the video processing tools. The tools simulate a sensor that delivers a frame every period seconds
+(the framerate argument): frame k arrives period * (k + 1) seconds after frame_pacer_start, and frame_pacer_wait
+sleeps until it has arrived with clock_nanosleep on absolute CLOCK_MONOTONIC deadlines, so waiting costs no cpu
+and the schedule does not drift. --pacing=realtime (default) keeps the sensor rate, --pacing=Nx replays N times
+faster (e.g. --pacing=4x) and --pacing=fast does not wait at all. A frame that has already arrived when the tool
+asks for it is a deadline miss: the tool was still busy with earlier frames. Misses and how late the tool was are
+reported at the end. frame_pacer_arrival gives the arrival time of a frame, where its end-to-end latency
+starts (frame_metrics.h).
+****************************************************************************************************************/
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+enum frame_pacing {
+    FRAME_PACING_REALTIME, // frames arrive at the sensor rate
+    FRAME_PACING_REPLAY, // frames arrive speed times faster than the sensor rate
+    FRAME_PACING_FAST // frames are always there, no waiting and no deadlines
+};
+
+struct frame_pacer_struct {
+    enum frame_pacing mode;
+    double speed; // replay speed-up, 1 in real time
+    double period; // seconds between two frames at the sensor rate
+    double start; // CLOCK_MONOTONIC seconds at frame_pacer_start
+    double ready; // CLOCK_MONOTONIC seconds when frame_pacer_wait last returned in fast mode
+    long deadlines; // calls of frame_pacer_wait
+    long misses; // frames that had arrived before the tool was ready for them
+    double lateness; // sum over the missed frames of how late the tool was, in seconds
+    double worst; // largest lateness of a single frame, in seconds
+};
+
+/* reads --pacing for a sensor delivering a frame every period seconds, exits with an error on an invalid value */
+void frame_pacer_from_options(struct frame_pacer_struct *pacer, double period);
+
+/* prints the pacing in the style of the tools' other settings */
+void frame_pacer_print(const struct frame_pacer_struct *pacer);
+
+/* starts the sensor clock, frame 0 arrives one period later */
+void frame_pacer_start(struct frame_pacer_struct *pacer);
+
+/* returns once frame number frame has arrived, counting a deadline miss if it had arrived already */
+void frame_pacer_wait(struct frame_pacer_struct *pacer, long frame);
+
+/* CLOCK_MONOTONIC seconds at which frame number frame arrived, in fast mode when frame_pacer_wait last returned */
+double frame_pacer_arrival(const struct frame_pacer_struct *pacer, long frame);
+
+/* prints the deadline misses since frame_pacer_start */
+void frame_pacer_report(const struct frame_pacer_struct *pacer);
+
+#endif
@@ -0,0 +1,375 @@
+/****************************************************************************************************************
+Reader/compute/writer pipeline of the video processing tools, see frame_pipeline.h.
+****************************************************************************************************************/
+
+/* sched_yield, nanosleep, sched_getaffinity, sched_setaffinity and the CPU_SET macros */
+#define _GNU_SOURCE
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "cli_options.h"
+#include "frame_pipeline.h"
+
+#define FRAME_PIPELINE_YIELDS 100 // a side that waits yields this many times before it naps
+#define FRAME_PIPELINE_NAP_NS 50000 // nap of a waiting side
+
+static cpu_set_t frame_pipeline_affinity; // cpus of the process before any thread was pinned, see frame_pipeline_unpin
+
+void frame_pipeline_from_options(struct frame_pipeline_struct *pipeline)
+{
+    const char *mode = cli_option("pipeline");
+    const char *depth = cli_option("pipeline-depth");
+    char extra;
+
+    if (mode != NULL && strcmp(mode, "on") != 0 && strcmp(mode, "off") != 0) {
+        printf("\nError: Unknown pipeline %s. Please use --pipeline=on or off.\n", mode);
+        exit(1);
+    }
+    pipeline->threaded = mode != NULL && strcmp(mode, "on") == 0;
+    pipeline->depth = FRAME_PIPELINE_DEPTH;
+    if (depth != NULL && (sscanf(depth, "%ld%c", &pipeline->depth, &extra) != 1 || pipeline->depth < 2)) {
+        printf("\nError: Invalid pipeline depth %s. Please use --pipeline-depth=N with N at least 2.\n", depth);
+        exit(1);
+    }
+
+    /* the cpus taskset, numactl or the batch system gave the process; all cpus if they cannot be read */
+    if (sched_getaffinity(0, sizeof(frame_pipeline_affinity), &frame_pipeline_affinity) != 0) {
+        CPU_ZERO(&frame_pipeline_affinity);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &frame_pipeline_affinity);
+        }
+    }
+
+    return;
+}
+
+void frame_pipeline_print(const struct frame_pipeline_struct *pipeline)
+{
+    if (pipeline->threaded) {
+        printf("\nPipeline = on, reader and writer threads, %ld slots per ring\n", pipeline->depth);
+    }
+    else {
+        printf("\nPipeline = off\n");
+    }
+
+    return;
+}
+
+/* slots of slot_frames frames of frame_bytes, the data is left to the caller for frame_bytes 0 */
+static void frame_pipeline_ring_init(struct frame_pipeline_ring_struct *ring, long capacity, int slot_frames, size_t frame_bytes)
+{
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->slots = (struct frame_pipeline_slot_struct *) calloc(capacity, sizeof(struct frame_pipeline_slot_struct));
+    if (ring->slots == NULL) {
+        printf("Memory could not be allocated for the pipeline slots\n");
+        exit(1);
+    }
+    for (long s = 0; s < capacity; s++) {
+        ring->slots[s].times = (struct frame_metrics_times_struct *) malloc(sizeof(struct frame_metrics_times_struct) * slot_frames);
+        ring->slots[s].data = (frame_bytes > 0) ? malloc(frame_bytes * slot_frames) : NULL;
+        if (ring->slots[s].times == NULL || (frame_bytes > 0 && ring->slots[s].data == NULL)) {
+            printf("Memory could not be allocated for the pipeline slots\n");
+            exit(1);
+        }
+    }
+
+    return;
+}
+
+static void frame_pipeline_ring_free(struct frame_pipeline_ring_struct *ring, int owns_data)
+{
+    for (long s = 0; s < ring->capacity; s++) {
+        free(ring->slots[s].times);
+        if (owns_data) {
+            free(ring->slots[s].data);
+        }
+    }
+    free(ring->slots);
+
+    return;
+}
+
+/* waiting for the other side of a ring: yields first, naps once that did not help */
+static void frame_pipeline_backoff(int *waits)
+{
+    if (++*waits < FRAME_PIPELINE_YIELDS) {
+        sched_yield();
+    }
+    else {
+        struct timespec nap = {0, FRAME_PIPELINE_NAP_NS};
+        nanosleep(&nap, NULL);
+    }
+
+    return;
+}
+
+/********************************************************
+The four operations of a ring. The producer fills the
+slot at head once the consumer released it and publishes
+it by a release store of head + 1; the consumer sees it
+by an acquire load of head and gives it back by a release
+store of tail + 1. Each index has one writer, so no
+read-modify-write is needed.
+********************************************************/
+static struct frame_pipeline_slot_struct *frame_pipeline_ring_acquire(struct frame_pipeline_ring_struct *ring)
+{
+    int waits = 0;
+
+    while (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= ring->capacity) {
+        frame_pipeline_backoff(&waits);
+    }
+
+    return &ring->slots[ring->head % ring->capacity];
+}
+
+static void frame_pipeline_ring_publish(struct frame_pipeline_ring_struct *ring)
+{
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+
+    return;
+}
+
+static struct frame_pipeline_slot_struct *frame_pipeline_ring_peek(struct frame_pipeline_ring_struct *ring)
+{
+    int waits = 0;
+
+    while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail) {
+        frame_pipeline_backoff(&waits);
+    }
+
+    return &ring->slots[ring->tail % ring->capacity];
+}
+
+static void frame_pipeline_ring_release(struct frame_pipeline_ring_struct *ring)
+{
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+
+    return;
+}
+
+void frame_pipeline_init(struct frame_pipeline_struct *pipeline, struct frame_source_struct *source,
+                         struct frame_pacer_struct *pacer, struct frame_metrics_struct *metrics,
+                         struct frame_writer_struct *output, long frames, int slot_frames, size_t output_bytes)
+{
+    pipeline->source = source;
+    pipeline->pacer = pacer;
+    pipeline->metrics = metrics;
+    pipeline->output = output;
+    pipeline->frames = frames;
+    pipeline->slot_frames = slot_frames;
+    pipeline->output_bytes = output_bytes;
+    pipeline->input = NULL;
+    pipeline->result = NULL;
+    pipeline->next = 0;
+    pipeline->ended = 0;
+
+    /* off: one input slot pointing into the source and one output slot */
+    long capacity = pipeline->threaded ? pipeline->depth : 1;
+    frame_pipeline_ring_init(&pipeline->reads, capacity, slot_frames, pipeline->threaded ? source->frame_bytes : 0);
+    frame_pipeline_ring_init(&pipeline->writes, capacity, slot_frames, output_bytes);
+
+    return;
+}
+
+/* reads count frames from first into slot, a copy with threads, a pointer into the source without */
+static void frame_pipeline_read(struct frame_pipeline_struct *pipeline, struct frame_pipeline_slot_struct *slot, long first, int count)
+{
+    double start = frame_metrics_now();
+    if (pipeline->threaded) {
+        frame_source_copy(pipeline->source, first, count, slot->data);
+    }
+    else {
+        slot->data = (void *) frame_source_frames(pipeline->source, first, count);
+    }
+    double ingested = frame_metrics_now();
+
+    slot->first = first;
+    slot->count = count;
+    for (int i = 0; i < count; i++) {
+        slot->times[i].arrival = (pipeline->pacer != NULL) ? frame_pacer_arrival(pipeline->pacer, first + i) : start;
+        slot->times[i].start = start;
+        slot->times[i].ingested = ingested;
+    }
+
+    return;
+}
+
+static void frame_pipeline_write(struct frame_pipeline_struct *pipeline, struct frame_pipeline_slot_struct *slot)
+{
+    frame_writer_write(pipeline->output, slot->data, pipeline->output_bytes * slot->count);
+    double written = frame_metrics_now();
+
+    for (int i = 0; i < slot->count; i++) {
+        slot->times[i].written = written;
+        frame_metrics_record(pipeline->metrics, slot->first + i, &slot->times[i]);
+    }
+
+    return;
+}
+
+/* the reader and writer threads run on any cpu the process was given, not on the cpu the calling thread is pinned to */
+static void frame_pipeline_unpin(void)
+{
+    sched_setaffinity(0, sizeof(frame_pipeline_affinity), &frame_pipeline_affinity);
+
+    return;
+}
+
+/********************************************************
+Reader thread: waits until the sensor has delivered the
+frames of a slot, copies them into the next free slot of
+the reads ring, and ends the video with an empty slot.
+********************************************************/
+static void *frame_pipeline_reader(void *argument)
+{
+    struct frame_pipeline_struct *pipeline = (struct frame_pipeline_struct *) argument;
+
+    frame_pipeline_unpin();
+    for (long first = 0; first < pipeline->frames; first += pipeline->slot_frames) {
+        int count = (pipeline->frames - first < pipeline->slot_frames) ? (int) (pipeline->frames - first) : pipeline->slot_frames;
+        if (pipeline->pacer != NULL) {
+            frame_pacer_wait(pipeline->pacer, first + count - 1);
+        }
+        struct frame_pipeline_slot_struct *slot = frame_pipeline_ring_acquire(&pipeline->reads);
+        frame_pipeline_read(pipeline, slot, first, count);
+        frame_pipeline_ring_publish(&pipeline->reads);
+    }
+    frame_pipeline_ring_acquire(&pipeline->reads)->count = 0;
+    frame_pipeline_ring_publish(&pipeline->reads);
+
+    return NULL;
+}
+
+/* writer thread: writes the slots of the writes ring in order until the empty slot that ends the video */
+static void *frame_pipeline_writer(void *argument)
+{
+    struct frame_pipeline_struct *pipeline = (struct frame_pipeline_struct *) argument;
+
+    frame_pipeline_unpin();
+    for (;;) {
+        struct frame_pipeline_slot_struct *slot = frame_pipeline_ring_peek(&pipeline->writes);
+        if (slot->count == 0) {
+            frame_pipeline_ring_release(&pipeline->writes);
+            break;
+        }
+        frame_pipeline_write(pipeline, slot);
+        frame_pipeline_ring_release(&pipeline->writes);
+    }
+
+    return NULL;
+}
+
+void frame_pipeline_run(struct frame_pipeline_struct *pipeline)
+{
+    if (!pipeline->threaded) {
+        return;
+    }
+
+    if (pthread_create(&pipeline->reader, NULL, frame_pipeline_reader, pipeline) != 0
+        || pthread_create(&pipeline->writer, NULL, frame_pipeline_writer, pipeline) != 0) {
+        printf("\nError: Could not start the pipeline threads.\n");
+        exit(1);
+    }
+
+    return;
+}
+
+/********************************************************
+Returns the next slot of frames. With threads it is the
+next slot the reader published; without, this waits for
+the sensor and reads the frames itself. At the end of the
+video the writer is handed the empty slot that stops it.
+********************************************************/
+const struct frame_pipeline_slot_struct *frame_pipeline_input(struct frame_pipeline_struct *pipeline)
+{
+    if (pipeline->ended) {
+        return NULL;
+    }
+
+    if (pipeline->threaded) {
+        pipeline->input = frame_pipeline_ring_peek(&pipeline->reads);
+        if (pipeline->input->count == 0) {
+            frame_pipeline_ring_release(&pipeline->reads);
+            frame_pipeline_ring_acquire(&pipeline->writes)->count = 0;
+            frame_pipeline_ring_publish(&pipeline->writes);
+            pipeline->input = NULL;
+            pipeline->ended = 1;
+        }
+        return pipeline->input;
+    }
+
+    if (pipeline->next >= pipeline->frames) {
+        pipeline->input = NULL;
+        pipeline->ended = 1;
+        return NULL;
+    }
+    long first = pipeline->next;
+    int count = (pipeline->frames - first < pipeline->slot_frames) ? (int) (pipeline->frames - first) : pipeline->slot_frames;
+    if (pipeline->pacer != NULL) {
+        frame_pacer_wait(pipeline->pacer, first + count - 1);
+    }
+    pipeline->input = &pipeline->reads.slots[0];
+    frame_pipeline_read(pipeline, pipeline->input, first, count);
+    pipeline->next += count;
+
+    return pipeline->input;
+}
+
+struct frame_pipeline_slot_struct *frame_pipeline_output(struct frame_pipeline_struct *pipeline)
+{
+    pipeline->result = pipeline->threaded ? frame_pipeline_ring_acquire(&pipeline->writes) : &pipeline->writes.slots[0];
+    pipeline->result->first = pipeline->input->first;
+    pipeline->result->count = pipeline->input->count;
+    memcpy(pipeline->result->times, pipeline->input->times, sizeof(struct frame_metrics_times_struct) * pipeline->input->count);
+
+    return pipeline->result;
+}
+
+void frame_pipeline_computed(struct frame_pipeline_struct *pipeline)
+{
+    double computed = frame_metrics_now();
+
+    for (int i = 0; i < pipeline->result->count; i++) {
+        pipeline->result->times[i].computed = computed;
+    }
+    if (pipeline->threaded) {
+        frame_pipeline_ring_publish(&pipeline->writes);
+        frame_pipeline_ring_release(&pipeline->reads);
+    }
+    else {
+        frame_pipeline_write(pipeline, pipeline->result);
+    }
+
+    return;
+}
+
+/********************************************************
+Takes the end of the video if the tool stopped at its
+last frame without asking for more (MPI ranks count the
+frames themselves), joins the threads and frees the
+slots.
+********************************************************/
+void frame_pipeline_free(struct frame_pipeline_struct *pipeline)
+{
+    if (frame_pipeline_input(pipeline) != NULL) {
+        printf("\nError: The pipeline has frames left that were not computed.\n");
+        exit(1);
+    }
+
+    if (pipeline->threaded) {
+        pthread_join(pipeline->reader, NULL);
+        pthread_join(pipeline->writer, NULL);
+    }
+    frame_pipeline_ring_free(&pipeline->reads, pipeline->threaded);
+    frame_pipeline_ring_free(&pipeline->writes, 1);
+
+    return;
+}
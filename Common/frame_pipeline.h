@@ -0,0 +1,105 @@
+/****************************************************************************************************************
+Reader/compute/writer pipeline of the video processing tools. With --pipeline=on a reader thread waits for the
+sensor (frame_pacer_wait) and copies the frames of the input into the slots of one ring, the calling thread computes
+from those slots into the slots of a second ring, and a writer thread writes the results to the output file. Disk
+and cpu work at the same time, so a frame takes the time of the slowest stage instead of the sum of all three.
+Each ring has --pipeline-depth=N preallocated slots (default FRAME_PIPELINE_DEPTH) of up to slot_frames frames and
+is lock-free: one thread produces into it and one consumes from it, the slot indices are published with release
+stores and read with acquire loads, and a side that finds the ring full or empty yields and then naps.
+
+With --pipeline=off (default) the same calls run every stage on the calling thread, the input slot points straight
+into the frame source and there is one output slot, so a tool has a single loop for both modes:
+
+    while ((input = frame_pipeline_input(&pipeline)) != NULL) {
+        output = frame_pipeline_output(&pipeline);
+        ... compute input->count frames from input->data into output->data ...
+        frame_pipeline_computed(&pipeline);
+    }
+
+The pipeline records the stage times of every frame in the frame metrics; a frame counts as written once the
+frame writer (frame_writer.h) took it. Only the calling thread makes MPI calls.
+****************************************************************************************************************/
+
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "frame_metrics.h"
+#include "frame_pacer.h"
+#include "frame_source.h"
+#include "frame_writer.h"
+
+#define FRAME_PIPELINE_DEPTH 4 // default --pipeline-depth
+#define FRAME_PIPELINE_LINE_BYTES 64 // the indices of the two sides of a ring sit on cache lines of their own
+
+/* up to slot_frames consecutive frames of a ring and their stage times */
+struct frame_pipeline_slot_struct {
+    long first; // number of the first frame
+    int count; // frames in the slot, 0 marks the end of the video
+    void *data; // the frames, one after the other
+    struct frame_metrics_times_struct *times; // stage times of every frame
+};
+
+/* single-producer single-consumer ring of slots */
+struct frame_pipeline_ring_struct {
+    struct frame_pipeline_slot_struct *slots;
+    long capacity;
+    char padding_slots[FRAME_PIPELINE_LINE_BYTES - sizeof(void *) - sizeof(long)];
+    long head; // slots published by the producer, written by the producer only
+    char padding_head[FRAME_PIPELINE_LINE_BYTES - sizeof(long)];
+    long tail; // slots released by the consumer, written by the consumer only
+    char padding_tail[FRAME_PIPELINE_LINE_BYTES - sizeof(long)];
+};
+
+struct frame_pipeline_struct {
+    int threaded; // --pipeline=on: reader and writer threads, off: every stage on the calling thread
+    long depth; // --pipeline-depth, slots of each ring
+    struct frame_source_struct *source;
+    struct frame_pacer_struct *pacer; // NULL if frames arrive when they are read
+    struct frame_metrics_struct *metrics;
+    struct frame_writer_struct *output;
+    long frames; // frames to process
+    int slot_frames;
+    size_t output_bytes; // bytes of a result frame
+    struct frame_pipeline_ring_struct reads; // reader -> compute
+    struct frame_pipeline_ring_struct writes; // compute -> writer
+    struct frame_pipeline_slot_struct *input; // slot being computed
+    struct frame_pipeline_slot_struct *result; // slot its results go to
+    long next; // off: first frame of the next input slot
+    int ended; // frame_pipeline_input returned NULL
+    pthread_t reader;
+    pthread_t writer;
+};
+
+/* reads --pipeline and --pipeline-depth and saves the affinity of the calling thread, exits with an error on an
+   invalid value; call it before thread_placement_from_options pins the calling thread */
+void frame_pipeline_from_options(struct frame_pipeline_struct *pipeline);
+
+/* prints the pipeline in the style of the tools' other settings */
+void frame_pipeline_print(const struct frame_pipeline_struct *pipeline);
+
+/* allocates the slots for frames of the source in slots of slot_frames and results of output_bytes per frame,
+   written to output after whatever the tool wrote there before; the slots of the writes ring are already there
+   for first touch, the threads start with frame_pipeline_run */
+void frame_pipeline_init(struct frame_pipeline_struct *pipeline, struct frame_source_struct *source,
+                         struct frame_pacer_struct *pacer, struct frame_metrics_struct *metrics,
+                         struct frame_writer_struct *output, long frames, int slot_frames, size_t output_bytes);
+
+/* starts the reader and writer threads, after frame_pacer_start and frame_metrics_start */
+void frame_pipeline_run(struct frame_pipeline_struct *pipeline);
+
+/* the next slot of frames to compute, NULL at the end of the video */
+const struct frame_pipeline_slot_struct *frame_pipeline_input(struct frame_pipeline_struct *pipeline);
+
+/* the slot to compute the results of the input slot into */
+struct frame_pipeline_slot_struct *frame_pipeline_output(struct frame_pipeline_struct *pipeline);
+
+/* hands the results to the writer and the input slot back to the reader */
+void frame_pipeline_computed(struct frame_pipeline_struct *pipeline);
+
+/* waits for the threads, after the last frame was computed, and frees the slots */
+void frame_pipeline_free(struct frame_pipeline_struct *pipeline);
+
+#endif
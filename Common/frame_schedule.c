@@ -0,0 +1,175 @@
+/****************************************************************************************************************
+Two-level OpenMP schedule of the frame loops, see frame_schedule.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cli_options.h"
+#include "frame_schedule.h"
+
+static size_t frame_schedule_round_up(size_t value, size_t unit)
+{
+    return (value + unit - 1) / unit * unit;
+}
+
+/********************************************************
+Reads --omp-frames=N (frames in flight, default the
+number of threads), --omp-chunk=pixels (default auto)
+and --omp-schedule=static|dynamic|guided (default
+static), and sets the runtime schedule of the batch
+loops. Prints an error and exits on an invalid value.
+********************************************************/
+void frame_schedule_from_options(struct frame_schedule_struct *schedule, size_t pixels, size_t unit)
+{
+    const char *frames = cli_option("omp-frames");
+    const char *chunk = cli_option("omp-chunk");
+    const char *kind = cli_option("omp-schedule");
+    char extra;
+
+    #ifdef _OPENMP
+    schedule->threads = omp_get_max_threads();
+    #else
+    schedule->threads = 1;
+    #endif
+    schedule->frames = schedule->threads;
+    schedule->pixels = pixels;
+    schedule->unit = unit;
+    schedule->chunk = 0;
+    schedule->kind = (kind != NULL) ? kind : "static";
+
+    if (frames != NULL && (sscanf(frames, "%d%c", &schedule->frames, &extra) != 1 || schedule->frames < 1)) {
+        printf("\nError: Invalid frames in flight %s. Please use --omp-frames=N with N >= 1.\n", frames);
+        exit(1);
+    }
+    if (chunk != NULL && (sscanf(chunk, "%zu%c", &schedule->chunk, &extra) != 1 || schedule->chunk < 1)) {
+        printf("\nError: Invalid chunk %s. Please use --omp-chunk=pixels with at least 1 pixel.\n", chunk);
+        exit(1);
+    }
+    if (strcmp(schedule->kind, "static") != 0 && strcmp(schedule->kind, "dynamic") != 0
+        && strcmp(schedule->kind, "guided") != 0) {
+        printf("\nError: Unknown schedule %s. Please use --omp-schedule=static, dynamic or guided.\n", schedule->kind);
+        exit(1);
+    }
+
+    /* parts must start where a frame can be split */
+    if (schedule->chunk > 0) {
+        schedule->chunk = frame_schedule_round_up(schedule->chunk, unit);
+    }
+
+    #ifdef _OPENMP
+    if (strcmp(schedule->kind, "dynamic") == 0) {
+        omp_set_schedule(omp_sched_dynamic, 1);
+    }
+    else if (strcmp(schedule->kind, "guided") == 0) {
+        omp_set_schedule(omp_sched_guided, 1);
+    }
+    else {
+        omp_set_schedule(omp_sched_static, 0);
+    }
+    #endif
+
+    return;
+}
+
+/********************************************************
+Splits frames only as far as the threads need: a batch
+with at least as many frames as threads keeps whole
+frames, a smaller one gives every thread about one part,
+rounded up to the split unit and to whole cache lines.
+--omp-chunk overrides the part size.
+********************************************************/
+void frame_schedule_batch(const struct frame_schedule_struct *schedule, long remaining, struct frame_schedule_batch_struct *batch)
+{
+    size_t pixels = schedule->pixels;
+
+    batch->frames = (remaining < schedule->frames) ? (int) remaining : schedule->frames;
+    batch->part_pixels = frame_schedule_round_up(pixels, schedule->unit);
+
+    if (schedule->chunk > 0) {
+        batch->part_pixels = schedule->chunk;
+    }
+    else if (batch->frames > 0 && batch->frames < schedule->threads) {
+        size_t wanted = (size_t) ((schedule->threads + batch->frames - 1) / batch->frames);
+
+        /* the smallest multiple of unit that covers a cache line */
+        size_t line = frame_schedule_round_up(FRAME_SCHEDULE_LINE_PIXELS, schedule->unit);
+        batch->part_pixels = frame_schedule_round_up((pixels + wanted - 1) / wanted, line);
+    }
+
+    batch->parts = (pixels + batch->part_pixels - 1) / batch->part_pixels;
+    if (batch->parts == 0) {
+        batch->parts = 1;
+    }
+
+    return;
+}
+
+/********************************************************
+First touch: zeroes every part of frames frames of
+buffer, frame_bytes apart, from the thread that will
+process the part in a frame loop over the same schedule,
+so its pages land on the memory node of that thread.
+Parts map to bytes in proportion to their pixels. Exact
+for the static schedule, which hands the same items to
+the same threads in every batch.
+********************************************************/
+void frame_schedule_first_touch(const struct frame_schedule_struct *schedule, int frames, void *buffer, size_t frame_bytes)
+{
+    for (int f = 0; f < frames; f += schedule->frames) {
+        struct frame_schedule_batch_struct batch;
+        frame_schedule_batch(schedule, frames - f, &batch);
+
+        long items = (long) frame_schedule_items(&batch);
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(runtime)
+        #endif
+        for (long item = 0; item < items; item++) {
+            int i;
+            size_t first, count;
+            frame_schedule_item(schedule, &batch, (size_t) item, &i, &first, &count);
+
+            size_t start = first * frame_bytes / schedule->pixels;
+            size_t end = (first + count) * frame_bytes / schedule->pixels;
+            memset((char *) buffer + (size_t) (f + i) * frame_bytes + start, 0, end - start);
+        }
+    }
+
+    return;
+}
+
+size_t frame_schedule_items(const struct frame_schedule_batch_struct *batch)
+{
+    return (size_t) batch->frames * batch->parts;
+}
+
+void frame_schedule_item(const struct frame_schedule_struct *schedule, const struct frame_schedule_batch_struct *batch,
+                         size_t item, int *frame, size_t *first, size_t *count)
+{
+    /* the parts of a frame are consecutive items, so static schedules hand a thread neighbouring parts */
+    *frame = (int) (item / batch->parts);
+    *first = (item % batch->parts) * batch->part_pixels;
+    *count = (schedule->pixels - *first < batch->part_pixels) ? schedule->pixels - *first : batch->part_pixels;
+
+    return;
+}
+
+void frame_schedule_print(const struct frame_schedule_struct *schedule)
+{
+    printf("\nNumber of threads: %d\n", schedule->threads);
+    if (schedule->chunk > 0) {
+        printf("\nFrames in flight = %d, chunk = %zu pixels, schedule = %s\n", schedule->frames, schedule->chunk,
+               schedule->kind);
+    }
+    else {
+        printf("\nFrames in flight = %d, chunk = auto, schedule = %s\n", schedule->frames, schedule->kind);
+    }
+
+    return;
+}
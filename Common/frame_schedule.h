@@ -0,0 +1,51 @@
+/****************************************************************************************************************
+Two-level OpenMP schedule of the frame loops. Frames are processed in batches of --omp-frames frames in flight
+(default: one per thread), and when a batch has fewer frames than threads every frame is split into parts so all
+threads share it, which cuts the latency of a single frame by up to the thread count. A batch is one flat loop of
+frames x parts work items run with schedule(runtime), so --omp-schedule=static|dynamic|guided picks the OpenMP
+schedule and --omp-chunk=pixels sets the part size by hand.
+****************************************************************************************************************/
+
+#ifndef FRAME_SCHEDULE_H
+#define FRAME_SCHEDULE_H
+
+#include <stddef.h>
+
+#define FRAME_SCHEDULE_LINE_PIXELS 32 // 2-byte pixels per 64-byte cache line, automatic parts never share a line
+
+struct frame_schedule_struct {
+    int threads; // OpenMP threads of the tool, 1 without OpenMP
+    int frames; // frames in flight per batch (--omp-frames)
+    size_t pixels; // pixels per frame
+    size_t unit; // parts of a frame start at multiples of unit pixels
+    size_t chunk; // pixels per part (--omp-chunk), 0 to split frames only when a batch has fewer frames than threads
+    const char *kind; // OpenMP schedule of the work items (--omp-schedule)
+};
+
+struct frame_schedule_batch_struct {
+    int frames; // frames in this batch, fewer than frames in flight for the last one
+    size_t parts; // parts per frame
+    size_t part_pixels; // pixels per part, the last part of a frame may be shorter
+};
+
+/* fills schedule from --omp-frames, --omp-chunk and --omp-schedule for frames of pixels pixels that split at
+   multiples of unit, exits with an error if they are invalid */
+void frame_schedule_from_options(struct frame_schedule_struct *schedule, size_t pixels, size_t unit);
+
+/* plans the next batch when remaining frames are left */
+void frame_schedule_batch(const struct frame_schedule_struct *schedule, long remaining, struct frame_schedule_batch_struct *batch);
+
+/* number of work items of batch, frames x parts */
+size_t frame_schedule_items(const struct frame_schedule_batch_struct *batch);
+
+/* frame (within the batch) and pixels first to first + count - 1 of work item item of batch */
+void frame_schedule_item(const struct frame_schedule_struct *schedule, const struct frame_schedule_batch_struct *batch,
+                         size_t item, int *frame, size_t *first, size_t *count);
+
+/* zeroes frames frames of frame_bytes bytes in buffer from the threads that process them, see thread_placement.h */
+void frame_schedule_first_touch(const struct frame_schedule_struct *schedule, int frames, void *buffer, size_t frame_bytes);
+
+/* prints the schedule in the style of the tools' other settings */
+void frame_schedule_print(const struct frame_schedule_struct *schedule);
+
+#endif
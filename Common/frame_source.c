@@ -0,0 +1,294 @@
+/****************************************************************************************************************
+Input video of the video processing tools, see frame_source.h.
+****************************************************************************************************************/
+
+/* madvise and the MADV_ advice, pread, posix_fadvise */
+#define _GNU_SOURCE
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cli_options.h"
+#include "frame_source.h"
+
+/* reads bytes at offset, exits on an error or a short file */
+static void frame_source_pread(const struct frame_source_struct *source, unsigned char *buffer, size_t bytes, off_t offset)
+{
+    size_t done = 0;
+
+    while (done < bytes) {
+        ssize_t got = pread(source->fd, buffer + done, bytes - done, offset + (off_t) done);
+        if (got <= 0) {
+            printf("\nError: Could not read %s.\n", source->filename);
+            exit(1);
+        }
+        done += (size_t) got;
+    }
+
+    return;
+}
+
+static unsigned char *frame_source_alloc(const struct frame_source_struct *source, size_t bytes)
+{
+    unsigned char *buffer = (unsigned char *) malloc((bytes > 0) ? bytes : 1);
+    if (buffer == NULL) {
+        printf("Memory could not be allocated for the frames of %s\n", source->filename);
+        exit(1);
+    }
+
+    return buffer;
+}
+
+/********************************************************
+Reads --input=mmap|read and --input-ring=N and opens the
+file. A file that cannot be mapped (an empty file, a file
+larger than the address space) is read through the ring.
+Prints an error and exits if the file cannot be opened,
+is shorter than the header or an option is invalid.
+********************************************************/
+void frame_source_open(struct frame_source_struct *source, const char *filename, size_t header_bytes, size_t frame_bytes)
+{
+    const char *input = cli_option("input");
+    const char *ring = cli_option("input-ring");
+    struct stat status;
+    char extra;
+
+    if (input != NULL && strcmp(input, "mmap") != 0 && strcmp(input, "read") != 0) {
+        printf("\nError: Unknown input %s. Please use --input=mmap or read.\n", input);
+        exit(1);
+    }
+    source->ring_frames = FRAME_SOURCE_RING_FRAMES;
+    if (ring != NULL && (sscanf(ring, "%ld%c", &source->ring_frames, &extra) != 1 || source->ring_frames < 1)) {
+        printf("\nError: Invalid input ring %s. Please use --input-ring=N with N at least 1.\n", ring);
+        exit(1);
+    }
+
+    source->fd = open(filename, O_RDONLY);
+    if (source->fd < 0 || fstat(source->fd, &status) != 0) {
+        printf("\nError: Could not open %s.\n", filename);
+        exit(1);
+    }
+    source->filename = filename;
+    source->file_bytes = status.st_size;
+    source->header_bytes = header_bytes;
+    source->frame_bytes = frame_bytes;
+    if (source->file_bytes < (off_t) header_bytes) {
+        printf("\nError: %s is too short for the stream header.\n", filename);
+        exit(1);
+    }
+    source->frames = (long) ((source->file_bytes - (off_t) header_bytes) / (off_t) frame_bytes);
+    source->advised = 0;
+    source->released = 0;
+    source->data = NULL;
+    source->header = NULL;
+    source->ring = NULL;
+    source->ring_first = 0;
+    source->ring_count = 0;
+
+    source->mapped = 0;
+    if ((input == NULL || strcmp(input, "mmap") == 0) && source->file_bytes > 0
+        && (uintmax_t) source->file_bytes <= (uintmax_t) SIZE_MAX) {
+        void *map = mmap(NULL, (size_t) source->file_bytes, PROT_READ, MAP_PRIVATE, source->fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, (size_t) source->file_bytes, MADV_SEQUENTIAL);
+            source->data = (const unsigned char *) map;
+            source->mapped = 1;
+        }
+    }
+
+    if (source->mapped) {
+        /* the mapping stays valid without the descriptor */
+        close(source->fd);
+        source->fd = -1;
+    }
+    else {
+        posix_fadvise(source->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        source->header = frame_source_alloc(source, header_bytes);
+        frame_source_pread(source, source->header, header_bytes, 0);
+        source->ring = frame_source_alloc(source, (size_t) source->ring_frames * frame_bytes);
+    }
+
+    return;
+}
+
+void frame_source_close(struct frame_source_struct *source)
+{
+    if (source->mapped) {
+        munmap((void *) source->data, (size_t) source->file_bytes);
+    }
+    else {
+        free(source->header);
+        free(source->ring);
+        close(source->fd);
+    }
+    source->data = NULL;
+    source->header = NULL;
+    source->ring = NULL;
+
+    return;
+}
+
+void frame_source_print(const struct frame_source_struct *source)
+{
+    if (source->mapped) {
+        printf("\nInput = mmap, %ld frames of %zu bytes\n", source->frames, source->frame_bytes);
+    }
+    else {
+        printf("\nInput = read, %ld frames of %zu bytes through a ring of %ld frames\n", source->frames, source->frame_bytes,
+               source->ring_frames);
+    }
+
+    return;
+}
+
+long frame_source_count(const struct frame_source_struct *source, const char *requested)
+{
+    long frames;
+    char extra;
+
+    if (requested == NULL || strcmp(requested, "all") == 0) {
+        return source->frames;
+    }
+    if (sscanf(requested, "%ld%c", &frames, &extra) != 1 || frames < 0) {
+        printf("\nError: Invalid frame count %s. Please give a number of frames or all.\n", requested);
+        exit(1);
+    }
+    if (frames > source->frames) {
+        printf("\nError: %s has only %ld frames.\n", source->filename, source->frames);
+        exit(1);
+    }
+
+    return (frames == 0) ? source->frames : frames;
+}
+
+const void *frame_source_header(const struct frame_source_struct *source)
+{
+    return source->mapped ? (const void *) source->data : (const void *) source->header;
+}
+
+/* exits with an error if frames first to first + count - 1 are not in the file */
+static void frame_source_check(const struct frame_source_struct *source, long first, long count)
+{
+    if (first < 0 || count < 0 || first + count > source->frames) {
+        printf("\nError: Frames %ld to %ld are not in %s, it has %ld frames.\n", first, first + count - 1, source->filename,
+               source->frames);
+        exit(1);
+    }
+
+    return;
+}
+
+/********************************************************
+Keeps the mapping around the frames in use resident: the
+window after them is advised MADV_WILLNEED and the pages
+before them are released, both in steps of half a window
+so the system calls stay rare. Released pages are clean,
+reading them again pages them back in from the file.
+********************************************************/
+static void frame_source_advise(struct frame_source_struct *source, off_t start, off_t end)
+{
+    const off_t step = FRAME_SOURCE_READAHEAD_BYTES / 2;
+    off_t page = (off_t) sysconf(_SC_PAGESIZE);
+
+    if (end + step > source->advised && source->advised < source->file_bytes) {
+        off_t from = ((start > source->advised) ? start : source->advised) / page * page;
+        off_t to = end + FRAME_SOURCE_READAHEAD_BYTES;
+        if (to > source->file_bytes) {
+            to = source->file_bytes;
+        }
+        madvise((void *) (source->data + from), (size_t) (to - from), MADV_WILLNEED);
+        source->advised = to;
+    }
+
+    off_t behind = start / page * page;
+    if (behind >= source->released + step) {
+        madvise((void *) (source->data + source->released), (size_t) (behind - source->released), MADV_DONTNEED);
+        source->released = behind;
+    }
+
+    return;
+}
+
+/********************************************************
+Makes frames first to first + count - 1 the start of the
+ring: frames of them already in the ring move to its
+front, the rest of the ring is filled from the file with
+one pread. A request larger than the ring grows it.
+********************************************************/
+static void frame_source_fill(struct frame_source_struct *source, long first, long count)
+{
+    if (count > source->ring_frames) {
+        free(source->ring);
+        source->ring_frames = count;
+        source->ring = frame_source_alloc(source, (size_t) count * source->frame_bytes);
+        source->ring_count = 0;
+    }
+
+    long keep = 0;
+    if (first >= source->ring_first && first < source->ring_first + source->ring_count) {
+        keep = source->ring_first + source->ring_count - first;
+        memmove(source->ring, source->ring + (size_t) (first - source->ring_first) * source->frame_bytes,
+                (size_t) keep * source->frame_bytes);
+    }
+
+    long load = source->frames - first;
+    if (load > source->ring_frames) {
+        load = source->ring_frames;
+    }
+    load -= keep;
+    frame_source_pread(source, source->ring + (size_t) keep * source->frame_bytes, (size_t) load * source->frame_bytes,
+                       (off_t) source->header_bytes + (off_t) (first + keep) * (off_t) source->frame_bytes);
+    source->ring_first = first;
+    source->ring_count = keep + load;
+
+    return;
+}
+
+/********************************************************
+Returns a pointer to the frames, in the mapping or in the
+ring. Prints an error and exits if the frames are not in
+the file.
+********************************************************/
+const void *frame_source_frames(struct frame_source_struct *source, long first, long count)
+{
+    frame_source_check(source, first, count);
+
+    off_t start = (off_t) source->header_bytes + (off_t) first * (off_t) source->frame_bytes;
+    if (source->mapped) {
+        frame_source_advise(source, start, start + (off_t) count * (off_t) source->frame_bytes);
+        return source->data + start;
+    }
+
+    if (first < source->ring_first || first + count > source->ring_first + source->ring_count) {
+        frame_source_fill(source, first, count);
+    }
+
+    return source->ring + (size_t) (first - source->ring_first) * source->frame_bytes;
+}
+
+/********************************************************
+Copies the frames to buffer. In read mode the frames not
+in the ring are read straight into buffer, so a caller
+with buffers of its own (frame_pipeline.h) does not pay a
+second copy.
+********************************************************/
+void frame_source_copy(struct frame_source_struct *source, long first, long count, void *buffer)
+{
+    if (source->mapped || (first >= source->ring_first && first + count <= source->ring_first + source->ring_count)) {
+        memcpy(buffer, frame_source_frames(source, first, count), (size_t) count * source->frame_bytes);
+        return;
+    }
+
+    frame_source_check(source, first, count);
+    frame_source_pread(source, (unsigned char *) buffer, (size_t) count * source->frame_bytes,
+                       (off_t) source->header_bytes + (off_t) first * (off_t) source->frame_bytes);
+
+    return;
+}
@@ -0,0 +1,70 @@
+/****************************************************************************************************************
+Input video of the video processing tools, read frame by frame in bounded memory however long the video is.
+
+With --input=mmap (default) the file is mapped read-only and frames are handed out as pointers into the mapping,
+so nothing is copied and nothing is read before the first frame: the kernel pages frames in as they are used. The
+mapping is advised MADV_SEQUENTIAL, every request for frames advises the window of FRAME_SOURCE_READAHEAD_BYTES
+after them MADV_WILLNEED, so the disk reads ahead of the compute, and releases the pages of the frames before them
+(MADV_DONTNEED), so only about one window of the video is resident at a time.
+
+With --input=read, and for files that cannot be mapped, frames are read with pread into a ring of
+--input-ring=N frames (default FRAME_SOURCE_RING_FRAMES), which is all the memory the input takes. The ring grows
+once if the tool asks for more frames at a time.
+
+A file is an optional header of header_bytes (the hybrid stream header) followed by frames of frame_bytes. A
+trailing partial frame is ignored. Offsets into the file are 64-bit (off_t), so videos may exceed 2 GiB.
+****************************************************************************************************************/
+
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define FRAME_SOURCE_READAHEAD_BYTES (16 * 1024 * 1024) // advised MADV_WILLNEED after the frames in use
+#define FRAME_SOURCE_RING_FRAMES 16 // default --input-ring
+
+struct frame_source_struct {
+    const char *filename;
+    int fd; // descriptor of the file in read mode, -1 with a mapping
+    int mapped; // nonzero if data is a mapping of the file, zero in read mode
+    const unsigned char *data; // mapping of the file, NULL in read mode
+    off_t file_bytes;
+    size_t header_bytes; // bytes before the first frame
+    size_t frame_bytes;
+    long frames; // whole frames in the file
+    off_t advised; // mmap: end of the range advised MADV_WILLNEED so far
+    off_t released; // mmap: end of the range released with MADV_DONTNEED so far
+    unsigned char *header; // read mode: the header_bytes at the start of the file
+    unsigned char *ring; // read mode: frames ring_first to ring_first + ring_count - 1
+    long ring_frames; // read mode: capacity of the ring
+    long ring_first;
+    long ring_count;
+};
+
+/* reads --input and --input-ring and opens filename as a header of header_bytes and frames of frame_bytes, exits
+   with an error if it cannot be opened or is shorter than the header */
+void frame_source_open(struct frame_source_struct *source, const char *filename, size_t header_bytes, size_t frame_bytes);
+
+/* unmaps the file or frees the ring and closes the file */
+void frame_source_close(struct frame_source_struct *source);
+
+/* prints the input in the style of the tools' other settings */
+void frame_source_print(const struct frame_source_struct *source);
+
+/* number of frames to process for the num_of_frames argument requested: all frames of the file for NULL, "all"
+   or 0, exits with an error if it is not a number or exceeds the frames of the file */
+long frame_source_count(const struct frame_source_struct *source, const char *requested);
+
+/* the header_bytes at the start of the file */
+const void *frame_source_header(const struct frame_source_struct *source);
+
+/* frames first to first + count - 1, one after the other in memory, valid until the next call; frames are asked
+   for in increasing order, not thread-safe, the threads share the frames one thread asked for */
+const void *frame_source_frames(struct frame_source_struct *source, long first, long count);
+
+/* copies frames first to first + count - 1 to buffer, read mode reads them there directly; same order and thread
+   rules as frame_source_frames */
+void frame_source_copy(struct frame_source_struct *source, long first, long count, void *buffer);
+
+#endif
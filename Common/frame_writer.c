@@ -0,0 +1,405 @@
+/****************************************************************************************************************
+Output video of the video processing tools, see frame_writer.h.
+****************************************************************************************************************/
+
+/* O_DIRECT, pwrite, ftruncate, syscall */
+#define _GNU_SOURCE
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "cli_options.h"
+#include "frame_writer.h"
+
+/* writes bytes at offset, exits on an error */
+static void frame_writer_pwrite(const struct frame_writer_struct *writer, const unsigned char *data, size_t bytes, off_t offset)
+{
+    size_t done = 0;
+
+    while (done < bytes) {
+        ssize_t put = pwrite(writer->fd, data + done, bytes - done, offset + (off_t) done);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put <= 0) {
+            printf("\nError: Could not write %s.\n", writer->filename);
+            exit(1);
+        }
+        done += (size_t) put;
+    }
+
+    return;
+}
+
+/********************************************************
+Sets up an io_uring of at least depth entries and maps its
+submission queue, completion queue and submission queue
+entries. Returns zero if the kernel does not offer
+io_uring (too old, or a sandbox forbids it).
+********************************************************/
+static int frame_writer_uring_init(struct frame_writer_uring_struct *uring, long depth)
+{
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    uring->fd = (int) syscall(__NR_io_uring_setup, (unsigned) depth, &params);
+    if (uring->fd < 0) {
+        return 0;
+    }
+
+    uring->sq_map_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring->cq_map_bytes = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    uring->sqes_bytes = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sq_map = mmap(NULL, uring->sq_map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd,
+                         IORING_OFF_SQ_RING);
+    uring->cq_map = mmap(NULL, uring->cq_map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd,
+                         IORING_OFF_CQ_RING);
+    uring->sqes = mmap(NULL, uring->sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd,
+                       IORING_OFF_SQES);
+    if (uring->sq_map == MAP_FAILED || uring->cq_map == MAP_FAILED || uring->sqes == MAP_FAILED) {
+        printf("\nError: Could not map the io_uring.\n");
+        exit(1);
+    }
+
+    unsigned char *sq = (unsigned char *) uring->sq_map;
+    unsigned char *cq = (unsigned char *) uring->cq_map;
+    uring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    uring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    uring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    uring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    uring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    uring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    uring->cqes = cq + params.cq_off.cqes;
+
+    return 1;
+}
+
+static void frame_writer_uring_free(struct frame_writer_uring_struct *uring)
+{
+    munmap(uring->sqes, uring->sqes_bytes);
+    munmap(uring->cq_map, uring->cq_map_bytes);
+    munmap(uring->sq_map, uring->sq_map_bytes);
+    close(uring->fd);
+
+    return;
+}
+
+/* queues the write of a block and enters the kernel to start it, the queue has room for every block */
+static void frame_writer_uring_submit(struct frame_writer_struct *writer, long index)
+{
+    struct frame_writer_uring_struct *uring = &writer->uring;
+    struct frame_writer_block_struct *block = &writer->blocks[index];
+    unsigned tail = *uring->sq_tail;
+    unsigned slot = tail & *uring->sq_mask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *) uring->sqes)[slot];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = writer->fd;
+    sqe->addr = (unsigned long) &block->iov;
+    sqe->len = 1;
+    sqe->off = (unsigned long long) block->offset;
+    sqe->user_data = (unsigned long long) index;
+    uring->sq_array[slot] = slot;
+    __atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    while (syscall(__NR_io_uring_enter, uring->fd, 1, 0, 0, NULL, 0) < 0) {
+        if (errno != EINTR && errno != EAGAIN) {
+            printf("\nError: Could not submit a write of %s.\n", writer->filename);
+            exit(1);
+        }
+    }
+
+    return;
+}
+
+/********************************************************
+Waits for at least one completion and marks the blocks of
+all completions there are as free. A short write, which a
+regular file only has when the disk is nearly full, is
+finished with pwrite.
+********************************************************/
+static void frame_writer_uring_reap(struct frame_writer_struct *writer)
+{
+    struct frame_writer_uring_struct *uring = &writer->uring;
+
+    while (syscall(__NR_io_uring_enter, uring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+        if (errno != EINTR) {
+            printf("\nError: Could not wait for the writes of %s.\n", writer->filename);
+            exit(1);
+        }
+    }
+
+    unsigned head = *uring->cq_head;
+    unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &((struct io_uring_cqe *) uring->cqes)[head & *uring->cq_mask];
+        struct frame_writer_block_struct *block = &writer->blocks[cqe->user_data];
+        if (cqe->res < 0) {
+            printf("\nError: Could not write %s.\n", writer->filename);
+            exit(1);
+        }
+        if ((size_t) cqe->res < block->iov.iov_len) {
+            frame_writer_pwrite(writer, block->data + cqe->res, block->iov.iov_len - (size_t) cqe->res,
+                                block->offset + (off_t) cqe->res);
+        }
+        block->pending = 0;
+    }
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+    return;
+}
+
+/* I/O thread: writes the submitted blocks in order until the writer is closed and nothing is left */
+static void *frame_writer_thread(void *argument)
+{
+    struct frame_writer_struct *writer = (struct frame_writer_struct *) argument;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (writer->completed == writer->submitted && !writer->closing) {
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        }
+        if (writer->completed == writer->submitted) {
+            break;
+        }
+        struct frame_writer_block_struct *block = &writer->blocks[writer->completed % writer->depth];
+        pthread_mutex_unlock(&writer->lock);
+
+        frame_writer_pwrite(writer, block->data, block->iov.iov_len, block->offset);
+
+        pthread_mutex_lock(&writer->lock);
+        block->pending = 0;
+        writer->completed++;
+        pthread_cond_broadcast(&writer->changed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    return NULL;
+}
+
+/* returns once the write of the block completed */
+static void frame_writer_wait(struct frame_writer_struct *writer, struct frame_writer_block_struct *block)
+{
+    if (writer->backend == FRAME_WRITER_URING) {
+        while (block->pending) {
+            frame_writer_uring_reap(writer);
+        }
+    }
+    else {
+        pthread_mutex_lock(&writer->lock);
+        while (block->pending) {
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        }
+        pthread_mutex_unlock(&writer->lock);
+    }
+
+    return;
+}
+
+/********************************************************
+Submits the block being filled, padded to the alignment
+with O_DIRECT, and makes the next block the one being
+filled once its previous write completed.
+********************************************************/
+static void frame_writer_submit(struct frame_writer_struct *writer)
+{
+    long index = writer->submitted % writer->depth;
+    struct frame_writer_block_struct *block = &writer->blocks[index];
+    size_t length = block->bytes;
+
+    if (writer->direct) {
+        length = (length + FRAME_WRITER_ALIGN_BYTES - 1) / FRAME_WRITER_ALIGN_BYTES * FRAME_WRITER_ALIGN_BYTES;
+        memset(block->data + block->bytes, 0, length - block->bytes);
+    }
+    block->iov.iov_base = block->data;
+    block->iov.iov_len = length;
+
+    if (writer->backend == FRAME_WRITER_URING) {
+        block->pending = 1;
+        writer->submitted++;
+        frame_writer_uring_submit(writer, index);
+    }
+    else {
+        pthread_mutex_lock(&writer->lock);
+        block->pending = 1;
+        writer->submitted++;
+        pthread_cond_broadcast(&writer->changed);
+        pthread_mutex_unlock(&writer->lock);
+    }
+
+    struct frame_writer_block_struct *next = &writer->blocks[writer->submitted % writer->depth];
+    frame_writer_wait(writer, next);
+    next->bytes = 0;
+    next->offset = block->offset + (off_t) writer->block_bytes;
+
+    return;
+}
+
+/********************************************************
+Reads the options, creates the file and allocates the
+blocks. --writer=auto falls back to the I/O thread if
+io_uring cannot be set up, --writer-direct=on falls back
+to the page cache if the file system refuses O_DIRECT.
+********************************************************/
+void frame_writer_open(struct frame_writer_struct *writer, const char *filename)
+{
+    const char *backend = cli_option("writer");
+    const char *direct = cli_option("writer-direct");
+    const char *depth = cli_option("writer-depth");
+    const char *block = cli_option("writer-block");
+    char extra;
+
+    if (backend != NULL && strcmp(backend, "auto") != 0 && strcmp(backend, "uring") != 0 && strcmp(backend, "thread") != 0) {
+        printf("\nError: Unknown writer %s. Please use --writer=auto, uring or thread.\n", backend);
+        exit(1);
+    }
+    if (direct != NULL && strcmp(direct, "on") != 0 && strcmp(direct, "off") != 0) {
+        printf("\nError: Unknown writer direct %s. Please use --writer-direct=on or off.\n", direct);
+        exit(1);
+    }
+    writer->depth = FRAME_WRITER_DEPTH;
+    if (depth != NULL && (sscanf(depth, "%ld%c", &writer->depth, &extra) != 1 || writer->depth < 1)) {
+        printf("\nError: Invalid writer depth %s. Please use --writer-depth=N with N at least 1.\n", depth);
+        exit(1);
+    }
+    writer->block_bytes = FRAME_WRITER_BLOCK_BYTES;
+    if (block != NULL && (sscanf(block, "%zu%c", &writer->block_bytes, &extra) != 1 || writer->block_bytes < 1)) {
+        printf("\nError: Invalid writer block %s. Please use --writer-block=bytes with at least 1 byte.\n", block);
+        exit(1);
+    }
+    writer->block_bytes = (writer->block_bytes + FRAME_WRITER_ALIGN_BYTES - 1) / FRAME_WRITER_ALIGN_BYTES * FRAME_WRITER_ALIGN_BYTES;
+
+    writer->filename = filename;
+    writer->direct = direct != NULL && strcmp(direct, "on") == 0;
+    writer->fd = -1;
+    if (writer->direct) {
+        writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+        writer->direct = writer->fd >= 0;
+    }
+    if (writer->fd < 0) {
+        writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    }
+    if (writer->fd < 0) {
+        printf("\nError: Could not create %s.\n", filename);
+        exit(1);
+    }
+
+    writer->blocks = (struct frame_writer_block_struct *) calloc(writer->depth, sizeof(struct frame_writer_block_struct));
+    if (writer->blocks == NULL) {
+        printf("Memory could not be allocated for the blocks of %s\n", filename);
+        exit(1);
+    }
+    for (long b = 0; b < writer->depth; b++) {
+        if (posix_memalign((void **) &writer->blocks[b].data, FRAME_WRITER_ALIGN_BYTES, writer->block_bytes) != 0) {
+            printf("Memory could not be allocated for the blocks of %s\n", filename);
+            exit(1);
+        }
+    }
+    writer->submitted = 0;
+    writer->completed = 0;
+    writer->closing = 0;
+    writer->bytes = 0;
+
+    writer->backend = FRAME_WRITER_THREAD;
+    if (backend == NULL || strcmp(backend, "thread") != 0) {
+        if (frame_writer_uring_init(&writer->uring, writer->depth)) {
+            writer->backend = FRAME_WRITER_URING;
+        }
+        else if (backend != NULL && strcmp(backend, "uring") == 0) {
+            printf("\nError: io_uring is not available. Please use --writer=thread.\n");
+            exit(1);
+        }
+    }
+    if (writer->backend == FRAME_WRITER_THREAD) {
+        pthread_mutex_init(&writer->lock, NULL);
+        pthread_cond_init(&writer->changed, NULL);
+        if (pthread_create(&writer->thread, NULL, frame_writer_thread, writer) != 0) {
+            printf("\nError: Could not start the writer thread.\n");
+            exit(1);
+        }
+    }
+
+    return;
+}
+
+void frame_writer_print(const struct frame_writer_struct *writer)
+{
+    printf("\nWriter = %s, %ld writes of %zu bytes in flight, %s\n",
+           (writer->backend == FRAME_WRITER_URING) ? "uring" : "thread", writer->depth, writer->block_bytes,
+           writer->direct ? "O_DIRECT" : "page cache");
+
+    return;
+}
+
+void frame_writer_write(struct frame_writer_struct *writer, const void *data, size_t bytes)
+{
+    const unsigned char *from = (const unsigned char *) data;
+
+    writer->bytes += (off_t) bytes;
+    while (bytes > 0) {
+        struct frame_writer_block_struct *block = &writer->blocks[writer->submitted % writer->depth];
+        size_t copy = writer->block_bytes - block->bytes;
+        if (copy > bytes) {
+            copy = bytes;
+        }
+        memcpy(block->data + block->bytes, from, copy);
+        block->bytes += copy;
+        from += copy;
+        bytes -= copy;
+        if (block->bytes == writer->block_bytes) {
+            frame_writer_submit(writer);
+        }
+    }
+
+    return;
+}
+
+/********************************************************
+Submits the partly filled block, waits for every write,
+stops the I/O thread or tears down the io_uring, cuts the
+padding of the last O_DIRECT write off and closes the
+file.
+********************************************************/
+void frame_writer_close(struct frame_writer_struct *writer)
+{
+    if (writer->blocks[writer->submitted % writer->depth].bytes > 0) {
+        frame_writer_submit(writer);
+    }
+    for (long b = 0; b < writer->depth; b++) {
+        frame_writer_wait(writer, &writer->blocks[b]);
+    }
+
+    if (writer->backend == FRAME_WRITER_URING) {
+        frame_writer_uring_free(&writer->uring);
+    }
+    else {
+        pthread_mutex_lock(&writer->lock);
+        writer->closing = 1;
+        pthread_cond_broadcast(&writer->changed);
+        pthread_mutex_unlock(&writer->lock);
+        pthread_join(writer->thread, NULL);
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->changed);
+    }
+
+    if ((writer->direct && ftruncate(writer->fd, writer->bytes) != 0) || close(writer->fd) != 0) {
+        printf("\nError: Could not write %s.\n", writer->filename);
+        exit(1);
+    }
+    for (long b = 0; b < writer->depth; b++) {
+        free(writer->blocks[b].data);
+    }
+    free(writer->blocks);
+
+    return;
+}
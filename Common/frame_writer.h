@@ -0,0 +1,95 @@
+/****************************************************************************************************************
+Output video of the video processing tools, written asynchronously in aligned blocks.
+
+frame_writer_write copies the bytes it is given into a block of --writer-block=bytes (default
+FRAME_WRITER_BLOCK_BYTES, rounded up to a multiple of FRAME_WRITER_ALIGN_BYTES and allocated at that alignment) and
+returns; a full block is submitted as one write at its offset in the file while the next block is filled. There
+are --writer-depth=N blocks (default FRAME_WRITER_DEPTH), so up to N writes are in flight, and a block is filled
+again only after its write completed.
+
+With --writer=uring the blocks are submitted through an io_uring, set up with the raw system calls, and the
+completions are reaped by the writing thread when it needs a block back. With --writer=thread an I/O thread writes
+the blocks in order with pwrite. --writer=auto (default) uses io_uring if the kernel offers it and the thread
+otherwise.
+
+--writer-direct=on opens the file with O_DIRECT, so the writes bypass the page cache. Blocks are aligned in
+memory, in size and in the file; the last block is padded to the alignment and the padding is cut off when the
+file is closed, so the header and the frames need not be aligned themselves. A file system without O_DIRECT is
+written through the page cache.
+
+One thread at a time writes. A failed write prints an error and exits.
+****************************************************************************************************************/
+
+#ifndef FRAME_WRITER_H
+#define FRAME_WRITER_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define FRAME_WRITER_BLOCK_BYTES (1024 * 1024) // default --writer-block
+#define FRAME_WRITER_DEPTH 4 // default --writer-depth
+#define FRAME_WRITER_ALIGN_BYTES 4096 // alignment of the blocks, enough for O_DIRECT
+
+#define FRAME_WRITER_URING 0
+#define FRAME_WRITER_THREAD 1
+
+struct frame_writer_block_struct {
+    unsigned char *data;
+    size_t bytes; // bytes filled
+    off_t offset; // offset of the block in the file
+    int pending; // submitted and not completed
+    struct iovec iov; // the write submitted, padded with O_DIRECT
+};
+
+/* rings shared with the kernel */
+struct frame_writer_uring_struct {
+    int fd;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    void *sqes;
+    void *cqes;
+    void *sq_map;
+    size_t sq_map_bytes;
+    void *cq_map;
+    size_t cq_map_bytes;
+    size_t sqes_bytes;
+};
+
+struct frame_writer_struct {
+    const char *filename;
+    int fd;
+    int backend; // FRAME_WRITER_URING or FRAME_WRITER_THREAD
+    int direct; // the file is open with O_DIRECT
+    long depth; // --writer-depth, blocks
+    size_t block_bytes; // --writer-block
+    struct frame_writer_block_struct *blocks;
+    long submitted; // blocks submitted so far, the block being filled is submitted % depth
+    off_t bytes; // bytes written so far, including the block being filled
+    struct frame_writer_uring_struct uring;
+    pthread_t thread; // thread: the I/O thread
+    pthread_mutex_t lock; // thread: guards submitted, completed, closing and the pending flags
+    pthread_cond_t changed;
+    long completed; // thread: blocks written by the I/O thread
+    int closing;
+};
+
+/* reads --writer, --writer-direct, --writer-depth and --writer-block and creates filename, exits with an error
+   if it cannot be created, io_uring was asked for and is not available or an option is invalid */
+void frame_writer_open(struct frame_writer_struct *writer, const char *filename);
+
+/* prints the writer in the style of the tools' other settings */
+void frame_writer_print(const struct frame_writer_struct *writer);
+
+/* appends bytes to the file, returns once they are copied into a block */
+void frame_writer_write(struct frame_writer_struct *writer, const void *data, size_t bytes);
+
+/* writes the last block, waits for all writes and closes the file */
+void frame_writer_close(struct frame_writer_struct *writer);
+
+#endif
@@ -0,0 +1,145 @@
+/****************************************************************************************************************
+Thread-local bump arena for GMP temporaries, see gmp_arena.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* other open source c libraries */
+#include <gmp.h>
+
+#include "gmp_arena.h"
+
+#define GMP_ARENA_ALIGN 16
+
+struct gmp_arena_struct {
+    char *base; // arena memory of this thread, NULL until its first region
+    size_t size;
+    size_t used; // bytes handed out since the outermost gmp_arena_begin
+    size_t overflow; // bytes that did not fit during the last region, the arena grows by them at the next one
+    int depth; // nesting depth of regions, 0 outside any region
+};
+
+static __thread struct gmp_arena_struct gmp_arena;
+static int gmp_arena_installed; // regions do nothing until gmp_arena_install
+
+static inline size_t gmp_arena_round(size_t bytes)
+{
+    return (bytes + GMP_ARENA_ALIGN - 1) & ~(size_t) (GMP_ARENA_ALIGN - 1);
+}
+
+static inline int gmp_arena_owns(const void *pointer)
+{
+    return gmp_arena.base != NULL && (const char *) pointer >= gmp_arena.base
+           && (const char *) pointer < gmp_arena.base + gmp_arena.size;
+}
+
+static void *gmp_arena_heap_alloc(size_t bytes)
+{
+    void *pointer = malloc(bytes);
+    if (pointer == NULL) {
+        printf("Memory could not be allocated for GMP\n");
+        exit(1);
+    }
+
+    return pointer;
+}
+
+static void *gmp_arena_alloc(size_t bytes)
+{
+    size_t rounded = gmp_arena_round(bytes);
+
+    if (gmp_arena.depth == 0) {
+        return gmp_arena_heap_alloc(bytes);
+    }
+    if (gmp_arena.used + rounded > gmp_arena.size) {
+        gmp_arena.overflow += rounded;
+        return gmp_arena_heap_alloc(bytes);
+    }
+
+    void *pointer = gmp_arena.base + gmp_arena.used;
+    gmp_arena.used += rounded;
+
+    return pointer;
+}
+
+static void gmp_arena_free(void *pointer, size_t bytes)
+{
+    if (!gmp_arena_owns(pointer)) {
+        free(pointer);
+        return;
+    }
+
+    /* the last block is given back at once, anything else when the region ends */
+    if ((char *) pointer + gmp_arena_round(bytes) == gmp_arena.base + gmp_arena.used) {
+        gmp_arena.used -= gmp_arena_round(bytes);
+    }
+
+    return;
+}
+
+static void *gmp_arena_realloc(void *pointer, size_t old_bytes, size_t new_bytes)
+{
+    /* memory from outside the arena stays on the heap, it may belong to a long-lived value */
+    if (!gmp_arena_owns(pointer)) {
+        void *moved = realloc(pointer, new_bytes);
+        if (moved == NULL) {
+            printf("Memory could not be allocated for GMP\n");
+            exit(1);
+        }
+        return moved;
+    }
+
+    /* the last block grows or shrinks in place */
+    size_t offset = (size_t) ((char *) pointer - gmp_arena.base);
+    if (offset + gmp_arena_round(old_bytes) == gmp_arena.used && offset + gmp_arena_round(new_bytes) <= gmp_arena.size) {
+        gmp_arena.used = offset + gmp_arena_round(new_bytes);
+        return pointer;
+    }
+
+    void *moved = gmp_arena_alloc(new_bytes);
+    memcpy(moved, pointer, (old_bytes < new_bytes) ? old_bytes : new_bytes);
+    gmp_arena_free(pointer, old_bytes);
+
+    return moved;
+}
+
+void gmp_arena_install(void)
+{
+    mp_set_memory_functions(gmp_arena_alloc, gmp_arena_realloc, gmp_arena_free);
+    gmp_arena_installed = 1;
+
+    return;
+}
+
+void gmp_arena_begin(void)
+{
+    if (gmp_arena.depth++ > 0 || !gmp_arena_installed) {
+        return;
+    }
+
+    /* nothing lives in the arena between regions, so it can be replaced by a larger one */
+    if (gmp_arena.base == NULL || gmp_arena.overflow > 0) {
+        size_t size = (gmp_arena.base == NULL) ? GMP_ARENA_INITIAL_BYTES : gmp_arena.size + 2 * gmp_arena.overflow;
+        free(gmp_arena.base);
+        gmp_arena.base = (char *) gmp_arena_heap_alloc(size);
+        gmp_arena.size = size;
+        gmp_arena.overflow = 0;
+    }
+    gmp_arena.used = 0;
+
+    return;
+}
+
+void gmp_arena_end(void)
+{
+    if (--gmp_arena.depth > 0) {
+        return;
+    }
+    gmp_arena.used = 0;
+
+    return;
+}
@@ -0,0 +1,26 @@
+/****************************************************************************************************************
+Thread-local bump arena for GMP temporaries. Once installed with mp_set_memory_functions, every GMP allocation a
+thread makes between gmp_arena_begin and gmp_arena_end comes from that thread's own arena: a pointer bump, with
+last-in-first-out frees handed back at once, and the whole arena reset at gmp_arena_end. Threads never meet in the
+allocator, and after the first call the arena is large enough that the region makes no heap calls at all. Outside
+a region, and for memory allocated outside one, the functions fall back to malloc, realloc and free.
+
+Values allocated inside a region must not outlive it, so long-lived mpz_t (keys, per-thread scratch) are allocated
+before gmp_arena_begin.
+****************************************************************************************************************/
+
+#ifndef GMP_ARENA_H
+#define GMP_ARENA_H
+
+#define GMP_ARENA_INITIAL_BYTES (64 * 1024)
+
+/* routes GMP allocations through the arena functions, safe to call more than once */
+void gmp_arena_install(void);
+
+/* starts a region of the calling thread, regions nest and only the outermost one resets the arena, no-op until installed */
+void gmp_arena_begin(void);
+
+/* ends a region of the calling thread, everything allocated in the outermost region is released */
+void gmp_arena_end(void);
+
+#endif
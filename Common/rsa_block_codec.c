@@ -0,0 +1,103 @@
+/****************************************************************************************************************
+Block codec of the encrypted frames, see rsa_block_codec.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+
+/* other open source c libraries */
+#include <gmp.h>
+
+#include "rsa_block_codec.h"
+
+#define RSA_BLOCK_WORD_BITS (sizeof(unsigned int) * CHAR_BIT)
+
+/* bits bits of value starting at bit, bits at most GMP_NUMB_BITS, the field may span two limbs */
+static inline unsigned long rsa_block_bits(const mpz_t value, size_t bit, unsigned int bits)
+{
+    size_t shift = bit % GMP_NUMB_BITS;
+    mp_limb_t mask = (bits < GMP_NUMB_BITS) ? (((mp_limb_t) 1 << bits) - 1) : ~(mp_limb_t) 0;
+
+    /* mpz_getlimbn returns 0 for limbs above the size of value */
+    mp_limb_t field = mpz_getlimbn(value, (mp_size_t) (bit / GMP_NUMB_BITS)) >> shift;
+    if (shift + bits > GMP_NUMB_BITS) {
+        field |= mpz_getlimbn(value, (mp_size_t) (bit / GMP_NUMB_BITS) + 1) << (GMP_NUMB_BITS - shift);
+    }
+
+    return (unsigned long) (field & mask);
+}
+
+void rsa_block_codec_init(struct rsa_block_codec_struct *codec, const mpz_t n, int depth)
+{
+    size_t bits = mpz_sizeinbase(n, 2);
+
+    /* depth * block_pixels <= bits - 1, so every packed block is below 2^(bits - 1) <= n */
+    codec->depth = depth;
+    codec->block_pixels = (bits - 1) / (size_t) depth;
+    codec->block_words = (bits + RSA_BLOCK_WORD_BITS - 1) / RSA_BLOCK_WORD_BITS;
+
+    /* a modulus of one word keeps the one-ciphertext-per-pixel format */
+    if (codec->block_words == 1) {
+        codec->block_pixels = 1;
+    }
+
+    return;
+}
+
+size_t rsa_block_codec_blocks(const struct rsa_block_codec_struct *codec, size_t pixels)
+{
+    return (pixels + codec->block_pixels - 1) / codec->block_pixels;
+}
+
+size_t rsa_block_codec_words(const struct rsa_block_codec_struct *codec, size_t pixels)
+{
+    return rsa_block_codec_blocks(codec, pixels) * codec->block_words;
+}
+
+void rsa_block_pack(const struct rsa_block_codec_struct *codec, mpz_t value, const uint16_t *frame, size_t pixels,
+                    size_t block)
+{
+    size_t start = block * codec->block_pixels;
+    size_t count = (pixels - start < codec->block_pixels) ? pixels - start : codec->block_pixels;
+
+    /* void mpz_import (mpz_t rop, size_t count, int order, size_t size, int endian, size_t nails, const void *op) */
+    /* order -1 takes the least significant pixel first, the nails drop the 16 - depth unused top bits of every
+       pixel and the missing tail pixels are implicit zeros */
+    mpz_import(value, count, -1, sizeof(uint16_t), 0, (size_t) (16 - codec->depth), &frame[start]);
+
+    return;
+}
+
+void rsa_block_unpack(const struct rsa_block_codec_struct *codec, uint16_t *frame, size_t pixels, size_t block,
+                      const mpz_t value)
+{
+    size_t start = block * codec->block_pixels;
+    size_t count = (pixels - start < codec->block_pixels) ? pixels - start : codec->block_pixels;
+
+    for (size_t i = 0; i < count; i++) {
+        frame[start + i] = (uint16_t) rsa_block_bits(value, i * (size_t) codec->depth, (unsigned int) codec->depth);
+    }
+
+    return;
+}
+
+void rsa_block_store(const struct rsa_block_codec_struct *codec, unsigned int *words, size_t block, const mpz_t value)
+{
+    unsigned int *stored = &words[block * codec->block_words];
+
+    for (size_t w = 0; w < codec->block_words; w++) {
+        stored[w] = (unsigned int) rsa_block_bits(value, w * RSA_BLOCK_WORD_BITS, RSA_BLOCK_WORD_BITS);
+    }
+
+    return;
+}
+
+void rsa_block_load(const struct rsa_block_codec_struct *codec, mpz_t value, const unsigned int *words, size_t block)
+{
+    mpz_import(value, codec->block_words, -1, sizeof(unsigned int), 0, 0, &words[block * codec->block_words]);
+
+    return;
+}
@@ -0,0 +1,47 @@
+/****************************************************************************************************************
+Block codec of the encrypted frames. As many pixels of depth bits as stay below n are packed into one integer
+(pixel 0 in the lowest depth bits), so a large modulus enciphers a whole block per exponentiation instead of a
+single pixel, and shallower pixels make fuller blocks. Each block is stored as a fixed number of unsigned int
+words, least significant word first, and the last block of a frame is padded with zero pixels. For moduli of at
+most 32 bits a block is one pixel in one word, which is the original one-ciphertext-per-pixel format.
+****************************************************************************************************************/
+
+#ifndef RSA_BLOCK_CODEC_H
+#define RSA_BLOCK_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* other open source c libraries */
+#include <gmp.h>
+
+struct rsa_block_codec_struct {
+    int depth; // bits per pixel in a block
+    size_t block_pixels; // pixels per block, depth * block_pixels < bits of n
+    size_t block_words; // unsigned int words per encrypted block, enough for any value below n
+};
+
+/* sizes the blocks for modulus n and pixels of depth bits, n must have more than depth bits */
+void rsa_block_codec_init(struct rsa_block_codec_struct *codec, const mpz_t n, int depth);
+
+/* number of blocks of a frame of pixels pixels */
+size_t rsa_block_codec_blocks(const struct rsa_block_codec_struct *codec, size_t pixels);
+
+/* number of unsigned int words of an encrypted frame of pixels pixels */
+size_t rsa_block_codec_words(const struct rsa_block_codec_struct *codec, size_t pixels);
+
+/* packs block number block of frame (pixels pixels in all) into value, pixels must have at most depth bits */
+void rsa_block_pack(const struct rsa_block_codec_struct *codec, mpz_t value, const uint16_t *frame, size_t pixels,
+                    size_t block);
+
+/* unpacks value into block number block of frame, pixels beyond the end of the frame are dropped */
+void rsa_block_unpack(const struct rsa_block_codec_struct *codec, uint16_t *frame, size_t pixels, size_t block,
+                      const mpz_t value);
+
+/* stores value as encrypted block number block of words */
+void rsa_block_store(const struct rsa_block_codec_struct *codec, unsigned int *words, size_t block, const mpz_t value);
+
+/* loads encrypted block number block of words into value */
+void rsa_block_load(const struct rsa_block_codec_struct *codec, mpz_t value, const unsigned int *words, size_t block);
+
+#endif
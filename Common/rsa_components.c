@@ -0,0 +1,1328 @@
+/****************************************************************************************************************
+RSA components and per-frame encryption/decryption shared by the RSA tools, see rsa_components.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* other open source c libraries */
+#include <gmp.h>
+
+#include "cli_options.h"
+#include "frame_geometry.h"
+#include "gmp_arena.h"
+#include "rsa_components.h"
+#include "rsa_prime_search.h"
+#include "chacha20.h"
+
+#define RSA_NATIVE_BLOCK 256 // pixels widened to uint32_t per native kernel call
+#define RSA_KEY_HEADER "opir-rsa-key 1"
+#define RSA_KEY_VALUES 5
+
+static const char *const rsa_key_names[RSA_KEY_VALUES] = { "n", "e", "d", "p", "q" };
+
+/* mpz_t of one thread on the GMP backend, allocated once for the size of the key so the frame loops never grow them */
+struct rsa_gmp_scratch_struct {
+    mpz_t value; // pixel or block being exponentiated
+    mpz_t m_p; // residue modulo p with CRT
+    mpz_t m_q; // result, or residue modulo q with CRT
+    mpz_t powers[RSA_PLAN_MAX_POWERS]; // odd powers of rsa_exponent_plan_powm, only initialized when gmp_plan is set
+    const void *thread; // address of the owning thread's rsa_thread_scratch
+    struct rsa_gmp_scratch_struct *next; // next scratch of the same key
+};
+
+static unsigned long rsa_generations; // source of rsa_components_struct.generation
+
+/* scratch last used by this thread, valid while the key it was made for (generation) is alive */
+static __thread struct rsa_gmp_scratch_struct *rsa_thread_scratch;
+static __thread unsigned long rsa_thread_scratch_generation;
+
+/********************************************************
+Returns the scratch of the calling thread for the key in
+rsa_components, allocating it on the first call of the
+thread, or NULL if the key never exponentiates with GMP.
+Must be called outside gmp_arena regions, the scratch
+lives until rsa_free_components.
+********************************************************/
+static struct rsa_gmp_scratch_struct *rsa_gmp_scratch(struct rsa_components_struct *rsa_components)
+{
+    struct rsa_gmp_scratch_struct *scratch;
+
+    if (rsa_components->backend != RSA_BACKEND_GMP && rsa_components->codec.block_words == 1) {
+        return NULL;
+    }
+    if (rsa_thread_scratch != NULL && rsa_thread_scratch_generation == rsa_components->generation) {
+        return rsa_thread_scratch;
+    }
+
+    /* a thread that switched keys may already have scratch for this one */
+    for (scratch = __atomic_load_n(&rsa_components->gmp_scratch, __ATOMIC_ACQUIRE); scratch != NULL; scratch = scratch->next) {
+        if (scratch->thread == &rsa_thread_scratch) {
+            break;
+        }
+    }
+
+    if (scratch == NULL) {
+        /* products of two residues before reduction take up to twice the bits of n */
+        mp_bitcnt_t bits = 2 * (mpz_sizeinbase(rsa_components->n, 2) + GMP_NUMB_BITS);
+
+        scratch = (struct rsa_gmp_scratch_struct *) malloc(sizeof(struct rsa_gmp_scratch_struct));
+        if (scratch == NULL) {
+            printf("Memory could not be allocated for the GMP scratch\n");
+            exit(1);
+        }
+        mpz_init2(scratch->value, bits);
+        mpz_init2(scratch->m_p, bits);
+        mpz_init2(scratch->m_q, bits);
+        for (int k = 0; rsa_components->gmp_plan && k < RSA_PLAN_MAX_POWERS; k++) {
+            mpz_init2(scratch->powers[k], bits);
+        }
+        scratch->thread = &rsa_thread_scratch;
+
+        /* other threads may be adding theirs at the same time */
+        scratch->next = __atomic_load_n(&rsa_components->gmp_scratch, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&rsa_components->gmp_scratch, &scratch->next, scratch, 0, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED)) {
+        }
+    }
+
+    rsa_thread_scratch = scratch;
+    rsa_thread_scratch_generation = rsa_components->generation;
+
+    return scratch;
+}
+
+static void rsa_free_gmp_scratch(struct rsa_components_struct *rsa_components)
+{
+    struct rsa_gmp_scratch_struct *scratch = rsa_components->gmp_scratch;
+
+    while (scratch != NULL) {
+        struct rsa_gmp_scratch_struct *next = scratch->next;
+        mpz_clear(scratch->value);
+        mpz_clear(scratch->m_p);
+        mpz_clear(scratch->m_q);
+        for (int k = 0; rsa_components->gmp_plan && k < RSA_PLAN_MAX_POWERS; k++) {
+            mpz_clear(scratch->powers[k]);
+        }
+        free(scratch);
+        scratch = next;
+    }
+    rsa_components->gmp_scratch = NULL;
+
+    return;
+}
+
+/* rop = base^exponent mod modulus on the GMP backend, with the plan of exponent or mpz_powm */
+static inline void rsa_powm_gmp(const struct rsa_components_struct *rsa_components, mpz_t rop, const mpz_t base,
+                                const mpz_t exponent, const struct rsa_exponent_plan_struct *plan, const mpz_t modulus,
+                                mpz_t *powers)
+{
+    if (rsa_components->gmp_plan) {
+        rsa_exponent_plan_powm(rop, base, plan, modulus, powers);
+    }
+    else {
+        /* void mpz_powm (mpz_t rop, const mpz_t base, const mpz_t exp, const mpz_t mod) */
+        /* Set rop to (base raised to exp) modulo mod. */
+        mpz_powm(rop, base, exponent, modulus);
+    }
+
+    return;
+}
+
+/********************************************************
+Block encryption for moduli above 32 bits: every block of
+rsa_block_codec packs codec.block_pixels pixels and takes
+one exponentiation.
+********************************************************/
+static void rsa_encrypt_frame_blocks(const uint16_t *original_frame, size_t pixels,
+                                     const struct rsa_components_struct *rsa_components, unsigned int *encrypted_frame,
+                                     struct rsa_gmp_scratch_struct *scratch)
+{
+    const struct rsa_block_codec_struct *codec = &rsa_components->codec;
+    size_t blocks = rsa_block_codec_blocks(codec, pixels);
+
+    for (size_t b = 0; b < blocks; b++) {
+        rsa_block_pack(codec, scratch->value, original_frame, pixels, b);
+        rsa_powm_gmp(rsa_components, scratch->m_q, scratch->value, rsa_components->e, &rsa_components->plan_e,
+                     rsa_components->n, scratch->powers);
+        rsa_block_store(codec, encrypted_frame, b, scratch->m_q);
+    }
+
+    return;
+}
+
+/********************************************************
+This function performs encryption. It accepts a frame
+of size pixels and rsa parameters. Each uint16_t in the frame is
+ciphered using RSA algorithm. Stores output in
+encrypted_frame.
+********************************************************/
+static void rsa_encrypt_values(const uint16_t *original_frame, size_t pixels, const struct rsa_components_struct *rsa_components,
+                               unsigned int *encrypted_frame, struct rsa_gmp_scratch_struct *scratch)
+{
+    if (rsa_components->codec.block_words > 1) {
+        rsa_encrypt_frame_blocks(original_frame, pixels, rsa_components, encrypted_frame, scratch);
+        return;
+    }
+
+    if (rsa_components->encrypt_table != NULL) {
+        const unsigned int *table = rsa_components->encrypt_table;
+        for (size_t i = 0; i < pixels; i++) {
+            encrypted_frame[i] = table[original_frame[i]];
+        }
+        return;
+    }
+
+    if (rsa_components->backend == RSA_BACKEND_NATIVE) {
+        uint32_t base[RSA_NATIVE_BLOCK];
+
+        for (size_t start = 0; start < pixels; start += RSA_NATIVE_BLOCK) {
+            size_t count = (pixels - start < RSA_NATIVE_BLOCK) ? pixels - start : RSA_NATIVE_BLOCK;
+            for (size_t i = 0; i < count; i++) {
+                base[i] = original_frame[start + i];
+            }
+            rsa_components->kernels->powm_frame(&rsa_components->montgomery, base, count, &rsa_components->plan_e,
+                                                &encrypted_frame[start]);
+        }
+        return;
+    }
+
+    /* using gmp library to deal with very large numbers, in the scratch of this thread */
+    for (size_t i = 0; i < pixels; i++)
+    {
+        /* set gmp variables */
+        mpz_set_ui(scratch->value, (unsigned int ) original_frame[i]);
+
+        rsa_powm_gmp(rsa_components, scratch->m_q, scratch->value, rsa_components->e, &rsa_components->plan_e,
+                     rsa_components->n, scratch->powers);
+
+        /* convert back from mpz_t to uint16_t */
+        encrypted_frame[i] = (unsigned int) mpz_get_ui(scratch->m_q);
+
+        /* Debugging
+        if (i == 0) {
+            gmp_printf ("encrypted_pixel is an mpz %Zd\n", encrypted_pixel);
+            printf("\noriginal_frame[0] = %d\n", original_frame[i]);
+            printf("\nencrypted_frame[0] = %d\n", encrypted_frame[i]);
+        }
+        */
+    }
+
+    return;
+}
+
+/********************************************************
+Combines the residues m_p = c^d_p mod p and m_q = c^d_q
+mod q into c^d mod n (Garner): h = q_inverse * (m_p - m_q)
+mod p, m = m_q + h * q. Native backend, the result always
+fits in 32 bits since it is smaller than n.
+********************************************************/
+static inline uint32_t rsa_crt_combine_native(const struct rsa_components_struct *rsa_components, uint32_t m_p, uint32_t m_q)
+{
+    const struct rsa_montgomery_struct *montgomery_p = &rsa_components->montgomery_p;
+    uint32_t m_q_mod_p = m_q % montgomery_p->n;
+    uint32_t difference = (m_p >= m_q_mod_p) ? m_p - m_q_mod_p : m_p + (montgomery_p->n - m_q_mod_p);
+
+    /* q_inverse_native is in Montgomery form, so a single multiply returns the plain product */
+    uint32_t h = rsa_montgomery_multiply(montgomery_p, rsa_components->q_inverse_native, difference);
+
+    return m_q + h * rsa_components->montgomery_q.n;
+}
+
+/********************************************************
+CRT decryption on the native backend: two exponentiations
+with the half-length exponents d_p and d_q per pixel,
+a block of pixels at a time through the native kernels.
+********************************************************/
+static void rsa_decrypt_frame_native_crt(const unsigned int *encrypted_frame, size_t pixels,
+                                         const struct rsa_components_struct *rsa_components, uint16_t *decrypted_frame)
+{
+    uint32_t m_p[RSA_NATIVE_BLOCK];
+    uint32_t m_q[RSA_NATIVE_BLOCK];
+
+    for (size_t start = 0; start < pixels; start += RSA_NATIVE_BLOCK) {
+        size_t count = (pixels - start < RSA_NATIVE_BLOCK) ? pixels - start : RSA_NATIVE_BLOCK;
+        rsa_components->kernels->powm_frame(&rsa_components->montgomery_p, &encrypted_frame[start], count,
+                                            &rsa_components->plan_d_p, m_p);
+        rsa_components->kernels->powm_frame(&rsa_components->montgomery_q, &encrypted_frame[start], count,
+                                            &rsa_components->plan_d_q, m_q);
+        for (size_t i = 0; i < count; i++) {
+            decrypted_frame[start + i] = (uint16_t) rsa_crt_combine_native(rsa_components, m_p[i], m_q[i]);
+        }
+    }
+
+    return;
+}
+
+/* m_q = c^d mod n from m_p = c^d_p mod p and m_q = c^d_q mod q, same recombination as rsa_crt_combine_native */
+static inline void rsa_crt_combine_gmp(const struct rsa_components_struct *rsa_components, mpz_t m_p, mpz_t m_q)
+{
+    /* m = m_q + q * ((q_inverse * (m_p - m_q)) mod p) */
+    mpz_sub(m_p, m_p, m_q);
+    mpz_mul(m_p, m_p, rsa_components->q_inverse);
+    mpz_mod(m_p, m_p, rsa_components->p);
+    mpz_addmul(m_q, m_p, rsa_components->q);
+
+    return;
+}
+
+/********************************************************
+CRT decryption with GMP, two half-size exponentiations
+per pixel.
+********************************************************/
+static void rsa_decrypt_frame_gmp_crt(const unsigned int *encrypted_frame, size_t pixels,
+                                      const struct rsa_components_struct *rsa_components, uint16_t *decrypted_frame,
+                                      struct rsa_gmp_scratch_struct *scratch)
+{
+    for (size_t i = 0; i < pixels; i++) {
+        mpz_set_ui(scratch->value, (unsigned int) encrypted_frame[i]);
+
+        rsa_powm_gmp(rsa_components, scratch->m_p, scratch->value, rsa_components->d_p, &rsa_components->plan_d_p,
+                     rsa_components->p, scratch->powers);
+        rsa_powm_gmp(rsa_components, scratch->m_q, scratch->value, rsa_components->d_q, &rsa_components->plan_d_q,
+                     rsa_components->q, scratch->powers);
+        rsa_crt_combine_gmp(rsa_components, scratch->m_p, scratch->m_q);
+
+        decrypted_frame[i] = (uint16_t) mpz_get_ui(scratch->m_q);
+    }
+
+    return;
+}
+
+/********************************************************
+Deciphers every pixel by exponentiation with d, or with
+d_p and d_q when CRT is enabled.
+********************************************************/
+static void rsa_decrypt_frame_exponentiate(const unsigned int *encrypted_frame, size_t pixels,
+                                           const struct rsa_components_struct *rsa_components, uint16_t *decrypted_frame,
+                                           struct rsa_gmp_scratch_struct *scratch)
+{
+    if (rsa_components->crt) {
+        if (rsa_components->backend == RSA_BACKEND_NATIVE) {
+            rsa_decrypt_frame_native_crt(encrypted_frame, pixels, rsa_components, decrypted_frame);
+        }
+        else {
+            rsa_decrypt_frame_gmp_crt(encrypted_frame, pixels, rsa_components, decrypted_frame, scratch);
+        }
+        return;
+    }
+
+    if (rsa_components->backend == RSA_BACKEND_NATIVE) {
+        uint32_t result[RSA_NATIVE_BLOCK];
+
+        for (size_t start = 0; start < pixels; start += RSA_NATIVE_BLOCK) {
+            size_t count = (pixels - start < RSA_NATIVE_BLOCK) ? pixels - start : RSA_NATIVE_BLOCK;
+            rsa_components->kernels->powm_frame(&rsa_components->montgomery, &encrypted_frame[start], count,
+                                                &rsa_components->plan_d, result);
+            for (size_t i = 0; i < count; i++) {
+                decrypted_frame[start + i] = (uint16_t) result[i];
+            }
+        }
+        return;
+    }
+
+    /* using gmp library to deal with very large numbers, in the scratch of this thread */
+    for (size_t i = 0; i < pixels; i++)
+    {
+        /* set gmp variables */
+        mpz_set_ui(scratch->value, (unsigned int ) encrypted_frame[i]);
+
+        rsa_powm_gmp(rsa_components, scratch->m_q, scratch->value, rsa_components->d, &rsa_components->plan_d,
+                     rsa_components->n, scratch->powers);
+
+        /* convert back from mpz_t to uint16_t */
+        decrypted_frame[i] = (uint16_t) mpz_get_ui(scratch->m_q);
+
+        /* Debugging
+        if (i == 0) {
+            printf("\nencrypted_frame[0] = %d\n", encrypted_frame[i]);
+            printf("\nencrypted_frame[0] = %d\n", decrypted_frame[i]);
+        }
+        */
+    }
+
+    return;
+}
+
+/********************************************************
+Builds the exponentiation plans of e, d, d_p and d_q.
+--rsa-window=auto (default) picks the cheapest sliding
+window for each exponent, 1 to RSA_PLAN_MAX_WINDOW forces
+a size (1 is plain binary exponentiation). The native
+kernels always replay the plans. GMP replays them with
+--rsa-plan=on, by default it keeps mpz_powm, which runs
+its own windowed Montgomery exponentiation and is faster
+than replaying the plan with mpz_mul and mpz_mod.
+********************************************************/
+static void rsa_build_plans(struct rsa_components_struct *rsa_components)
+{
+    const char *window_option = cli_option("rsa-window");
+    const char *plan_option = cli_option("rsa-plan");
+    int window = 0;
+    char extra;
+
+    if (window_option != NULL && strcmp(window_option, "auto") != 0
+        && (sscanf(window_option, "%d%c", &window, &extra) != 1 || window < 1 || window > RSA_PLAN_MAX_WINDOW)) {
+        printf("\nError: Invalid window %s. Please use --rsa-window=auto or 1 to %d.\n", window_option, RSA_PLAN_MAX_WINDOW);
+        exit(1);
+    }
+    if (plan_option != NULL && strcmp(plan_option, "auto") != 0 && strcmp(plan_option, "on") != 0
+        && strcmp(plan_option, "off") != 0) {
+        printf("\nError: Invalid plan setting %s. Please use --rsa-plan=auto, on or off.\n", plan_option);
+        exit(1);
+    }
+    rsa_components->gmp_plan = plan_option != NULL && strcmp(plan_option, "on") == 0;
+
+    rsa_exponent_plan_init(&rsa_components->plan_e, rsa_components->e, window);
+    rsa_exponent_plan_init(&rsa_components->plan_d, rsa_components->d, window);
+    rsa_exponent_plan_init(&rsa_components->plan_d_p, rsa_components->d_p, window);
+    rsa_exponent_plan_init(&rsa_components->plan_d_q, rsa_components->d_q, window);
+
+    return;
+}
+
+/********************************************************
+--rsa-mode=direct (default) enciphers the frames with RSA,
+--rsa-mode=hybrid with ChaCha20 under a session key that
+the RSA key only wraps once per stream. The ChaCha20
+kernels (--chacha20-kernels) are verified like the
+Montgomery kernels before they touch a frame.
+********************************************************/
+static void rsa_select_mode(struct rsa_components_struct *rsa_components)
+{
+    const char *mode = cli_option("rsa-mode");
+
+    if (mode != NULL && strcmp(mode, "direct") != 0 && strcmp(mode, "hybrid") != 0) {
+        printf("\nError: Unknown RSA mode %s. Please use --rsa-mode=direct or hybrid.\n", mode);
+        exit(1);
+    }
+
+    rsa_components->hybrid = mode != NULL && strcmp(mode, "hybrid") == 0;
+    rsa_components->chacha20 = NULL;
+    memset(rsa_components->session_key, 0, sizeof(rsa_components->session_key));
+    memset(rsa_components->stream_id, 0, sizeof(rsa_components->stream_id));
+    if (!rsa_components->hybrid) {
+        return;
+    }
+
+    const char *kernels = cli_option("chacha20-kernels");
+    rsa_components->chacha20 = chacha20_select_kernels(kernels);
+    if (rsa_components->chacha20 == NULL) {
+        printf("\nError: ChaCha20 kernels %s are unknown or not supported by this cpu. Please use --chacha20-kernels=auto, avx2, sse2 or scalar.\n",
+               kernels);
+        exit(1);
+    }
+    if (chacha20_verify_kernels()) {
+        printf("\nError: ChaCha20 kernels do not match the reference.\n");
+        exit(1);
+    }
+
+    return;
+}
+
+/********************************************************
+Picks the arithmetic for the key in rsa_components: the
+native backend whenever n fits in 32 bits, GMP otherwise.
+--rsa-backend=gmp forces GMP, --rsa-backend=native exits
+with an error if the key is too large for it.
+********************************************************/
+static void rsa_select_backend(struct rsa_components_struct *rsa_components)
+{
+    const char *requested = cli_option("rsa-backend");
+    int fits = mpz_sizeinbase(rsa_components->n, 2) <= RSA_MONTGOMERY_MAX_BITS && mpz_odd_p(rsa_components->n);
+
+    if (requested != NULL && strcmp(requested, "auto") != 0 && strcmp(requested, "gmp") != 0
+        && strcmp(requested, "native") != 0) {
+        printf("\nError: Unknown RSA backend %s. Please use --rsa-backend=auto, gmp or native.\n", requested);
+        exit(1);
+    }
+    if (requested != NULL && strcmp(requested, "native") == 0 && !fits) {
+        printf("\nError: The native RSA backend needs an odd modulus of at most %d bits.\n", RSA_MONTGOMERY_MAX_BITS);
+        exit(1);
+    }
+
+    rsa_components->backend = RSA_BACKEND_GMP;
+    rsa_components->kernels = NULL;
+    if (fits && (requested == NULL || strcmp(requested, "gmp") != 0)) {
+        rsa_montgomery_init(&rsa_components->montgomery, (uint32_t) mpz_get_ui(rsa_components->n));
+        rsa_components->e_native = mpz_get_ui(rsa_components->e);
+        rsa_components->d_native = mpz_get_ui(rsa_components->d);
+
+        /* p and q are odd primes below n, so they always have Montgomery forms of their own */
+        rsa_montgomery_init(&rsa_components->montgomery_p, (uint32_t) mpz_get_ui(rsa_components->p));
+        rsa_montgomery_init(&rsa_components->montgomery_q, (uint32_t) mpz_get_ui(rsa_components->q));
+        rsa_components->d_p_native = mpz_get_ui(rsa_components->d_p);
+        rsa_components->d_q_native = mpz_get_ui(rsa_components->d_q);
+        rsa_components->q_inverse_native = rsa_montgomery_multiply(&rsa_components->montgomery_p,
+                                                                   (uint32_t) mpz_get_ui(rsa_components->q_inverse),
+                                                                   rsa_components->montgomery_p.r_squared);
+        rsa_components->backend = RSA_BACKEND_NATIVE;
+
+        /* vector kernels are checked against the scalar reference for this key before they touch a frame */
+        const char *kernels = cli_option("rsa-kernels");
+        rsa_components->kernels = rsa_montgomery_select_kernels(kernels);
+        if (rsa_components->kernels == NULL) {
+            printf("\nError: RSA kernels %s are unknown or not supported by this cpu. Please use --rsa-kernels=auto, avx2 or scalar.\n",
+                   kernels);
+            exit(1);
+        }
+        if (rsa_montgomery_verify_kernels(&rsa_components->montgomery, rsa_components->e_native, &rsa_components->plan_e)
+            || rsa_montgomery_verify_kernels(&rsa_components->montgomery, rsa_components->d_native, &rsa_components->plan_d)
+            || rsa_montgomery_verify_kernels(&rsa_components->montgomery_p, rsa_components->d_p_native,
+                                             &rsa_components->plan_d_p)
+            || rsa_montgomery_verify_kernels(&rsa_components->montgomery_q, rsa_components->d_q_native,
+                                             &rsa_components->plan_d_q)) {
+            printf("\nError: RSA kernels do not match the scalar reference.\n");
+            exit(1);
+        }
+    }
+
+    return;
+}
+
+/* returns the plaintext of ciphertext from the reverse index, or -1 if it is not the ciphertext of any pixel value */
+static inline int rsa_decrypt_index_lookup(const struct rsa_decrypt_index_struct *index, unsigned int ciphertext)
+{
+    uint32_t bucket = ciphertext >> index->shift;
+
+    if (bucket >= (1u << RSA_INDEX_BUCKET_BITS)) {
+        return -1;
+    }
+    for (uint32_t i = index->buckets[bucket]; i < index->buckets[bucket + 1]; i++) {
+        if (index->ciphertexts[i] == ciphertext) {
+            return index->plaintexts[i];
+        }
+    }
+
+    return -1;
+}
+
+/********************************************************
+Block decryption for moduli above 32 bits, the inverse of
+rsa_encrypt_frame_blocks. Uses CRT when it is enabled.
+********************************************************/
+static void rsa_decrypt_frame_blocks(const unsigned int *encrypted_frame, size_t pixels,
+                                     const struct rsa_components_struct *rsa_components, uint16_t *decrypted_frame,
+                                     struct rsa_gmp_scratch_struct *scratch)
+{
+    const struct rsa_block_codec_struct *codec = &rsa_components->codec;
+    size_t blocks = rsa_block_codec_blocks(codec, pixels);
+
+    for (size_t b = 0; b < blocks; b++) {
+        rsa_block_load(codec, scratch->value, encrypted_frame, b);
+        if (rsa_components->crt) {
+            rsa_powm_gmp(rsa_components, scratch->m_p, scratch->value, rsa_components->d_p, &rsa_components->plan_d_p,
+                         rsa_components->p, scratch->powers);
+            rsa_powm_gmp(rsa_components, scratch->m_q, scratch->value, rsa_components->d_q, &rsa_components->plan_d_q,
+                         rsa_components->q, scratch->powers);
+            rsa_crt_combine_gmp(rsa_components, scratch->m_p, scratch->m_q);
+        }
+        else {
+            rsa_powm_gmp(rsa_components, scratch->m_q, scratch->value, rsa_components->d, &rsa_components->plan_d,
+                         rsa_components->n, scratch->powers);
+        }
+        rsa_block_unpack(codec, decrypted_frame, pixels, b, scratch->m_q);
+    }
+
+    return;
+}
+
+/********************************************************
+This function performs decryption. It accepts a frame
+of size pixels and rsa parameters. Each uint16_t in the frame is
+deciphered using RSA algorithm, through the decryption
+index when there is one. Stores output in
+decrypted_frame.
+********************************************************/
+static void rsa_decrypt_values(const unsigned int *encrypted_frame, size_t pixels,
+                               const struct rsa_components_struct *rsa_components, uint16_t *decrypted_frame,
+                               struct rsa_gmp_scratch_struct *scratch)
+{
+    const struct rsa_decrypt_index_struct *index = rsa_components->decrypt_index;
+
+    if (rsa_components->codec.block_words > 1) {
+        rsa_decrypt_frame_blocks(encrypted_frame, pixels, rsa_components, decrypted_frame, scratch);
+        return;
+    }
+    if (index == NULL) {
+        rsa_decrypt_frame_exponentiate(encrypted_frame, pixels, rsa_components, decrypted_frame, scratch);
+        return;
+    }
+
+    for (size_t i = 0; i < pixels; i++) {
+        int plaintext = rsa_decrypt_index_lookup(index, encrypted_frame[i]);
+        if (plaintext >= 0) {
+            decrypted_frame[i] = (uint16_t) plaintext;
+        }
+        else {
+            /* not produced by rsa_encrypt_frame (corrupted input), decipher it the slow way like any other value */
+            rsa_decrypt_frame_exponentiate(&encrypted_frame[i], 1, rsa_components, &decrypted_frame[i], scratch);
+        }
+    }
+
+    return;
+}
+
+/* ChaCha20 state of frame number frame from keystream block counter on: the session key, and the stream id and frame number as nonce */
+static void rsa_hybrid_state(const struct rsa_components_struct *rsa_components, uint64_t frame, uint32_t counter,
+                             uint32_t state[CHACHA20_STATE_WORDS])
+{
+    uint8_t nonce[CHACHA20_NONCE_BYTES];
+
+    memcpy(nonce, rsa_components->stream_id, RSA_STREAM_ID_BYTES);
+    for (int i = 0; i < 8; i++) {
+        nonce[RSA_STREAM_ID_BYTES + i] = (uint8_t) (frame >> (8 * i));
+    }
+    chacha20_init_state(state, rsa_components->session_key, nonce, counter);
+
+    return;
+}
+
+size_t rsa_frame_part_pixels(const struct rsa_components_struct *rsa_components)
+{
+    if (rsa_components->hybrid) {
+        return CHACHA20_BLOCK_BYTES / sizeof(uint16_t);
+    }
+
+    return rsa_components->codec.block_pixels;
+}
+
+void rsa_encrypt_frame_part(const uint16_t *original_frame, size_t pixels, size_t first, size_t count, uint64_t frame,
+                            struct rsa_components_struct *rsa_components, unsigned int *encrypted_frame)
+{
+    /* first is a multiple of rsa_frame_part_pixels, so the part starts on a word (and block) of its own */
+    size_t offset = rsa_encrypted_frame_words(rsa_components, first);
+
+    if (rsa_components->hybrid) {
+        uint32_t state[CHACHA20_STATE_WORDS];
+        rsa_hybrid_state(rsa_components, frame, (uint32_t) (first * sizeof(uint16_t) / CHACHA20_BLOCK_BYTES), state);
+
+        /* the last word of a frame with an odd pixel count is half padding */
+        if (first + count == pixels) {
+            encrypted_frame[rsa_encrypted_frame_words(rsa_components, pixels) - 1] = 0;
+        }
+        rsa_components->chacha20->xor_stream(state, (const uint8_t *) &original_frame[first],
+                                             (uint8_t *) &encrypted_frame[offset], count * sizeof(uint16_t));
+        return;
+    }
+
+    /* a pixel above the depth has no entry in the encryption table and would spill into the next pixel of a block */
+    frame_geometry_check_pixels(&original_frame[first], count, rsa_components->depth);
+
+    /* the scratch is allocated before the arena region, every other GMP allocation of the part falls inside it */
+    struct rsa_gmp_scratch_struct *scratch = rsa_gmp_scratch(rsa_components);
+    if (scratch == NULL) {
+        rsa_encrypt_values(&original_frame[first], count, rsa_components, &encrypted_frame[offset], NULL);
+        return;
+    }
+    gmp_arena_begin();
+    rsa_encrypt_values(&original_frame[first], count, rsa_components, &encrypted_frame[offset], scratch);
+    gmp_arena_end();
+
+    return;
+}
+
+void rsa_decrypt_frame_part(const unsigned int *encrypted_frame, size_t pixels, size_t first, size_t count, uint64_t frame,
+                            struct rsa_components_struct *rsa_components, uint16_t *decrypted_frame)
+{
+    size_t offset = rsa_encrypted_frame_words(rsa_components, first);
+
+    /* unlike encryption, the last part needs no padding: the half padding word of an odd pixel count is not read */
+    (void) pixels;
+
+    if (rsa_components->hybrid) {
+        uint32_t state[CHACHA20_STATE_WORDS];
+        rsa_hybrid_state(rsa_components, frame, (uint32_t) (first * sizeof(uint16_t) / CHACHA20_BLOCK_BYTES), state);
+        rsa_components->chacha20->xor_stream(state, (const uint8_t *) &encrypted_frame[offset],
+                                             (uint8_t *) &decrypted_frame[first], count * sizeof(uint16_t));
+        return;
+    }
+
+    struct rsa_gmp_scratch_struct *scratch = rsa_gmp_scratch(rsa_components);
+    if (scratch == NULL) {
+        rsa_decrypt_values(&encrypted_frame[offset], count, rsa_components, &decrypted_frame[first], NULL);
+        return;
+    }
+    gmp_arena_begin();
+    rsa_decrypt_values(&encrypted_frame[offset], count, rsa_components, &decrypted_frame[first], scratch);
+    gmp_arena_end();
+
+    return;
+}
+
+void rsa_encrypt_frame(const uint16_t *original_frame, size_t pixels, uint64_t frame, struct rsa_components_struct *rsa_components,
+                       unsigned int *encrypted_frame)
+{
+    rsa_encrypt_frame_part(original_frame, pixels, 0, pixels, frame, rsa_components, encrypted_frame);
+
+    return;
+}
+
+void rsa_decrypt_frame(const unsigned int *encrypted_frame, size_t pixels, uint64_t frame, struct rsa_components_struct *rsa_components,
+                       uint16_t *decrypted_frame)
+{
+    rsa_decrypt_frame_part(encrypted_frame, pixels, 0, pixels, frame, rsa_components, decrypted_frame);
+
+    return;
+}
+
+/* fills bytes with random bytes from /dev/urandom, exits with an error if it cannot be read */
+static void rsa_random_bytes(uint8_t *bytes, size_t count)
+{
+    FILE *urandom = fopen("/dev/urandom", "rb");
+
+    if (urandom == NULL || fread(bytes, 1, count, urandom) != count) {
+        printf("\nError: Could not read /dev/urandom for the session key.\n");
+        exit(1);
+    }
+    fclose(urandom);
+
+    return;
+}
+
+size_t rsa_stream_header_words(const struct rsa_components_struct *rsa_components)
+{
+    if (!rsa_components->hybrid) {
+        return 0;
+    }
+
+    return rsa_block_codec_words(&rsa_components->codec, RSA_SESSION_VALUES);
+}
+
+/********************************************************
+Hybrid mode: draws a fresh session key and stream id and
+wraps them with the RSA key into the stream header, as
+RSA_SESSION_VALUES 16-bit values enciphered like a frame.
+********************************************************/
+void rsa_begin_stream(struct rsa_components_struct *rsa_components, unsigned int *header)
+{
+    uint8_t session[2 * RSA_SESSION_VALUES];
+    uint16_t values[RSA_SESSION_VALUES];
+
+    if (!rsa_components->hybrid) {
+        return;
+    }
+
+    rsa_random_bytes(session, sizeof(session));
+    memcpy(rsa_components->session_key, session, CHACHA20_KEY_BYTES);
+    memcpy(rsa_components->stream_id, &session[CHACHA20_KEY_BYTES], RSA_STREAM_ID_BYTES);
+    for (int i = 0; i < RSA_SESSION_VALUES; i++) {
+        values[i] = (uint16_t) (session[2 * i] | (session[2 * i + 1] << 8));
+    }
+    rsa_encrypt_values(values, RSA_SESSION_VALUES, rsa_components, header, rsa_gmp_scratch(rsa_components));
+
+    return;
+}
+
+void rsa_open_stream(struct rsa_components_struct *rsa_components, const unsigned int *header)
+{
+    uint8_t session[2 * RSA_SESSION_VALUES];
+    uint16_t values[RSA_SESSION_VALUES];
+
+    if (!rsa_components->hybrid) {
+        return;
+    }
+
+    rsa_decrypt_values(header, RSA_SESSION_VALUES, rsa_components, values, rsa_gmp_scratch(rsa_components));
+    for (int i = 0; i < RSA_SESSION_VALUES; i++) {
+        session[2 * i] = (uint8_t) values[i];
+        session[2 * i + 1] = (uint8_t) (values[i] >> 8);
+    }
+    memcpy(rsa_components->session_key, session, CHACHA20_KEY_BYTES);
+    memcpy(rsa_components->stream_id, &session[CHACHA20_KEY_BYTES], RSA_STREAM_ID_BYTES);
+
+    return;
+}
+
+/********************************************************
+Stores the ciphertext of every plaintext pixel value in
+table, using the selected backend. Runs in parallel when
+the tool is built with OpenMP.
+********************************************************/
+static void rsa_encrypt_plaintext_values(struct rsa_components_struct *rsa_components, unsigned int *table)
+{
+    uint16_t *plaintexts = (uint16_t*)malloc(sizeof(uint16_t)*rsa_components->plaintext_values);
+    if (plaintexts == NULL) {
+        printf("Memory could not be allocated for the RSA plaintext values\n");
+        exit(1);
+    }
+    for (int i = 0; i < rsa_components->plaintext_values; i++) {
+        plaintexts[i] = (uint16_t) i;
+    }
+
+    /* encrypted like a frame of all plaintext values, in chunks so threads can share the work */
+    const int chunk = 1024;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int start = 0; start < rsa_components->plaintext_values; start += chunk) {
+        int count = (rsa_components->plaintext_values - start < chunk) ? rsa_components->plaintext_values - start : chunk;
+        rsa_encrypt_values(&plaintexts[start], (size_t) count, rsa_components, &table[start], rsa_gmp_scratch(rsa_components));
+    }
+
+    free(plaintexts);
+
+    return;
+}
+
+/********************************************************
+Builds the ciphertext of every plaintext pixel value with
+the selected backend. Only done when a ciphertext fits in the
+unsigned int of the encrypted frames, which is the case
+for n of at most 32 bits. --rsa-encrypt-table=off keeps
+per-pixel exponentiation.
+********************************************************/
+static void rsa_build_encrypt_table(struct rsa_components_struct *rsa_components)
+{
+    const char *requested = cli_option("rsa-encrypt-table");
+
+    if (requested != NULL && strcmp(requested, "on") != 0 && strcmp(requested, "off") != 0) {
+        printf("\nError: Invalid encryption table setting %s. Please use --rsa-encrypt-table=on or off.\n", requested);
+        exit(1);
+    }
+
+    rsa_components->encrypt_table = NULL;
+    if ((requested != NULL && strcmp(requested, "off") == 0) || mpz_sizeinbase(rsa_components->n, 2) > 32
+        || rsa_components->hybrid) {
+        return;
+    }
+
+    unsigned int *table = (unsigned int*)malloc(sizeof(unsigned int)*rsa_components->plaintext_values);
+    if (table == NULL) {
+        printf("Memory could not be allocated for the RSA encryption table\n");
+        exit(1);
+    }
+    rsa_encrypt_plaintext_values(rsa_components, table);
+    rsa_components->encrypt_table = table;
+
+    return;
+}
+
+static int rsa_compare_index_entries(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/********************************************************
+Builds the ciphertext to plaintext index: the ciphertexts
+of all plaintext values sorted, plus a directory of
+2^RSA_INDEX_BUCKET_BITS buckets on their top bits so a
+lookup scans a handful of entries. The index is checked
+once against mpz_powm with d before it is used, exits
+with an error if any entry disagrees. Only built when n
+has at most 32 bits, --rsa-decrypt-index=off keeps
+per-pixel exponentiation.
+********************************************************/
+static void rsa_build_decrypt_index(struct rsa_components_struct *rsa_components)
+{
+    const char *requested = cli_option("rsa-decrypt-index");
+
+    if (requested != NULL && strcmp(requested, "on") != 0 && strcmp(requested, "off") != 0) {
+        printf("\nError: Invalid decryption index setting %s. Please use --rsa-decrypt-index=on or off.\n", requested);
+        exit(1);
+    }
+
+    rsa_components->decrypt_index = NULL;
+    int bits = (int) mpz_sizeinbase(rsa_components->n, 2);
+    if ((requested != NULL && strcmp(requested, "off") == 0) || bits > 32 || rsa_components->hybrid) {
+        return;
+    }
+
+    struct rsa_decrypt_index_struct *index = (struct rsa_decrypt_index_struct*)malloc(sizeof(struct rsa_decrypt_index_struct));
+    uint64_t *entries = (uint64_t*)malloc(sizeof(uint64_t)*rsa_components->plaintext_values);
+    unsigned int *table = rsa_components->encrypt_table;
+    if (table == NULL) {
+        table = (unsigned int*)malloc(sizeof(unsigned int)*rsa_components->plaintext_values);
+    }
+    if (index == NULL || entries == NULL || table == NULL) {
+        printf("Memory could not be allocated for the RSA decryption index\n");
+        exit(1);
+    }
+    index->ciphertexts = (unsigned int*)malloc(sizeof(unsigned int)*rsa_components->plaintext_values);
+    index->plaintexts = (uint16_t*)malloc(sizeof(uint16_t)*rsa_components->plaintext_values);
+    index->buckets = (uint32_t*)malloc(sizeof(uint32_t)*((1 << RSA_INDEX_BUCKET_BITS) + 1));
+    if (index->ciphertexts == NULL || index->plaintexts == NULL || index->buckets == NULL) {
+        printf("Memory could not be allocated for the RSA decryption index\n");
+        exit(1);
+    }
+    if (table != rsa_components->encrypt_table) {
+        rsa_encrypt_plaintext_values(rsa_components, table);
+    }
+
+    /* sort (ciphertext, plaintext) pairs packed into one key */
+    for (int i = 0; i < rsa_components->plaintext_values; i++) {
+        entries[i] = ((uint64_t) table[i] << 16) | (uint64_t) i;
+    }
+    qsort(entries, rsa_components->plaintext_values, sizeof(uint64_t), rsa_compare_index_entries);
+
+    index->shift = (bits > RSA_INDEX_BUCKET_BITS) ? bits - RSA_INDEX_BUCKET_BITS : 0;
+    int bucket = 0;
+    for (int i = 0; i < rsa_components->plaintext_values; i++) {
+        index->ciphertexts[i] = (unsigned int) (entries[i] >> 16);
+        index->plaintexts[i] = (uint16_t) entries[i];
+        while (bucket <= (int) (index->ciphertexts[i] >> index->shift)) {
+            index->buckets[bucket++] = i;
+        }
+    }
+    while (bucket <= (1 << RSA_INDEX_BUCKET_BITS)) {
+        index->buckets[bucket++] = rsa_components->plaintext_values;
+    }
+
+    /* check every entry against the reference mpz_powm decryption */
+    int mismatches = 0;
+    #ifdef _OPENMP
+    #pragma omp parallel reduction(+:mismatches)
+    #endif
+    {
+        mpz_t base;
+        mpz_t plaintext;
+        mpz_init(base);
+        mpz_init(plaintext);
+
+        #ifdef _OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for (int i = 0; i < rsa_components->plaintext_values; i++) {
+            mpz_set_ui(base, index->ciphertexts[i]);
+            mpz_powm(plaintext, base, rsa_components->d, rsa_components->n);
+            mismatches += mpz_cmp_ui(plaintext, index->plaintexts[i]) != 0;
+        }
+
+        mpz_clear(base);
+        mpz_clear(plaintext);
+    }
+    if (mismatches > 0) {
+        printf("\nError: %d entries of the RSA decryption index do not match mpz_powm.\n", mismatches);
+        exit(1);
+    }
+
+    free(entries);
+    if (table != rsa_components->encrypt_table) {
+        free(table);
+    }
+    rsa_components->decrypt_index = index;
+
+    return;
+}
+
+/********************************************************
+Key file format shared by all RSA tools: a header line
+followed by one "name hex-value" line for n, e, d, p and q.
+********************************************************/
+char *rsa_format_key(const struct rsa_components_struct *rsa_components)
+{
+    const mpz_srcptr values[] = { rsa_components->n, rsa_components->e, rsa_components->d, rsa_components->p,
+                                  rsa_components->q };
+    size_t length = strlen(RSA_KEY_HEADER) + 2;
+
+    for (int k = 0; k < RSA_KEY_VALUES; k++) {
+        length += strlen(rsa_key_names[k]) + mpz_sizeinbase(values[k], 16) + 3;
+    }
+
+    char *key_text = (char*)malloc(length);
+    if (key_text == NULL) {
+        printf("Memory could not be allocated for the RSA key\n");
+        exit(1);
+    }
+    size_t used = (size_t) sprintf(key_text, "%s\n", RSA_KEY_HEADER);
+    for (int k = 0; k < RSA_KEY_VALUES; k++) {
+        used += (size_t) gmp_sprintf(key_text + used, "%s %Zx\n", rsa_key_names[k], values[k]);
+    }
+
+    return key_text;
+}
+
+/********************************************************
+Reads n, e, d, p and q from key_text into rsa_components.
+Returns 0 on success, -1 if a value is missing or the
+values do not form an RSA key.
+********************************************************/
+static int rsa_parse_key(struct rsa_components_struct *rsa_components, const char *key_text)
+{
+    mpz_ptr values[] = { rsa_components->n, rsa_components->e, rsa_components->d, rsa_components->p,
+                         rsa_components->q };
+    int seen[RSA_KEY_VALUES] = { 0 };
+    size_t header = strlen(RSA_KEY_HEADER);
+
+    if (strncmp(key_text, RSA_KEY_HEADER, header) != 0 || (key_text[header] != '\n' && key_text[header] != '\r')) {
+        return -1;
+    }
+
+    char *copy = (char*)malloc(strlen(key_text) + 1);
+    if (copy == NULL) {
+        printf("Memory could not be allocated for the RSA key\n");
+        exit(1);
+    }
+    strcpy(copy, key_text);
+
+    /* one "name value" pair per line */
+    char *line = strchr(copy, '\n');
+    while (line != NULL) {
+        line++;
+        char *next = strchr(line, '\n');
+        if (next != NULL) {
+            *next = '\0';
+        }
+        line[strcspn(line, "\r")] = '\0';
+
+        char *value = strchr(line, ' ');
+        if (value != NULL) {
+            *value++ = '\0';
+            for (int k = 0; k < RSA_KEY_VALUES; k++) {
+                if (strcmp(line, rsa_key_names[k]) == 0 && mpz_set_str(values[k], value, 16) == 0) {
+                    seen[k] = 1;
+                }
+            }
+        }
+        line = next;
+    }
+    free(copy);
+
+    for (int k = 0; k < RSA_KEY_VALUES; k++) {
+        if (!seen[k]) {
+            return -1;
+        }
+    }
+
+    /* n = p * q of at least RSA_KEY_MIN_BITS bits with distinct primes p and q, and e * d = 1 modulo
+       lcm(p - 1, q - 1) */
+    mpz_t check;
+    mpz_t lambda;
+    mpz_init(check);
+    mpz_init(lambda);
+    mpz_mul(check, rsa_components->p, rsa_components->q);
+    int valid = mpz_cmp(check, rsa_components->n) == 0 && mpz_sizeinbase(rsa_components->n, 2) >= RSA_KEY_MIN_BITS
+                && mpz_cmp_ui(rsa_components->p, 2) > 0 && mpz_cmp_ui(rsa_components->q, 2) > 0
+                && mpz_cmp(rsa_components->p, rsa_components->q) != 0
+                && mpz_probab_prime_p(rsa_components->p, RSA_PRIME_REPS) > 0
+                && mpz_probab_prime_p(rsa_components->q, RSA_PRIME_REPS) > 0;
+    if (valid) {
+        mpz_sub_ui(check, rsa_components->p, 1);
+        mpz_sub_ui(lambda, rsa_components->q, 1);
+        mpz_lcm(lambda, check, lambda);
+        mpz_mul(check, rsa_components->e, rsa_components->d);
+        mpz_mod(check, check, lambda);
+        valid = mpz_cmp_ui(check, 1) == 0;
+    }
+    mpz_clear(check);
+    mpz_clear(lambda);
+
+    return valid ? 0 : -1;
+}
+
+/********************************************************
+Reads the key file written by --rsa-key-out until its end
+into a buffer that doubles when full, so the key can also
+come from a pipe (--rsa-key=/dev/stdin), where the size
+is not known in advance.
+********************************************************/
+static void rsa_read_key_file(struct rsa_components_struct *rsa_components, const char *path)
+{
+    FILE *key_f = fopen(path, "rb");
+    if (key_f == NULL) {
+        printf("\nError: Could not open RSA key file %s.\n", path);
+        exit(1);
+    }
+
+    size_t capacity = RSA_KEY_FILE_BYTES;
+    size_t length = 0;
+    char *key_text = (char*)malloc(capacity);
+    for (;;) {
+        if (key_text == NULL) {
+            printf("Memory could not be allocated for the RSA key\n");
+            exit(1);
+        }
+        length += fread(&key_text[length], 1, capacity - 1 - length, key_f);
+        if (length < capacity - 1) {
+            break;
+        }
+        capacity *= 2;
+        key_text = (char*)realloc(key_text, capacity);
+    }
+    if (ferror(key_f)) {
+        printf("\nError: Could not read RSA key file %s.\n", path);
+        exit(1);
+    }
+    key_text[length] = '\0';
+    fclose(key_f);
+
+    if (rsa_parse_key(rsa_components, key_text)) {
+        printf("\nError: %s is not a valid RSA key file.\n", path);
+        exit(1);
+    }
+    free(key_text);
+
+    return;
+}
+
+static void rsa_write_key_file(const struct rsa_components_struct *rsa_components, const char *path)
+{
+    FILE *key_f = fopen(path, "wb");
+    if (key_f == NULL) {
+        printf("\nError: Could not create RSA key file %s.\n", path);
+        exit(1);
+    }
+    char *key_text = rsa_format_key(rsa_components);
+    fputs(key_text, key_f);
+    free(key_text);
+    fclose(key_f);
+
+    return;
+}
+
+/********************************************************
+Generates a key with a modulus of exactly bits bits:
+e = 65537, two random primes of half the size each found
+by rsa_random_prime, and d = e^-1 mod phi.
+********************************************************/
+static void rsa_generate_key(struct rsa_components_struct *rsa_components, unsigned int bits)
+{
+    mpz_set_ui(rsa_components->e, RSA_KEY_EXPONENT);
+    rsa_random_prime(rsa_components->p, bits - bits / 2, rsa_components->e);
+    do {
+        rsa_random_prime(rsa_components->q, bits / 2, rsa_components->e);
+    } while (mpz_cmp(rsa_components->p, rsa_components->q) == 0);
+
+    mpz_sub_ui(rsa_components->p_minus_1, rsa_components->p, 1);
+    mpz_sub_ui(rsa_components->q_minus_1, rsa_components->q, 1);
+    mpz_mul(rsa_components->phi, rsa_components->p_minus_1, rsa_components->q_minus_1);
+    mpz_invert(rsa_components->d, rsa_components->e, rsa_components->phi);
+
+    return;
+}
+
+/* initializes the key values of rsa_components */
+static void rsa_init_components(struct rsa_components_struct *rsa_components)
+{
+    mpz_init(rsa_components->p);
+    mpz_init(rsa_components->q);
+    mpz_init(rsa_components->p_minus_1);
+    mpz_init(rsa_components->q_minus_1);
+    mpz_init(rsa_components->n);
+    mpz_init(rsa_components->phi);
+    mpz_init(rsa_components->e);
+    mpz_init(rsa_components->d);
+    mpz_init(rsa_components->d_p);
+    mpz_init(rsa_components->d_q);
+    mpz_init(rsa_components->q_inverse);
+
+    rsa_components->generation = __atomic_add_fetch(&rsa_generations, 1, __ATOMIC_RELAXED);
+    rsa_components->gmp_scratch = NULL;
+
+    return;
+}
+
+/********************************************************
+Installs the per-thread GMP arenas (gmp_arena.h) when the
+key exponentiates with GMP, so the frame loops make no
+heap calls. --rsa-gmp-arena=off leaves GMP on malloc.
+********************************************************/
+static void rsa_select_gmp_arena(struct rsa_components_struct *rsa_components)
+{
+    const char *requested = cli_option("rsa-gmp-arena");
+
+    if (requested != NULL && strcmp(requested, "on") != 0 && strcmp(requested, "off") != 0) {
+        printf("\nError: Invalid GMP arena setting %s. Please use --rsa-gmp-arena=on or off.\n", requested);
+        exit(1);
+    }
+
+    rsa_components->gmp_arena = (requested == NULL || strcmp(requested, "on") == 0) && !rsa_components->hybrid
+                                && (rsa_components->backend == RSA_BACKEND_GMP || rsa_components->codec.block_words > 1);
+    if (rsa_components->gmp_arena) {
+        gmp_arena_install();
+    }
+
+    return;
+}
+
+/********************************************************
+Derives everything else from p, q, e and d: phi, the CRT
+components, the exponentiation plans, the backend and the
+lookup tables.
+********************************************************/
+static void rsa_prepare_components(struct rsa_components_struct *rsa_components)
+{
+    mpz_mul(rsa_components->n, rsa_components->p, rsa_components->q);
+    mpz_sub_ui(rsa_components->p_minus_1, rsa_components->p, 1);
+    mpz_sub_ui(rsa_components->q_minus_1, rsa_components->q, 1);
+    mpz_mul(rsa_components->phi, rsa_components->p_minus_1, rsa_components->q_minus_1);
+
+    /* precompute the CRT exponents and recombination coefficient */
+    mpz_mod(rsa_components->d_p, rsa_components->d, rsa_components->p_minus_1);
+    mpz_mod(rsa_components->d_q, rsa_components->d, rsa_components->q_minus_1);
+    mpz_invert(rsa_components->q_inverse, rsa_components->q, rsa_components->p);
+
+    /*
+        CRT trades one exponentiation for two with half-length exponents on half-size moduli. That pays off
+        (about 3-4x) once n spans several limbs, while for a single-limb n the operands get no cheaper and the
+        second exponentiation costs more than it saves. --rsa-crt=auto, the default, follows that rule.
+    */
+    const char *crt = cli_option("rsa-crt");
+    if (crt != NULL && strcmp(crt, "auto") != 0 && strcmp(crt, "on") != 0 && strcmp(crt, "off") != 0) {
+        printf("\nError: Invalid CRT setting %s. Please use --rsa-crt=auto, on or off.\n", crt);
+        exit(1);
+    }
+    if (crt == NULL || strcmp(crt, "auto") == 0) {
+        rsa_components->crt = mpz_size(rsa_components->n) > 1;
+    }
+    else {
+        rsa_components->crt = strcmp(crt, "on") == 0;
+    }
+
+    rsa_build_plans(rsa_components);
+    rsa_select_backend(rsa_components);
+    rsa_select_mode(rsa_components);
+
+    /* hybrid frames are ChaCha20 bytes, the only RSA plaintexts are the 16-bit session values */
+    if (rsa_components->hybrid) {
+        rsa_components->depth = RSA_MAX_DEPTH;
+    }
+    rsa_components->plaintext_values = 1 << rsa_components->depth;
+    rsa_block_codec_init(&rsa_components->codec, rsa_components->n, rsa_components->depth);
+
+    rsa_select_gmp_arena(rsa_components);
+    rsa_build_encrypt_table(rsa_components);
+    rsa_build_decrypt_index(rsa_components);
+
+    return;
+}
+
+/********************************************************
+Used to generate rsa components needed for encryption
+and decryption. Stores output in rsa_components.
+********************************************************/
+void rsa_generate_components(struct rsa_components_struct *rsa_components, int depth) {
+    const char *key_path = cli_option("rsa-key");
+    const char *key_out_path = cli_option("rsa-key-out");
+    const char *bits_option = cli_option("rsa-bits");
+
+    rsa_init_components(rsa_components);
+    rsa_components->depth = depth;
+
+    if (key_path != NULL && bits_option != NULL) {
+        printf("\nError: --rsa-key and --rsa-bits exclude each other.\n");
+        exit(1);
+    }
+    if (key_path != NULL) {
+        rsa_read_key_file(rsa_components, key_path);
+    }
+    else if (bits_option != NULL) {
+        unsigned int bits;
+        char extra;
+        if (sscanf(bits_option, "%u%c", &bits, &extra) != 1 || bits < RSA_KEY_MIN_BITS || bits > RSA_KEY_MAX_BITS) {
+            printf("\nError: Invalid key size %s. Please use --rsa-bits=%d to %d.\n", bits_option, RSA_KEY_MIN_BITS,
+                   RSA_KEY_MAX_BITS);
+            exit(1);
+        }
+        rsa_generate_key(rsa_components, bits);
+    }
+    else {
+        /* for testing purposes the default key is assigned statically */
+        mpz_set_ui(rsa_components->p, 52223);
+        mpz_set_ui(rsa_components->q, 50833);
+        mpz_set_ui(rsa_components->e, 7);
+        mpz_set_ui(rsa_components->d, 758442487);
+    }
+
+    mpz_mul(rsa_components->n, rsa_components->p, rsa_components->q);
+    if (key_out_path != NULL) {
+        rsa_write_key_file(rsa_components, key_out_path);
+    }
+
+    rsa_prepare_components(rsa_components);
+
+    return;
+}
+
+void rsa_load_components(struct rsa_components_struct *rsa_components, const char *key_text, int depth)
+{
+    rsa_init_components(rsa_components);
+    rsa_components->depth = depth;
+    if (rsa_parse_key(rsa_components, key_text)) {
+        printf("\nError: Invalid RSA key.\n");
+        exit(1);
+    }
+    rsa_prepare_components(rsa_components);
+
+    return;
+}
+
+void rsa_free_components(struct rsa_components_struct *rsa_components) {
+
+    /* clear gmp variables */
+    mpz_clear(rsa_components->p);
+    mpz_clear(rsa_components->q);
+    mpz_clear(rsa_components->p_minus_1);
+    mpz_clear(rsa_components->q_minus_1);
+    mpz_clear(rsa_components->n);
+    mpz_clear(rsa_components->phi);
+    mpz_clear(rsa_components->e);
+    mpz_clear(rsa_components->d);
+    mpz_clear(rsa_components->d_p);
+    mpz_clear(rsa_components->d_q);
+    mpz_clear(rsa_components->q_inverse);
+
+    rsa_free_gmp_scratch(rsa_components);
+    rsa_exponent_plan_free(&rsa_components->plan_e);
+    rsa_exponent_plan_free(&rsa_components->plan_d);
+    rsa_exponent_plan_free(&rsa_components->plan_d_p);
+    rsa_exponent_plan_free(&rsa_components->plan_d_q);
+
+    free(rsa_components->encrypt_table);
+    rsa_components->encrypt_table = NULL;
+    if (rsa_components->decrypt_index != NULL) {
+        free(rsa_components->decrypt_index->ciphertexts);
+        free(rsa_components->decrypt_index->plaintexts);
+        free(rsa_components->decrypt_index->buckets);
+        free(rsa_components->decrypt_index);
+        rsa_components->decrypt_index = NULL;
+    }
+
+    return;
+}
+
+size_t rsa_encrypted_frame_words(const struct rsa_components_struct *rsa_components, size_t pixels)
+{
+    if (rsa_components->hybrid) {
+        return (pixels * sizeof(uint16_t) + sizeof(unsigned int) - 1) / sizeof(unsigned int);
+    }
+
+    return rsa_block_codec_words(&rsa_components->codec, pixels);
+}
+
+void rsa_print_components(const struct rsa_components_struct *rsa_components)
+{
+    printf("\nRSA modulus = %zu bits, pixel depth = %d bits, backend = %s, CRT decryption = %s, encryption table = %s, decryption index = %s\n",
+           mpz_sizeinbase(rsa_components->n, 2), rsa_components->depth, (rsa_components->backend == RSA_BACKEND_NATIVE) ? "native" : "gmp",
+           rsa_components->crt ? "on" : "off", (rsa_components->encrypt_table != NULL) ? "on" : "off",
+           (rsa_components->decrypt_index != NULL) ? "on" : "off");
+
+    if (rsa_components->hybrid) {
+        printf("\nRSA mode = hybrid, ChaCha20 kernels = %s\n", rsa_components->chacha20->name);
+    }
+    if (rsa_components->codec.block_words > 1) {
+        printf("\nRSA blocks = %zu pixels in %zu words\n", rsa_components->codec.block_pixels,
+               rsa_components->codec.block_words);
+    }
+    if (rsa_components->backend == RSA_BACKEND_NATIVE) {
+        printf("\nRSA kernels = %s\n", rsa_components->kernels->name);
+    }
+    if (rsa_components->gmp_arena) {
+        printf("\nGMP arena = on\n");
+    }
+    if (rsa_components->backend == RSA_BACKEND_NATIVE || rsa_components->gmp_plan) {
+        printf("\nRSA plans (window, operations) = e (%d, %d), d (%d, %d), d_p (%d, %d), d_q (%d, %d)\n",
+               rsa_components->plan_e.window, rsa_components->plan_e.operations,
+               rsa_components->plan_d.window, rsa_components->plan_d.operations,
+               rsa_components->plan_d_p.window, rsa_components->plan_d_p.operations,
+               rsa_components->plan_d_q.window, rsa_components->plan_d_q.operations);
+    }
+
+    return;
+}
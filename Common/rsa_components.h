@@ -0,0 +1,145 @@
+/****************************************************************************************************************
+RSA components and per-frame encryption/decryption shared by the RSA tools. With a modulus of at most 32 bits every
+pixel is enciphered on its own, larger moduli encipher blocks of pixels (rsa_block_codec.h). Keys whose modulus
+fits in 32 bits run on the native Montgomery backend (rsa_montgomery.h), larger keys on GMP mpz_powm. The backend
+is picked from n and can be forced with --rsa-backend=auto|gmp|native. Decryption can use the Chinese Remainder
+Theorem on both backends, see --rsa-crt=auto|on|off. Since pixels of depth bits (--depth, frame_geometry.h) have
+only 2^depth values, encryption looks every pixel up in a table built once per key (--rsa-encrypt-table) and
+decryption in the reverse index of that table (--rsa-decrypt-index); a pixel above the depth is an error.
+Exponentiations replay a sliding window plan compiled once per exponent (rsa_exponent_plan.h, --rsa-window,
+--rsa-plan). On GMP every thread works in mpz_t scratch of its own, and GMP temporaries come from per-thread arenas
+(gmp_arena.h, --rsa-gmp-arena). The key is the built-in test key, a new random key of --rsa-bits bits, or the key
+file given by --rsa-key. --rsa-key-out saves the key in use, so the decryption tools can load the key the
+encryption tool generated. --rsa-mode=hybrid instead enciphers the frames with ChaCha20 (chacha20.h) under a
+per-stream session key, which the RSA key wraps once into a stream header (rsa_begin_stream/rsa_open_stream). The
+frame number is the nonce, so frames can be processed in any order. Frames can also be split into parts
+(rsa_encrypt_frame_part) that threads encipher side by side.
+****************************************************************************************************************/
+
+#ifndef RSA_COMPONENTS_H
+#define RSA_COMPONENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* other open source c libraries */
+#include <gmp.h>
+
+#include "chacha20.h"
+#include "rsa_block_codec.h"
+#include "rsa_exponent_plan.h"
+#include "rsa_montgomery.h"
+
+#define RSA_MAX_DEPTH 16 // bits of a uint16_t pixel, also the depth of the session values of the stream header
+#define RSA_INDEX_BUCKET_BITS 14 // the reverse index directory has 2^14 buckets, about 4 ciphertexts each
+#define RSA_KEY_EXPONENT 65537 // e of generated keys
+#define RSA_KEY_MIN_BITS 20 // smallest --rsa-bits, n must stay above every pixel value and phi above e
+#define RSA_KEY_FILE_BYTES 4096 // first buffer of a key file being read, doubled until the file fits
+#define RSA_KEY_MAX_BITS 16384
+#define RSA_STREAM_ID_BYTES 4 // with the 64-bit frame number it makes up the ChaCha20 nonce
+#define RSA_SESSION_VALUES ((CHACHA20_KEY_BYTES + RSA_STREAM_ID_BYTES) / 2) // session key and stream id, as uint16_t values
+
+/* ciphertext to plaintext index of all plaintext pixel values */
+struct rsa_decrypt_index_struct {
+    unsigned int *ciphertexts; // sorted ciphertexts of all plaintext values
+    uint16_t *plaintexts; // plaintext of ciphertexts[i]
+    uint32_t *buckets; // index of the first ciphertext c with c >> shift >= bucket, one extra entry at the end
+    int shift; // ciphertext bits below the bucket number
+};
+
+struct rsa_gmp_scratch_struct; // per-thread mpz_t of the GMP backend, see rsa_components.c
+
+enum rsa_backend {
+    RSA_BACKEND_GMP, // mpz_powm, any key size
+    RSA_BACKEND_NATIVE // 64-bit Montgomery arithmetic, n of at most RSA_MONTGOMERY_MAX_BITS bits
+};
+
+struct rsa_components_struct {
+    mpz_t p; // prime number 1
+    mpz_t q; // prime number 2
+    mpz_t p_minus_1; // prime number 1
+    mpz_t q_minus_1; // prime number 2
+    mpz_t n; // n = p * q
+    mpz_t phi; // phi = (p - 1) * (q - 1), must not share factor with e
+    mpz_t e; // 2 < e < phi
+    mpz_t d; // (d * e) % phi = 1
+    mpz_t d_p; // d mod (p - 1), CRT exponent modulo p
+    mpz_t d_q; // d mod (q - 1), CRT exponent modulo q
+    mpz_t q_inverse; // q^-1 mod p, CRT recombination
+    int crt; // nonzero to decrypt with the CRT components
+    int depth; // bits of a plaintext pixel, RSA_MAX_DEPTH in hybrid mode
+    int plaintext_values; // 2^depth, entries of the encryption table and the decryption index
+    struct rsa_block_codec_struct codec; // layout of the encrypted frames for n
+    struct rsa_exponent_plan_struct plan_e; // exponentiation plans, built once per key
+    struct rsa_exponent_plan_struct plan_d;
+    struct rsa_exponent_plan_struct plan_d_p;
+    struct rsa_exponent_plan_struct plan_d_q;
+    int gmp_plan; // nonzero if the GMP backend replays the plans instead of calling mpz_powm
+    int gmp_arena; // nonzero if GMP temporaries of the frame loops come from per-thread arenas
+    unsigned long generation; // unique per key, tells a thread's cached scratch of this key from that of a freed one
+    struct rsa_gmp_scratch_struct *gmp_scratch; // scratch of every thread that used the key, freed with it
+    enum rsa_backend backend; // arithmetic used by rsa_encrypt_frame and rsa_decrypt_frame
+    struct rsa_montgomery_struct montgomery; // modulus n for the native backend
+    const struct rsa_montgomery_kernels_struct *kernels; // native kernels selected for this cpu (--rsa-kernels)
+    uint64_t e_native; // e for the native backend
+    uint64_t d_native; // d for the native backend
+    struct rsa_montgomery_struct montgomery_p; // modulus p for native CRT decryption
+    struct rsa_montgomery_struct montgomery_q; // modulus q for native CRT decryption
+    uint64_t d_p_native; // d_p for the native backend
+    uint64_t d_q_native; // d_q for the native backend
+    uint32_t q_inverse_native; // q_inverse in the Montgomery form of p
+    int hybrid; // nonzero to encipher frames with ChaCha20 under the session key (--rsa-mode=hybrid)
+    const struct chacha20_kernels_struct *chacha20; // ChaCha20 kernels selected for this cpu (--chacha20-kernels)
+    uint8_t session_key[CHACHA20_KEY_BYTES]; // set by rsa_begin_stream or rsa_open_stream
+    uint8_t stream_id[RSA_STREAM_ID_BYTES];
+    unsigned int *encrypt_table; // ciphertext of every plaintext pixel value, or NULL to exponentiate per pixel
+    struct rsa_decrypt_index_struct *decrypt_index; // reverse index of the ciphertexts, or NULL to exponentiate per pixel
+};
+
+/* generates or loads the key, derives phi and the CRT components and selects the backend for pixels of depth
+   bits, exits with an error on invalid options */
+void rsa_generate_components(struct rsa_components_struct *rsa_components, int depth);
+
+/* like rsa_generate_components for the key in key_text, used to share one key between MPI ranks */
+void rsa_load_components(struct rsa_components_struct *rsa_components, const char *key_text, int depth);
+
+/* returns the key in the key file format (malloc'd, NUL-terminated) */
+char *rsa_format_key(const struct rsa_components_struct *rsa_components);
+
+void rsa_free_components(struct rsa_components_struct *rsa_components);
+
+/* prints the key size and backend in the style of the tools' other settings */
+void rsa_print_components(const struct rsa_components_struct *rsa_components);
+
+/* number of unsigned int words of an encrypted frame of pixels pixels, pixels for moduli of at most 32 bits */
+size_t rsa_encrypted_frame_words(const struct rsa_components_struct *rsa_components, size_t pixels);
+
+/* number of unsigned int words of the stream header written before the first frame, 0 unless in hybrid mode */
+size_t rsa_stream_header_words(const struct rsa_components_struct *rsa_components);
+
+/* hybrid mode: draws a new session key and stores it wrapped with the RSA key in header, otherwise does nothing */
+void rsa_begin_stream(struct rsa_components_struct *rsa_components, unsigned int *header);
+
+/* hybrid mode: unwraps the session key of header, otherwise does nothing */
+void rsa_open_stream(struct rsa_components_struct *rsa_components, const unsigned int *header);
+
+/* enciphers pixels uint16_t pixels of frame number frame of the stream into the rsa_encrypted_frame_words words of encrypted_frame */
+void rsa_encrypt_frame(const uint16_t *original_frame, size_t pixels, uint64_t frame, struct rsa_components_struct *rsa_components,
+                       unsigned int *encrypted_frame);
+
+/* deciphers the encrypted frame number frame of pixels pixels in encrypted_frame into decrypted_frame */
+void rsa_decrypt_frame(const unsigned int *encrypted_frame, size_t pixels, uint64_t frame, struct rsa_components_struct *rsa_components,
+                       uint16_t *decrypted_frame);
+
+/* frames can be split into parts starting at multiples of this many pixels, each enciphered on its own */
+size_t rsa_frame_part_pixels(const struct rsa_components_struct *rsa_components);
+
+/* like rsa_encrypt_frame for pixels first to first + count - 1 of the frame only, first a multiple of rsa_frame_part_pixels */
+void rsa_encrypt_frame_part(const uint16_t *original_frame, size_t pixels, size_t first, size_t count, uint64_t frame,
+                            struct rsa_components_struct *rsa_components, unsigned int *encrypted_frame);
+
+/* like rsa_decrypt_frame for pixels first to first + count - 1 of the frame only, first a multiple of rsa_frame_part_pixels */
+void rsa_decrypt_frame_part(const unsigned int *encrypted_frame, size_t pixels, size_t first, size_t count, uint64_t frame,
+                            struct rsa_components_struct *rsa_components, uint16_t *decrypted_frame);
+
+#endif
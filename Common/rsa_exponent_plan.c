@@ -0,0 +1,157 @@
+/****************************************************************************************************************
+Exponentiation plans for the fixed RSA exponents, see rsa_exponent_plan.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/* other open source c libraries */
+#include <gmp.h>
+
+#include "rsa_exponent_plan.h"
+
+/********************************************************
+Left-to-right sliding window over the bits of exponent:
+every window starts at a set bit, spans at most window
+bits and ends at a set bit, so its value is odd. Fills
+plan (step must hold one entry per exponent bit) and
+returns the number of modular operations it costs.
+********************************************************/
+static int rsa_exponent_plan_schedule(struct rsa_exponent_plan_struct *plan, const mpz_t exponent, int window)
+{
+    int bit = (int) mpz_sizeinbase(exponent, 2) - 1;
+    uint32_t zeros = 0;
+    int first = 1;
+    int operations = 0;
+
+    plan->window = window;
+    plan->powers = 1 << (window - 1);
+    plan->first_power = RSA_PLAN_NO_MULTIPLY;
+    plan->steps = 0;
+
+    if (mpz_sgn(exponent) == 0) {
+        plan->powers = 0;
+        plan->operations = 0;
+        return 0;
+    }
+
+    while (bit >= 0) {
+        if (!mpz_tstbit(exponent, bit)) {
+            zeros++;
+            bit--;
+            continue;
+        }
+
+        /* longest window of at most window bits from here that ends at a set bit */
+        int low = (bit - window + 1 > 0) ? bit - window + 1 : 0;
+        while (!mpz_tstbit(exponent, low)) {
+            low++;
+        }
+        uint32_t value = 0;
+        for (int b = bit; b >= low; b--) {
+            value = (value << 1) | (uint32_t) mpz_tstbit(exponent, b);
+        }
+
+        if (first) {
+            plan->first_power = (uint16_t) (value >> 1);
+            first = 0;
+        }
+        else {
+            plan->step[plan->steps].squarings = zeros + (uint32_t) (bit - low + 1);
+            plan->step[plan->steps].power = (uint16_t) (value >> 1);
+            operations += (int) plan->step[plan->steps].squarings + 1;
+            plan->steps++;
+        }
+        zeros = 0;
+        bit = low - 1;
+    }
+    if (zeros > 0) {
+        plan->step[plan->steps].squarings = zeros;
+        plan->step[plan->steps].power = RSA_PLAN_NO_MULTIPLY;
+        operations += (int) zeros;
+        plan->steps++;
+    }
+
+    /* base^2 and one multiplication per further odd power */
+    if (plan->powers > 1) {
+        operations += plan->powers;
+    }
+    plan->operations = operations;
+
+    return operations;
+}
+
+void rsa_exponent_plan_init(struct rsa_exponent_plan_struct *plan, const mpz_t exponent, int window)
+{
+    size_t bits = mpz_sizeinbase(exponent, 2);
+
+    plan->step = (struct rsa_plan_step_struct*)malloc(sizeof(struct rsa_plan_step_struct)*(bits + 1));
+    if (plan->step == NULL) {
+        printf("Memory could not be allocated for the RSA exponentiation plan\n");
+        exit(1);
+    }
+
+    if (window > 0) {
+        rsa_exponent_plan_schedule(plan, exponent, (window < RSA_PLAN_MAX_WINDOW) ? window : RSA_PLAN_MAX_WINDOW);
+        return;
+    }
+
+    /* cost every window size, then rebuild the cheapest one (ties go to the smaller table) */
+    int best_window = 1;
+    int best_operations = rsa_exponent_plan_schedule(plan, exponent, 1);
+    for (int w = 2; w <= RSA_PLAN_MAX_WINDOW; w++) {
+        int operations = rsa_exponent_plan_schedule(plan, exponent, w);
+        if (operations < best_operations) {
+            best_operations = operations;
+            best_window = w;
+        }
+    }
+    rsa_exponent_plan_schedule(plan, exponent, best_window);
+
+    return;
+}
+
+void rsa_exponent_plan_free(struct rsa_exponent_plan_struct *plan)
+{
+    free(plan->step);
+    plan->step = NULL;
+
+    return;
+}
+
+void rsa_exponent_plan_powm(mpz_t rop, const mpz_t base, const struct rsa_exponent_plan_struct *plan, const mpz_t modulus,
+                            mpz_t *powers)
+{
+    if (plan->first_power == RSA_PLAN_NO_MULTIPLY) {
+        mpz_set_ui(rop, 1);
+        mpz_mod(rop, rop, modulus);
+        return;
+    }
+
+    /* odd powers, rop holds base^2 while they are built */
+    mpz_mod(powers[0], base, modulus);
+    if (plan->powers > 1) {
+        mpz_mul(rop, powers[0], powers[0]);
+        mpz_mod(rop, rop, modulus);
+        for (int k = 1; k < plan->powers; k++) {
+            mpz_mul(powers[k], powers[k - 1], rop);
+            mpz_mod(powers[k], powers[k], modulus);
+        }
+    }
+
+    mpz_set(rop, powers[plan->first_power]);
+    for (int s = 0; s < plan->steps; s++) {
+        for (uint32_t k = 0; k < plan->step[s].squarings; k++) {
+            mpz_mul(rop, rop, rop);
+            mpz_mod(rop, rop, modulus);
+        }
+        if (plan->step[s].power != RSA_PLAN_NO_MULTIPLY) {
+            mpz_mul(rop, rop, powers[plan->step[s].power]);
+            mpz_mod(rop, rop, modulus);
+        }
+    }
+
+    return;
+}
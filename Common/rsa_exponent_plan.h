@@ -0,0 +1,43 @@
+/****************************************************************************************************************
+Exponentiation plans for the fixed RSA exponents. e, d and the CRT exponents never change during a run, so
+their sliding-window schedule is worked out once per key: the window size that needs the fewest modular
+operations, the odd powers of the base to precompute, and the straight-line sequence of squarings and
+multiplications. The per-pixel loops only replay it.
+****************************************************************************************************************/
+
+#ifndef RSA_EXPONENT_PLAN_H
+#define RSA_EXPONENT_PLAN_H
+
+#include <stdint.h>
+
+/* other open source c libraries */
+#include <gmp.h>
+
+#define RSA_PLAN_MAX_WINDOW 6 // at most 2^(6-1) = 32 precomputed odd powers
+#define RSA_PLAN_MAX_POWERS (1 << (RSA_PLAN_MAX_WINDOW - 1))
+#define RSA_PLAN_NO_MULTIPLY UINT16_MAX // step with squarings only (trailing zero bits)
+
+struct rsa_plan_step_struct {
+    uint32_t squarings; // squarings of the running result before the multiplication
+    uint16_t power; // multiply by base^(2 * power + 1), or RSA_PLAN_NO_MULTIPLY
+};
+
+struct rsa_exponent_plan_struct {
+    int window; // window size in bits, 1 is plain binary exponentiation
+    int powers; // odd powers base^1, base^3, ..., base^(2 * powers - 1) to precompute
+    uint16_t first_power; // the running result starts as base^(2 * first_power + 1)
+    int steps; // number of entries in step, 0 with first_power RSA_PLAN_NO_MULTIPLY for exponent 0
+    struct rsa_plan_step_struct *step;
+    int operations; // modular squarings and multiplications per exponentiation, precomputation included
+};
+
+/* builds the cheapest sliding-window plan for exponent, window 0 picks the size, otherwise it is forced */
+void rsa_exponent_plan_init(struct rsa_exponent_plan_struct *plan, const mpz_t exponent, int window);
+
+void rsa_exponent_plan_free(struct rsa_exponent_plan_struct *plan);
+
+/* rop = base^exponent mod modulus by replaying plan with GMP arithmetic, powers is scratch of plan->powers values */
+void rsa_exponent_plan_powm(mpz_t rop, const mpz_t base, const struct rsa_exponent_plan_struct *plan, const mpz_t modulus,
+                            mpz_t *powers);
+
+#endif
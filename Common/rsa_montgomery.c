@@ -0,0 +1,286 @@
+/****************************************************************************************************************
+Native modular exponentiation for small RSA moduli, see rsa_montgomery.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdint.h>
+#include <string.h>
+
+/* x86 SIMD intrinsics, kernels are compiled per target and selected at runtime */
+#if defined(__x86_64__) || defined(__i386__)
+#define RSA_MONTGOMERY_X86 1
+#include <immintrin.h>
+#else
+#define RSA_MONTGOMERY_X86 0
+#endif
+
+#include "rsa_montgomery.h"
+
+int rsa_montgomery_init(struct rsa_montgomery_struct *montgomery, uint32_t n)
+{
+    if (n < 3 || (n & 1) == 0) {
+        return 1;
+    }
+
+    /* Newton iteration for n^-1 mod 2^32, every step doubles the number of correct low bits (n * n = 1 mod 8) */
+    uint32_t inverse = n;
+    for (int i = 0; i < 4; i++) {
+        inverse *= 2 - n * inverse;
+    }
+
+    montgomery->n = n;
+    montgomery->n_prime = -inverse;
+    montgomery->one = (uint32_t) ((UINT64_C(1) << 32) % n);
+    montgomery->r_squared = (uint32_t) (((uint64_t) montgomery->one * montgomery->one) % n);
+
+    return 0;
+}
+
+/********************************************************
+Left-to-right binary exponentiation in Montgomery form.
+The base is reduced mod n first, so any 32-bit value is
+accepted.
+********************************************************/
+uint32_t rsa_montgomery_powm(const struct rsa_montgomery_struct *montgomery, uint32_t base, uint64_t exponent)
+{
+    uint32_t x = rsa_montgomery_multiply(montgomery, base % montgomery->n, montgomery->r_squared);
+    uint32_t result = montgomery->one;
+
+    for (int bit = 63 - __builtin_clzll(exponent | 1); bit >= 0; bit--) {
+        result = rsa_montgomery_multiply(montgomery, result, result);
+        if ((exponent >> bit) & 1) {
+            result = rsa_montgomery_multiply(montgomery, result, x);
+        }
+    }
+
+    /* multiplying by 1 takes the result out of Montgomery form */
+    return rsa_montgomery_multiply(montgomery, result, 1);
+}
+
+/********************************************************
+Replays plan on lanes (at most RSA_MONTGOMERY_LANES)
+bases at once. A single exponentiation is one long chain
+of dependent multiplications, interleaving independent
+lanes lets the cpu overlap their latencies.
+********************************************************/
+static inline void rsa_montgomery_powm_plan_lanes(const struct rsa_montgomery_struct *montgomery, const uint32_t *base,
+                                                  int lanes, const struct rsa_exponent_plan_struct *plan, uint32_t *result)
+{
+    uint32_t powers[RSA_MONTGOMERY_LANES][RSA_PLAN_MAX_POWERS];
+    uint32_t r[RSA_MONTGOMERY_LANES];
+
+    if (plan->first_power == RSA_PLAN_NO_MULTIPLY) {
+        for (int lane = 0; lane < lanes; lane++) {
+            result[lane] = 1;
+        }
+        return;
+    }
+
+    /* odd powers base, base^3, ... in Montgomery form, r holds base^2 while they are built */
+    for (int lane = 0; lane < lanes; lane++) {
+        powers[lane][0] = rsa_montgomery_multiply(montgomery, base[lane] % montgomery->n, montgomery->r_squared);
+        r[lane] = rsa_montgomery_multiply(montgomery, powers[lane][0], powers[lane][0]);
+    }
+    for (int k = 1; k < plan->powers; k++) {
+        for (int lane = 0; lane < lanes; lane++) {
+            powers[lane][k] = rsa_montgomery_multiply(montgomery, powers[lane][k - 1], r[lane]);
+        }
+    }
+
+    for (int lane = 0; lane < lanes; lane++) {
+        r[lane] = powers[lane][plan->first_power];
+    }
+    for (int s = 0; s < plan->steps; s++) {
+        const struct rsa_plan_step_struct step = plan->step[s];
+        for (uint32_t k = 0; k < step.squarings; k++) {
+            for (int lane = 0; lane < lanes; lane++) {
+                r[lane] = rsa_montgomery_multiply(montgomery, r[lane], r[lane]);
+            }
+        }
+        if (step.power != RSA_PLAN_NO_MULTIPLY) {
+            for (int lane = 0; lane < lanes; lane++) {
+                r[lane] = rsa_montgomery_multiply(montgomery, r[lane], powers[lane][step.power]);
+            }
+        }
+    }
+
+    for (int lane = 0; lane < lanes; lane++) {
+        result[lane] = rsa_montgomery_multiply(montgomery, r[lane], 1);
+    }
+
+    return;
+}
+
+/* scalar kernel, RSA_MONTGOMERY_LANES interleaved exponentiations then the remaining tail together */
+static void rsa_montgomery_powm_frame(const struct rsa_montgomery_struct *montgomery, const uint32_t *base, size_t count,
+                                      const struct rsa_exponent_plan_struct *plan, uint32_t *result)
+{
+    size_t i = 0;
+
+    for (; i + RSA_MONTGOMERY_LANES <= count; i += RSA_MONTGOMERY_LANES) {
+        rsa_montgomery_powm_plan_lanes(montgomery, &base[i], RSA_MONTGOMERY_LANES, plan, &result[i]);
+    }
+    if (i < count) {
+        rsa_montgomery_powm_plan_lanes(montgomery, &base[i], (int) (count - i), plan, &result[i]);
+    }
+
+    return;
+}
+
+#if RSA_MONTGOMERY_X86
+#define RSA_MONTGOMERY_AVX2_VECTORS 4 // registers of four 64-bit lanes interleaved per block
+#define RSA_MONTGOMERY_AVX2_BLOCK (4 * RSA_MONTGOMERY_AVX2_VECTORS)
+
+/*
+    Montgomery product of four 32-bit values held in the low halves of 64-bit lanes, same arithmetic as
+    rsa_montgomery_multiply. a may be any 32-bit value when b < n (the result is still below 2n before the
+    final subtraction), which lets the conversion into Montgomery form skip the reduction of the base.
+*/
+__attribute__((target("avx2")))
+static inline __m256i rsa_montgomery_multiply_avx2(__m256i a, __m256i b, __m256i n, __m256i n_prime, __m256i n_minus_1)
+{
+    __m256i t = _mm256_mul_epu32(a, b);
+    __m256i m = _mm256_mul_epu32(t, n_prime);
+    __m256i mn = _mm256_mul_epu32(m, n);
+
+    /* (t + m * n) / R carries 1 out of the low halves unless low(t) is 0, the compare gives -1 in that case */
+    __m256i low_zero = _mm256_cmpeq_epi64(_mm256_slli_epi64(t, 32), _mm256_setzero_si256());
+    __m256i u = _mm256_add_epi64(_mm256_srli_epi64(t, 32), _mm256_srli_epi64(mn, 32));
+    u = _mm256_add_epi64(u, _mm256_add_epi64(low_zero, _mm256_set1_epi64x(1)));
+
+    /* u < 2n < 2^33, so the signed 64-bit compare is exact */
+    return _mm256_sub_epi64(u, _mm256_and_si256(n, _mm256_cmpgt_epi64(u, n_minus_1)));
+}
+
+__attribute__((target("avx2")))
+static void rsa_montgomery_powm_frame_avx2(const struct rsa_montgomery_struct *montgomery, const uint32_t *base,
+                                           size_t count, const struct rsa_exponent_plan_struct *plan, uint32_t *result)
+{
+    const __m256i n = _mm256_set1_epi64x(montgomery->n);
+    const __m256i n_prime = _mm256_set1_epi64x(montgomery->n_prime);
+    const __m256i n_minus_1 = _mm256_set1_epi64x((int64_t) montgomery->n - 1);
+    const __m256i r_squared = _mm256_set1_epi64x(montgomery->r_squared);
+    const __m256i plain_one = _mm256_set1_epi64x(1);
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    size_t i = 0;
+
+    for (; plan->first_power != RSA_PLAN_NO_MULTIPLY && i + RSA_MONTGOMERY_AVX2_BLOCK <= count;
+         i += RSA_MONTGOMERY_AVX2_BLOCK) {
+        __m256i powers[RSA_PLAN_MAX_POWERS][RSA_MONTGOMERY_AVX2_VECTORS];
+        __m256i r[RSA_MONTGOMERY_AVX2_VECTORS];
+
+        /* odd powers in Montgomery form, r holds base^2 while they are built */
+        for (int v = 0; v < RSA_MONTGOMERY_AVX2_VECTORS; v++) {
+            __m256i b = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*) &base[i + 4 * v]));
+            powers[0][v] = rsa_montgomery_multiply_avx2(b, r_squared, n, n_prime, n_minus_1);
+            r[v] = rsa_montgomery_multiply_avx2(powers[0][v], powers[0][v], n, n_prime, n_minus_1);
+        }
+        for (int k = 1; k < plan->powers; k++) {
+            for (int v = 0; v < RSA_MONTGOMERY_AVX2_VECTORS; v++) {
+                powers[k][v] = rsa_montgomery_multiply_avx2(powers[k - 1][v], r[v], n, n_prime, n_minus_1);
+            }
+        }
+
+        for (int v = 0; v < RSA_MONTGOMERY_AVX2_VECTORS; v++) {
+            r[v] = powers[plan->first_power][v];
+        }
+        for (int s = 0; s < plan->steps; s++) {
+            const struct rsa_plan_step_struct step = plan->step[s];
+            for (uint32_t k = 0; k < step.squarings; k++) {
+                for (int v = 0; v < RSA_MONTGOMERY_AVX2_VECTORS; v++) {
+                    r[v] = rsa_montgomery_multiply_avx2(r[v], r[v], n, n_prime, n_minus_1);
+                }
+            }
+            if (step.power != RSA_PLAN_NO_MULTIPLY) {
+                for (int v = 0; v < RSA_MONTGOMERY_AVX2_VECTORS; v++) {
+                    r[v] = rsa_montgomery_multiply_avx2(r[v], powers[step.power][v], n, n_prime, n_minus_1);
+                }
+            }
+        }
+
+        for (int v = 0; v < RSA_MONTGOMERY_AVX2_VECTORS; v++) {
+            __m256i plain = rsa_montgomery_multiply_avx2(r[v], plain_one, n, n_prime, n_minus_1);
+            __m256i packed = _mm256_permutevar8x32_epi32(plain, pack);
+            _mm_storeu_si128((__m128i*) &result[i + 4 * v], _mm256_castsi256_si128(packed));
+        }
+    }
+
+    rsa_montgomery_powm_frame(montgomery, &base[i], count - i, plan, &result[i]);
+
+    return;
+}
+#endif
+
+/* kernel sets, fastest first */
+static const struct rsa_montgomery_kernels_struct rsa_montgomery_kernel_sets[] = {
+#if RSA_MONTGOMERY_X86
+    {"avx2", rsa_montgomery_powm_frame_avx2},
+#endif
+    {"scalar", rsa_montgomery_powm_frame},
+};
+#define RSA_MONTGOMERY_KERNEL_SETS ((int) (sizeof(rsa_montgomery_kernel_sets) / sizeof(rsa_montgomery_kernel_sets[0])))
+
+/* returns 1 if the cpu running the program can execute the named kernel set */
+static int rsa_montgomery_kernels_supported(const char *name)
+{
+#if RSA_MONTGOMERY_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return strcmp(name, "scalar") == 0;
+}
+
+const struct rsa_montgomery_kernels_struct *rsa_montgomery_select_kernels(const char *name)
+{
+    for (int k = 0; k < RSA_MONTGOMERY_KERNEL_SETS; k++) {
+        if (name != NULL && strcmp(name, "auto") != 0 && strcmp(name, rsa_montgomery_kernel_sets[k].name) != 0) {
+            continue;
+        }
+        if (rsa_montgomery_kernels_supported(rsa_montgomery_kernel_sets[k].name)) {
+            return &rsa_montgomery_kernel_sets[k];
+        }
+    }
+
+    return NULL;
+}
+
+/********************************************************
+Runs every supported kernel set with plan on the extreme
+values of the modulus and a spread of others, with a
+count that is not a multiple of any block size so the
+tails are covered too, and compares with the binary
+exponentiation of rsa_montgomery_powm.
+********************************************************/
+int rsa_montgomery_verify_kernels(const struct rsa_montgomery_struct *montgomery, uint64_t exponent,
+                                  const struct rsa_exponent_plan_struct *plan)
+{
+    enum { count = 1021 };
+    uint32_t base[count];
+    uint32_t result[count];
+    uint32_t seed = 12345;
+    int mismatch = 0;
+
+    for (int i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        base[i] = seed;
+    }
+    base[0] = 0;
+    base[1] = 1;
+    base[2] = montgomery->n - 1;
+    base[3] = montgomery->n;
+    base[4] = UINT32_MAX;
+
+    for (int k = 0; k < RSA_MONTGOMERY_KERNEL_SETS && !mismatch; k++) {
+        if (!rsa_montgomery_kernels_supported(rsa_montgomery_kernel_sets[k].name)) {
+            continue;
+        }
+        rsa_montgomery_kernel_sets[k].powm_frame(montgomery, base, count, plan, result);
+        for (int i = 0; i < count; i++) {
+            mismatch |= result[i] != rsa_montgomery_powm(montgomery, base[i], exponent);
+        }
+    }
+
+    return mismatch;
+}
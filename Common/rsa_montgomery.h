@@ -0,0 +1,61 @@
+/****************************************************************************************************************
+Native modular exponentiation for RSA moduli of at most 32 bits. Numbers are kept in Montgomery form with
+R = 2^32, so every modular multiplication is one 64-bit product and a shift instead of a division, and no
+GMP limb handling is involved. The modulus must be odd, which every RSA modulus is.
+
+Whole frames are exponentiated by a kernel set selected at runtime: AVX2 (four 64-bit Montgomery lanes per
+register, several registers interleaved) or the portable scalar lanes. Both replay the exponentiation plan of
+the exponent (rsa_exponent_plan.h) instead of scanning its bits.
+****************************************************************************************************************/
+
+#ifndef RSA_MONTGOMERY_H
+#define RSA_MONTGOMERY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rsa_exponent_plan.h"
+
+#define RSA_MONTGOMERY_MAX_BITS 32
+#define RSA_MONTGOMERY_LANES 4 // bases exponentiated together by the scalar kernel
+
+struct rsa_montgomery_struct {
+    uint32_t n; // odd modulus
+    uint32_t n_prime; // -n^-1 mod 2^32
+    uint32_t r_squared; // R^2 mod n, converts into Montgomery form
+    uint32_t one; // R mod n, 1 in Montgomery form
+};
+
+/* fills montgomery for modulus n, returns nonzero if n is even or smaller than 3 */
+int rsa_montgomery_init(struct rsa_montgomery_struct *montgomery, uint32_t n);
+
+/* returns a * b * R^-1 mod n for a, b < n */
+static inline uint32_t rsa_montgomery_multiply(const struct rsa_montgomery_struct *montgomery, uint32_t a, uint32_t b)
+{
+    uint64_t t = (uint64_t) a * b;
+    uint32_t m = (uint32_t) t * montgomery->n_prime;
+
+    /* (t + m * n) / R without the 65-bit sum: the low halves add up to 0 mod R and carry iff low(t) != 0 */
+    uint64_t u = (t >> 32) + (((uint64_t) m * montgomery->n) >> 32) + ((uint32_t) t != 0);
+
+    return (uint32_t) ((u >= montgomery->n) ? u - montgomery->n : u);
+}
+
+/* returns base^exponent mod n */
+uint32_t rsa_montgomery_powm(const struct rsa_montgomery_struct *montgomery, uint32_t base, uint64_t exponent);
+
+struct rsa_montgomery_kernels_struct {
+    const char *name;
+    /* result[i] = base[i]^exponent mod n for count values (any count), replaying the plan of exponent */
+    void (*powm_frame)(const struct rsa_montgomery_struct *montgomery, const uint32_t *base, size_t count,
+                       const struct rsa_exponent_plan_struct *plan, uint32_t *result);
+};
+
+/* returns the named kernel set ("avx2" or "scalar"), or the fastest supported one for NULL or "auto", NULL if unsupported */
+const struct rsa_montgomery_kernels_struct *rsa_montgomery_select_kernels(const char *name);
+
+/* checks every supported kernel set running plan against rsa_montgomery_powm with exponent, returns 0 if they match */
+int rsa_montgomery_verify_kernels(const struct rsa_montgomery_struct *montgomery, uint64_t exponent,
+                                  const struct rsa_exponent_plan_struct *plan);
+
+#endif
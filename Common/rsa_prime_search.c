@@ -0,0 +1,104 @@
+/****************************************************************************************************************
+Random prime search for RSA key generation, see rsa_prime_search.h.
+****************************************************************************************************************/
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+
+/* other open source c libraries */
+#include <gmp.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "rsa_prime_search.h"
+
+/* opens /dev/urandom, exits with an error if it cannot be opened */
+static FILE *rsa_prime_urandom(void)
+{
+    FILE *urandom = fopen("/dev/urandom", "rb");
+    if (urandom == NULL) {
+        printf("\nError: Could not open /dev/urandom for the RSA primes.\n");
+        exit(1);
+    }
+
+    return urandom;
+}
+
+/* fills buffer with bytes of /dev/urandom, exits with an error if they cannot be read */
+static void rsa_prime_random_bytes(FILE *urandom, unsigned char *buffer, size_t bytes)
+{
+    if (fread(buffer, 1, bytes, urandom) != bytes) {
+        printf("\nError: Could not read /dev/urandom for the RSA primes.\n");
+        exit(1);
+    }
+
+    return;
+}
+
+void rsa_random_prime(mpz_t prime, unsigned int bits, const mpz_t e)
+{
+    int found = 0;
+
+#ifdef _OPENMP
+    #pragma omp parallel shared(found)
+#endif
+    {
+        /* every thread reads its own candidates from /dev/urandom */
+        FILE *urandom = rsa_prime_urandom();
+        size_t bytes = (bits + 7) / 8;
+        unsigned char *random_bytes = (unsigned char *) malloc(bytes);
+        mpz_t candidate;
+        mpz_t candidate_minus_1;
+        mpz_t gcd;
+        if (random_bytes == NULL) {
+            printf("Memory could not be allocated for the RSA prime candidates\n");
+            exit(1);
+        }
+        mpz_init(candidate);
+        mpz_init(candidate_minus_1);
+        mpz_init(gcd);
+
+        int done = 0;
+        while (!done) {
+            rsa_prime_random_bytes(urandom, random_bytes, bytes);
+            mpz_import(candidate, bytes, 1, 1, 0, 0, random_bytes);
+            mpz_fdiv_r_2exp(candidate, candidate, bits);
+            mpz_setbit(candidate, bits - 1);
+            mpz_setbit(candidate, bits - 2);
+            mpz_setbit(candidate, 0);
+
+            /* e must be invertible modulo phi, which the cheap gcd settles before the expensive test */
+            mpz_sub_ui(candidate_minus_1, candidate, 1);
+            mpz_gcd(gcd, candidate_minus_1, e);
+            if (mpz_cmp_ui(gcd, 1) == 0 && mpz_probab_prime_p(candidate, RSA_PRIME_REPS) > 0) {
+#ifdef _OPENMP
+                #pragma omp critical(rsa_random_prime)
+#endif
+                {
+                    if (!found) {
+                        mpz_set(prime, candidate);
+#ifdef _OPENMP
+                        #pragma omp atomic write
+#endif
+                        found = 1;
+                    }
+                }
+            }
+
+#ifdef _OPENMP
+            #pragma omp atomic read
+#endif
+            done = found;
+        }
+
+        fclose(urandom);
+        free(random_bytes);
+        mpz_clear(candidate);
+        mpz_clear(candidate_minus_1);
+        mpz_clear(gcd);
+    }
+
+    return;
+}
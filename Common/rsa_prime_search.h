@@ -0,0 +1,24 @@
+/****************************************************************************************************************
+Random prime search for RSA key generation. Every bit of every candidate is read fresh from /dev/urandom, so a
+key has as much entropy as it has bits. Candidates are drawn and tested with GMP's probabilistic primality test
+on every OpenMP thread at once, the first thread to find a prime ends the search. The serial and MPI tools build
+this file alone with -fopenmp, so their key generation (on rank 0 for MPI) is parallel as well; built without
+OpenMP the search runs on the calling thread.
+****************************************************************************************************************/
+
+#ifndef RSA_PRIME_SEARCH_H
+#define RSA_PRIME_SEARCH_H
+
+/* other open source c libraries */
+#include <gmp.h>
+
+#define RSA_PRIME_REPS 30 // Miller-Rabin rounds of mpz_probab_prime_p, error below 4^-30
+
+/*
+    Sets prime to a random prime of exactly bits bits (the two top bits set, so the product of two such primes
+    has exactly the sum of their sizes) with prime - 1 coprime to e. Exits with an error if /dev/urandom cannot
+    be read.
+*/
+void rsa_random_prime(mpz_t prime, unsigned int bits, const mpz_t e);
+
+#endif
@@ -0,0 +1,292 @@
+/****************************************************************************************************************
+Topology-aware placement of the OpenMP threads, see thread_placement.h.
+****************************************************************************************************************/
+
+/* sched_setaffinity and the CPU_SET macros */
+#define _GNU_SOURCE
+
+/* standard c libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cli_options.h"
+#include "thread_placement.h"
+
+struct thread_placement_cpu_struct {
+    int cpu;
+    int socket; // physical package
+    int core; // core within the package
+    int sibling; // 0 for the first hyperthread of a core, 1 for the second, ...
+    int rank; // position among the cpus of the socket in compact order
+};
+
+static int thread_placement_read_id(int cpu, const char *name)
+{
+    char path[128];
+    int id = 0;
+
+    /* a missing topology (containers without sysfs) looks like one socket with one thread per core */
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE *f = fopen(path, "r");
+    if (f != NULL) {
+        if (fscanf(f, "%d", &id) != 1) {
+            id = 0;
+        }
+        fclose(f);
+    }
+    else if (strcmp(name, "core_id") == 0) {
+        id = cpu;
+    }
+
+    return id;
+}
+
+/* compact order: socket by socket, first hyperthreads of all cores before the second ones */
+static int thread_placement_compare_compact(const void *a, const void *b)
+{
+    const struct thread_placement_cpu_struct *x = (const struct thread_placement_cpu_struct *) a;
+    const struct thread_placement_cpu_struct *y = (const struct thread_placement_cpu_struct *) b;
+
+    if (x->socket != y->socket) {
+        return (x->socket < y->socket) ? -1 : 1;
+    }
+    if (x->sibling != y->sibling) {
+        return (x->sibling < y->sibling) ? -1 : 1;
+    }
+    if (x->core != y->core) {
+        return (x->core < y->core) ? -1 : 1;
+    }
+
+    return (x->cpu > y->cpu) - (x->cpu < y->cpu);
+}
+
+/********************************************************
+Lists the cpus the process may run on in compact order
+and returns their number. The sibling rank of every cpu
+is its position among the cpus of the same core.
+********************************************************/
+static int thread_placement_cpus(struct thread_placement_cpu_struct *cpus)
+{
+    cpu_set_t allowed;
+    int count = 0;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return 0;
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        cpus[count].cpu = cpu;
+        cpus[count].socket = thread_placement_read_id(cpu, "physical_package_id");
+        cpus[count].core = thread_placement_read_id(cpu, "core_id");
+        cpus[count].sibling = 0;
+        for (int other = 0; other < count; other++) {
+            if (cpus[other].socket == cpus[count].socket && cpus[other].core == cpus[count].core) {
+                cpus[count].sibling++;
+            }
+        }
+        count++;
+    }
+    qsort(cpus, count, sizeof(struct thread_placement_cpu_struct), thread_placement_compare_compact);
+
+    return count;
+}
+
+/* spread order: the first cpu of every socket, then the second of every socket, ... */
+static int thread_placement_compare_spread(const void *a, const void *b)
+{
+    const struct thread_placement_cpu_struct *x = (const struct thread_placement_cpu_struct *) a;
+    const struct thread_placement_cpu_struct *y = (const struct thread_placement_cpu_struct *) b;
+
+    if (x->rank != y->rank) {
+        return (x->rank < y->rank) ? -1 : 1;
+    }
+
+    return (x->socket > y->socket) - (x->socket < y->socket);
+}
+
+static void thread_placement_spread(struct thread_placement_cpu_struct *cpus, int count)
+{
+    /* ranks within the sockets of the compact list */
+    for (int i = 0; i < count; i++) {
+        cpus[i].rank = (i > 0 && cpus[i].socket == cpus[i - 1].socket) ? cpus[i - 1].rank + 1 : 0;
+    }
+    qsort(cpus, count, sizeof(struct thread_placement_cpu_struct), thread_placement_compare_spread);
+
+    return;
+}
+
+/********************************************************
+Reads --placement=spread|compact|none and pins thread t
+of the OpenMP team to the t-th cpu of the chosen order
+(wrapping around when there are more threads than cpus).
+Prints an error and exits on an invalid value.
+********************************************************/
+void thread_placement_from_options(struct thread_placement_struct *placement)
+{
+    const char *policy = cli_option("placement");
+
+    placement->policy = (policy != NULL) ? policy : "spread";
+    if (strcmp(placement->policy, "spread") != 0 && strcmp(placement->policy, "compact") != 0
+        && strcmp(placement->policy, "none") != 0) {
+        printf("\nError: Unknown placement %s. Please use --placement=spread, compact or none.\n", placement->policy);
+        exit(1);
+    }
+
+    #ifdef _OPENMP
+    placement->threads = omp_get_max_threads();
+    #else
+    placement->threads = 1;
+    #endif
+    placement->cpu = (int *) malloc(sizeof(int) * placement->threads);
+    placement->socket = (int *) malloc(sizeof(int) * placement->threads);
+    placement->counters = (struct thread_placement_counter_struct *) calloc(placement->threads,
+                                                                            sizeof(struct thread_placement_counter_struct));
+    struct thread_placement_cpu_struct *cpus = (struct thread_placement_cpu_struct *) malloc(
+        sizeof(struct thread_placement_cpu_struct) * CPU_SETSIZE);
+    if (placement->cpu == NULL || placement->socket == NULL || placement->counters == NULL || cpus == NULL) {
+        printf("Memory could not be allocated for the thread placement\n");
+        exit(1);
+    }
+
+    int count = thread_placement_cpus(cpus);
+    placement->sockets = 0;
+    for (int i = 0; i < count; i++) {
+        if (i == 0 || cpus[i].socket != cpus[i - 1].socket) {
+            placement->sockets++;
+        }
+    }
+    if (strcmp(placement->policy, "spread") == 0 && count > 0) {
+        thread_placement_spread(cpus, count);
+    }
+
+    for (int t = 0; t < placement->threads; t++) {
+        int pinned = count > 0 && strcmp(placement->policy, "none") != 0;
+        placement->cpu[t] = pinned ? cpus[t % count].cpu : -1;
+        placement->socket[t] = pinned ? cpus[t % count].socket : 0;
+    }
+    free(cpus);
+
+    /* every thread pins itself, the team and its affinity persist across the later parallel regions */
+    #ifdef _OPENMP
+    #pragma omp parallel
+    #endif
+    {
+        #ifdef _OPENMP
+        int t = omp_get_thread_num();
+        #else
+        int t = 0;
+        #endif
+        if (placement->cpu[t] >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(placement->cpu[t], &set);
+            if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+                placement->cpu[t] = -1;
+            }
+        }
+    }
+
+    return;
+}
+
+void thread_placement_free(struct thread_placement_struct *placement)
+{
+    free(placement->cpu);
+    free(placement->socket);
+    free(placement->counters);
+
+    return;
+}
+
+void thread_placement_print(const struct thread_placement_struct *placement)
+{
+    printf("\nThread placement = %s, %d threads on %d sockets", placement->policy, placement->threads, placement->sockets);
+    if (strcmp(placement->policy, "none") != 0) {
+        printf(", cpus");
+        for (int t = 0; t < placement->threads; t++) {
+            printf(" %d", placement->cpu[t]);
+        }
+    }
+    printf("\n");
+
+    return;
+}
+
+void thread_placement_start(struct thread_placement_struct *placement)
+{
+    memset(placement->counters, 0, sizeof(struct thread_placement_counter_struct) * placement->threads);
+    clock_gettime(CLOCK_MONOTONIC, &placement->start);
+
+    return;
+}
+
+void thread_placement_count(struct thread_placement_struct *placement, size_t pixels)
+{
+    #ifdef _OPENMP
+    placement->counters[omp_get_thread_num()].pixels += (double) pixels;
+    #else
+    placement->counters[0].pixels += (double) pixels;
+    #endif
+
+    return;
+}
+
+/********************************************************
+Prints the frames per second of wall clock time that the
+threads of every socket processed, and the total. Frames
+split between sockets count in part on each. Without
+pinning the sockets are unknown and only the total is
+printed.
+********************************************************/
+void thread_placement_report(const struct thread_placement_struct *placement, size_t frame_pixels)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (double) (end.tv_sec - placement->start.tv_sec) + 1e-9 * (double) (end.tv_nsec - placement->start.tv_nsec);
+    double total = 0.0;
+
+    if (seconds <= 0.0 || frame_pixels == 0) {
+        return;
+    }
+
+    for (int t = 0; t < placement->threads; t++) {
+        total += placement->counters[t].pixels;
+    }
+    if (strcmp(placement->policy, "none") != 0) {
+        for (int t = 0; t < placement->threads; t++) {
+            /* sockets are reported once each, in the order of their first thread */
+            int socket = placement->socket[t];
+            int seen = 0;
+            for (int u = 0; u < t; u++) {
+                seen |= placement->socket[u] == socket;
+            }
+            if (seen || placement->cpu[t] < 0) {
+                continue;
+            }
+
+            double pixels = 0.0;
+            int threads = 0;
+            for (int u = t; u < placement->threads; u++) {
+                if (placement->socket[u] == socket && placement->cpu[u] >= 0) {
+                    pixels += placement->counters[u].pixels;
+                    threads++;
+                }
+            }
+            printf("\nSocket %d Throughput:   %0.2lf frames/sec (%d threads)\n", socket, pixels / frame_pixels / seconds,
+                   threads);
+        }
+    }
+    printf("\nTotal Throughput:   %0.2lf frames/sec over %0.6lf seconds\n", total / frame_pixels / seconds, seconds);
+
+    return;
+}
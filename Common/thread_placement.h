@@ -0,0 +1,53 @@
+/****************************************************************************************************************
+Topology-aware placement of the OpenMP threads of the video processing tools. libgomp keeps the threads of a team
+alive from one parallel region to the next, so pinning every thread once at start-up gives the tools a persistent,
+pinned worker pool. --placement=spread (default) deals threads out to the sockets in turn, compact fills one socket
+before the next, none leaves placement to the system (or to OMP_PROC_BIND). Both place threads on distinct
+physical cores before hyperthread siblings. The topology is read from sysfs, restricted to the cpus the process
+may run on.
+
+Buffers are placed by first touch (frame_schedule_first_touch), and the pixels every thread processes are counted
+to report the throughput of every socket.
+****************************************************************************************************************/
+
+#ifndef THREAD_PLACEMENT_H
+#define THREAD_PLACEMENT_H
+
+#include <stddef.h>
+#include <time.h>
+
+#define THREAD_PLACEMENT_LINE_BYTES 64 // per-thread counters sit on cache lines of their own
+
+struct thread_placement_counter_struct {
+    double pixels; // pixels processed by the thread since thread_placement_start
+    char padding[THREAD_PLACEMENT_LINE_BYTES - sizeof(double)];
+};
+
+struct thread_placement_struct {
+    const char *policy; // spread, compact or none (--placement)
+    int threads; // OpenMP threads, 1 without OpenMP
+    int sockets; // sockets with cpus the process may run on
+    int *cpu; // cpu of every thread, -1 if it is not pinned
+    int *socket; // socket of every pinned thread
+    struct thread_placement_counter_struct *counters; // work of every thread
+    struct timespec start; // wall clock at thread_placement_start
+};
+
+/* reads --placement, discovers the sockets and pins the OpenMP threads, exits with an error on an invalid option */
+void thread_placement_from_options(struct thread_placement_struct *placement);
+
+void thread_placement_free(struct thread_placement_struct *placement);
+
+/* prints the placement in the style of the tools' other settings */
+void thread_placement_print(const struct thread_placement_struct *placement);
+
+/* clears the counters and starts the wall clock of thread_placement_report */
+void thread_placement_start(struct thread_placement_struct *placement);
+
+/* adds pixels to the work of the calling thread */
+void thread_placement_count(struct thread_placement_struct *placement, size_t pixels);
+
+/* prints the frames per second processed on every socket since thread_placement_start, for frames of frame_pixels pixels */
+void thread_placement_report(const struct thread_placement_struct *placement, size_t frame_pixels);
+
+#endif
@@ -1,6 +1,6 @@
 /****************************************************************************************************************
 This file contains the source code for a RSA encryption and decryption. It was written by Zhanneta Plokhovska 
-(zhp3@pitt.edu). It encrypts and decrypts raw video files (256 x 256 pixels frame size, 2 bytes per pixel) 
+(zhp3@pitt.edu). It encrypts and decrypts raw video files (256 x 256 pixels frame size by default, see --geometry, 2 bytes per pixel) 
 and compares original file to decrypted file.
 ****************************************************************************************************************/
 
@@ -16,23 +16,30 @@ and compares original file to decrypted file.
 /* other open source c libraries */
 #include <gmp.h>
 
-#define IMAGE_WIDTH 256
-#define IMAGE_HEIGHT 256
-#define DIM 65536 //IMAGE_WIDTH*IMAGE_HEIGHT
+/* shared project sources */
+#include "cli_options.h"
+#include "frame_geometry.h"
+#include "frame_source.h"
 
 /* 
-    ./program filename1.raw filename2.raw num_of_frames
+    ./program filename1.raw filename2.raw [num_of_frames|all] [--geometry=WxH] [--depth=bits]
 */
 int main(int argc, char **argv)
 {
     char original_filename_1[50];
     char original_filename_2[50];
-    int frames;
     
     printf("\nReading input arguments...\n");
     
-    if (argc < 4) {
-        printf("\nError: Invalid arguments. Please run the program as follows: ./program filename1.raw filename2.raw num_of_frames\n");
+    /* --geometry=WxH and --depth=bits, everything else is positional */
+    argc = cli_options_parse(argc, argv);
+    struct frame_geometry_struct geometry;
+    frame_geometry_from_options(&geometry);
+    cli_options_check_used();
+    const size_t pixels = geometry.pixels;
+    
+    if (argc < 3) {
+        printf("\nError: Invalid arguments. Please run the program as follows: ./program filename1.raw filename2.raw [num_of_frames|all] [--geometry=WxH] [--depth=bits]\n");
         exit(0);
     }
         
@@ -41,59 +48,34 @@ int main(int argc, char **argv)
     
     printf("\nVideo filename 1 = %s\n", original_filename_1);
     printf("\nVideo filename 2 = %s\n", original_filename_2);
+    frame_geometry_print(&geometry);
     
-    frames = atoi(argv[3]);
-    
-    /* declare file variables */
-	FILE *original_f_1;
-	FILE *original_f_2;
-    
-    /* open original files */
-	printf("\nOpening original video files...\n");
-	original_f_1 = fopen(original_filename_1, "r");
-	if (original_f_1 == NULL) {
-		printf("\nError: Pointer to original_f_1 is NULL.\n");
-        exit(1);
-	}
-    original_f_2 = fopen(original_filename_2, "r");
-    if (original_f_2 == NULL) {
-		printf("\nError: Pointer to original_f_2 is NULL.\n");
-        exit(1);
-	}
-    
-    /* allocate memory for buffer to hold original video file */
-    printf("\nAllocating memory for buffers...\n");
-    uint16_t *original_buffer_1;
-	original_buffer_1 = (uint16_t*)malloc(sizeof(uint16_t)*(frames*DIM));
-	if (original_buffer_1 == NULL) {
-		printf("Memory could not be allocated for the 16-bit original_buffer_1\n");
-		exit(1);
-	}
-    uint16_t *original_buffer_2;
-	original_buffer_2 = (uint16_t*)malloc(sizeof(uint16_t)*(frames*DIM));
-	if (original_buffer_2 == NULL) {
-		printf("Memory could not be allocated for the 16-bit original_buffer_2\n");
-		exit(1);
-	}
-    
-
-    /* read original file into original_buffer */
-    printf("\nReading original_f...\n");
-    fread(original_buffer_1, sizeof(uint16_t), frames*DIM, original_f_1);   
-    fread(original_buffer_2, sizeof(uint16_t), frames*DIM, original_f_2);
+    /* open both files, frames are streamed through bounded memory however long the videos are */
+    printf("\nOpening original video files...\n");
+    struct frame_source_struct source_1;
+    struct frame_source_struct source_2;
+    frame_source_open(&source_1, original_filename_1, 0, geometry.frame_bytes);
+    frame_source_open(&source_2, original_filename_2, 0, geometry.frame_bytes);
+    frame_source_print(&source_1);
+    frame_source_print(&source_2);
+    /* all frames of the files when num_of_frames is not given */
+    const char *requested = (argc > 3) ? argv[3] : NULL;
+    long frames = frame_source_count(&source_1, requested);
+    frame_source_count(&source_2, requested);
+    printf("\nFrame count = %ld\n", frames);
 
-    /* cycle through frames in original_buffer and perform operations on individual frames */
-    for (int f = 0; f < frames; f++) {
+    /* cycle through the frames of both files and compare them frame by frame */
+    for (long f = 0; f < frames; f++) {
         
-        uint16_t *original_frame_1 = &original_buffer_1[f*DIM];
-        uint16_t *original_frame_2 = &original_buffer_2[f*DIM];
+        const uint16_t *original_frame_1 = (const uint16_t *) frame_source_frames(&source_1, f, 1);
+        const uint16_t *original_frame_2 = (const uint16_t *) frame_source_frames(&source_2, f, 1);
         
         //Compare original image to decrypted image'
         printf("\nComparing original frame to decrypted frame...\n");
-        for(int i = 0; i < DIM; i++){
+        for(size_t i = 0; i < pixels; i++){
             if (original_frame_1[i] != original_frame_2[i]) {
-                printf("\noriginal_frame[%d] = %d\n", i, original_frame_1[i]);
-                printf("\ndecrypted_frame[%d] = %d\n", i, original_frame_2[i]);
+                printf("\noriginal_frame[%zu] = %d\n", i, original_frame_1[i]);
+                printf("\ndecrypted_frame[%zu] = %d\n", i, original_frame_2[i]);
                 printf("\nDecrypted frame does not match the original frame.\n");
                 exit(1);
             }
@@ -101,10 +83,8 @@ int main(int argc, char **argv)
         printf("\nOriginal frame and decrypted frame are identical.\n");
     }
 
-    free(original_buffer_1);
-    free(original_buffer_2);
-    fclose(original_f_1);
-    fclose(original_f_2);
+    frame_source_close(&source_1);
+    frame_source_close(&source_2);
     
     return 0;
 }
@@ -1,6 +1,6 @@
 /****************************************************************************************************************
 This file contains the source code for a RSA encryption. It was written by Zhanneta Plokhovska 
-(zhp3@pitt.edu). It encrypts raw video files (256 x 256 pixels frame size, 2 bytes per pixel).
+(zhp3@pitt.edu). It encrypts raw video files (256 x 256 pixels frame size by default, see --geometry, 2 bytes per pixel).
 ****************************************************************************************************************/
 
 /* standard c libraries */
@@ -18,156 +18,104 @@ This file contains the source code for a RSA encryption. It was written by Zhann
 /* other open source c libraries */
 #include <gmp.h>
 
-#define IMAGE_WIDTH 256
-#define IMAGE_HEIGHT 256
-#define DIM 65536 //IMAGE_WIDTH*IMAGE_HEIGHT
-
-struct rsa_components_struct {
-    mpz_t p; // prime number 1
-    mpz_t q; // prime number 2
-    mpz_t p_minus_1; // prime number 1
-    mpz_t q_minus_1; // prime number 2
-    mpz_t n; // n = p * q
-    mpz_t phi; // phi = (p - 1) * (q - 1), must not share factor with e
-    mpz_t e; // 2 < e < phi
-    mpz_t d; // (d * e) % phi = 1
-};
-
-/********************************************************
-This function performs encryption. It accepts encrypted 
-frame and rsa parameters. Each uint16_t in the frame is 
-ciphered using RSA algorithm. Stores output in
-encrypted_frame.
-********************************************************/
-void rsa_encrypt_frame(uint16_t *original_frame, struct rsa_components_struct *rsa_components, unsigned int *encrypted_frame)
-{
-    /* using gmp library to deal with very large numbers */
-    
-    /* initialize gmp variables */
-    mpz_t encrypted_pixel;
-    mpz_t base;
-    mpz_init(encrypted_pixel);
-    mpz_init(base);
-    
-    for (int i = 0; i < DIM; i++)
-    {
-        /* set gmp variables */
-        mpz_set_ui(encrypted_pixel, 0);
-        mpz_set_ui(base, (unsigned int ) original_frame[i]);
-        
-        /* void mpz_powm (mpz_t rop, const mpz_t base, const mpz_t exp, const mpz_t mod) */
-        /* Set rop to (base raised to exp) modulo mod. */
-        mpz_powm(encrypted_pixel, base, rsa_components->e, rsa_components->n);
-
-        /* convert back from mpz_t to uint16_t */
-        encrypted_frame[i] = (unsigned int) mpz_get_ui(encrypted_pixel);
-        
-        /* Debugging
-        if (i == 0) {
-            gmp_printf ("encrypted_pixel is an mpz %Zd\n", encrypted_pixel);
-            printf("\noriginal_frame[0] = %d\n", original_frame[i]);
-            printf("\nencrypted_frame[0] = %d\n", encrypted_frame[i]);
-        }
-        */
-    }
-    
-    /* free gmp variables */
-    mpz_clear(encrypted_pixel);
-    mpz_clear(base);
-        
-    return;
-}
-
-/********************************************************
-Used to generate rsa components needed for encryption
-and decryption. Stores output in rsa_components.
-********************************************************/
-void rsa_generate_components(struct rsa_components_struct *rsa_components) {   
-    /* for testing purposes assign rsa components statically */
-    
-    /* initialize gmp variables */
-    mpz_init(rsa_components->p);
-    mpz_init(rsa_components->q);
-    mpz_init(rsa_components->p_minus_1);
-    mpz_init(rsa_components->q_minus_1);
-    mpz_init(rsa_components->n);
-    mpz_init(rsa_components->phi);
-    mpz_init(rsa_components->e);
-    mpz_init(rsa_components->d);
-    
-    /* set/calculate gmp variables */
-    mpz_set_ui(rsa_components->p, 52223);
-    mpz_set_ui(rsa_components->q, 50833);
-    mpz_mul(rsa_components->n, rsa_components->p, rsa_components->q);
-    mpz_sub_ui(rsa_components->p_minus_1, rsa_components->p, 1);
-    mpz_sub_ui(rsa_components->q_minus_1, rsa_components->q, 1);
-    mpz_mul(rsa_components->phi, rsa_components->p_minus_1, rsa_components->q_minus_1);
-    mpz_set_ui(rsa_components->e, 7);
-    mpz_set_ui(rsa_components->d, 758442487);
-    
-    return;   
-}
-
-void rsa_free_components(struct rsa_components_struct *rsa_components) {   
-    
-    /* clear gmp variables */
-    mpz_clear(rsa_components->p);
-    mpz_clear(rsa_components->q);
-    mpz_clear(rsa_components->p_minus_1);
-    mpz_clear(rsa_components->q_minus_1);
-    mpz_clear(rsa_components->n);
-    mpz_clear(rsa_components->phi);
-    mpz_clear(rsa_components->e);
-    mpz_clear(rsa_components->d);
-    
-    return;   
-}
+/* shared project sources */
+#include "cli_options.h"
+#include "frame_geometry.h"
+#include "frame_metrics.h"
+#include "frame_mpi_io.h"
+#include "frame_pacer.h"
+#include "frame_pipeline.h"
+#include "frame_source.h"
+#include "frame_writer.h"
+#include "rsa_components.h"
 
 /* 
-    ./program num_of_frames filename.raw framerate(optional)
+    ./program num_of_frames|all filename.raw framerate(optional) [--geometry=WxH] [--depth=bits]
+              [--rsa-key=path] [--rsa-key-out=path] [--rsa-bits=N] [--rsa-mode=direct|hybrid]
+              [--rsa-backend=auto|gmp|native] [--rsa-crt=auto|on|off] [--rsa-kernels=auto|avx2|scalar]
+              [--chacha20-kernels=auto|avx2|sse2|scalar] [--rsa-window=auto|N] [--rsa-plan=auto|on|off]
+              [--rsa-encrypt-table=on|off] [--rsa-decrypt-index=on|off] [--rsa-gmp-arena=on|off]
+              [--pacing=realtime|fast|Nx] [--metrics-json=path] [--metrics-csv=path]
+              [--input=mmap|read] [--input-ring=N] [--pipeline=on|off] [--pipeline-depth=N]
+              [--writer=auto|uring|thread] [--writer-direct=on|off] [--writer-depth=N] [--writer-block=bytes]
+              [--mpi-io=on|off]
 */
 int main(int argc, char **argv)
 {
     char original_filename[50];
     float frame_freq;
-    uint16_t *original_buffer;
-    unsigned int *encrypted_buffer;
     struct rsa_components_struct rsa_components;
-    clock_t exec_start, exec_end, frame_start, frame_end;
-    float delay;
-	int frames;
-    FILE *original_f;
-	FILE *encrypted_f;
+    struct frame_pacer_struct pacer; // deadlines of the incoming frames
+    struct frame_metrics_struct metrics; // wall clock stage times of every frame
+	long frames;
+    struct frame_source_struct source; // original file, mapped on rank 0
+    struct frame_pipeline_struct pipeline; // reads and writes of rank 0
+    struct frame_mpi_io_struct mpi_io; // reads and writes of every rank
+	struct frame_writer_struct encrypted_f;
     
     /* MPI variables */
     int rank; // id of current node
     int size; // total number of nodes
     
-    /* Initialize MPI */
-    MPI_Init(&argc, &argv);
+    /* Initialize MPI, the pipeline threads of rank 0 make no MPI calls */
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     
     /* Identify rank and size for MPI */
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 	MPI_Comm_size(MPI_COMM_WORLD, &size);
     
+    /* --geometry=WxH and --depth=bits, everything else is positional */
+    argc = cli_options_parse(argc, argv);
+    struct frame_geometry_struct geometry;
+    frame_geometry_from_options(&geometry);
+    const size_t pixels = geometry.pixels;
+    frame_mpi_io_from_options(&mpi_io);
+    
     if (argc < 3) {
             if (!rank) {
-                printf("\nError: Invalid arguments. Please run the program as follows: ./program num_of_frames filename.raw framerate(optional)\n");
+                printf("\nError: Invalid arguments. Please run the program as follows: ./program num_of_frames|all filename.raw framerate(optional) [--geometry=WxH] [--depth=bits]\n"
+                       "              [--rsa-key=path] [--rsa-key-out=path] [--rsa-bits=N] [--rsa-mode=direct|hybrid]\n"
+                       "              [--rsa-backend=auto|gmp|native] [--rsa-crt=auto|on|off] [--rsa-kernels=auto|avx2|scalar]\n"
+                       "              [--chacha20-kernels=auto|avx2|sse2|scalar] [--rsa-window=auto|N] [--rsa-plan=auto|on|off]\n"
+                       "              [--rsa-encrypt-table=on|off] [--rsa-decrypt-index=on|off] [--rsa-gmp-arena=on|off]\n"
+                       "              [--pacing=realtime|fast|Nx] [--metrics-json=path] [--metrics-csv=path]\n"
+                       "              [--input=mmap|read] [--input-ring=N] [--pipeline=on|off] [--pipeline-depth=N]\n"
+                       "              [--writer=auto|uring|thread] [--writer-direct=on|off] [--writer-depth=N] [--writer-block=bytes]\n"
+                       "              [--mpi-io=on|off]\n");
             }
             exit(0);
     }
     
-    frames = atoi(argv[1]);
+    /* generate p, q, n, phi, e, and d for RSA encryption and decryption */
+    /* rank 0 generates or loads the key and shares it, so all ranks use the same key */
+    char *key_text = NULL;
+    int key_length = 0;
+    if (!rank) {
+        rsa_generate_components(&rsa_components, geometry.depth);
+        rsa_print_components(&rsa_components);
+        key_text = rsa_format_key(&rsa_components);
+        key_length = (int) strlen(key_text) + 1;
+    }
+    MPI_Bcast(&key_length, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank) {
+        key_text = (char*)malloc((size_t) key_length);
+    }
+    MPI_Bcast(key_text, key_length, MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (rank) {
+        rsa_load_components(&rsa_components, key_text, geometry.depth);
+    }
+    free(key_text);
+    const size_t encrypted_words = rsa_encrypted_frame_words(&rsa_components, pixels);
     
     /* Rank 0 will control the input/output files and collect execution/delay times */
     if (!rank) {
         printf("\nReading input arguments...\n");
         
-        printf("\nFrame count = %d\n", frames);
-
         strcpy(original_filename, argv[2]);
         
         printf("\nVideo filename = %s\n", original_filename);
+        frame_geometry_print(&geometry);
 
         
         if (argc == 4) {
@@ -177,126 +125,179 @@ int main(int argc, char **argv)
             frame_freq = (float) 1.0/30.0; //default frame rate is 30 frames/sec
         }   
         
-        printf("\nFrame frequency = %f sec\n", frame_freq);    
-        
-        /* open original file */
-        printf("\nOpening original video file...\n");
-        original_f = fopen(original_filename, "r");
-        if (original_f == NULL) {
-            printf("\nError: Pointer to original_f is NULL.\n");
-            exit(1);
-        }
-        
-        /* calculate filesize, number of frames, and identify start and end pointers */
-        printf("\nCalculating filesize, number of frames, and identifying start and end pointers...\n");
-        //printf("\nPointer of original_f = %p\n", original_f);
-        long int position;
-        fseek(original_f, 0, SEEK_END); //seek the end of file
-        long const int filesize = ftell(original_f); //get the size of the file
-        position = ftell(original_f);
-        //printf("\nOffset of original_f pointer (end) = %ld\n", position);
-        rewind(original_f); //set position back to beginning    
-        position = ftell(original_f);
-        //printf("\nOffset of original_f pointer (start) = %ld \n", position);
-      
-        /* allocate memory for buffer to hold original video file */
-        printf("\nAllocating memory for buffers...\n");
-        original_buffer = (uint16_t*)malloc(sizeof(uint16_t)*(filesize));
-        if (original_buffer == NULL) {
-            printf("Memory could not be allocated for the 16-bit original_buffer\n");
+        printf("\nFrame frequency = %f sec\n", frame_freq);
+        frame_pacer_from_options(&pacer, frame_freq);
+        frame_pacer_print(&pacer);
+        frame_metrics_from_options(&metrics, pixels);
+        frame_pipeline_from_options(&pipeline);
+        frame_pipeline_print(&pipeline);
+        if (pipeline.threaded && provided < MPI_THREAD_FUNNELED) {
+            printf("\nError: The MPI library does not support threads. Please use --pipeline=off.\n");
             exit(1);
         }
-        encrypted_buffer = (unsigned int*)malloc(sizeof(unsigned int)*size*DIM); // number of frames =  number of nodes
-        if (encrypted_buffer == NULL) {
-            printf("Memory could not be allocated for the 32-bit encrypted_buffer\n");
+        frame_mpi_io_print(&mpi_io);
+        if (pipeline.threaded && mpi_io.enabled) {
+            printf("\nError: The pipeline reads and writes on rank 0. Please use --pipeline=off with --mpi-io=on.\n");
             exit(1);
         }
         
-        /* read original file into original_buffer */
-        printf("\nReading original_f...\n");
-        fread(original_buffer, sizeof(uint16_t), filesize, original_f);
-        //printf("\nOffset of original_f pointer (after reading) = %p\n", original_f);    
-        fclose(original_f);
-        
-        /* open encrypted file */
-        printf("\nOpening output file...\n");
-        encrypted_f = fopen("encrypted.raw", "w");
-        if (encrypted_f == NULL) {
-            printf("\nError: Pointer to encrypted_f is NULL.\n");
-            exit(1);
+        /* map the original file, frames are paged in as they are scattered; with MPI-IO it is only counted */
+        printf("\nOpening original video file...\n");
+        frame_source_open(&source, original_filename, 0, geometry.frame_bytes);
+        frame_source_print(&source);
+        frames = frame_source_count(&source, argv[1]);
+        printf("\nFrame count = %ld\n", frames);
+      
+        /* open encrypted file, with MPI-IO every rank opens it below */
+        if (!mpi_io.enabled) {
+            printf("\nOpening output file...\n");
+            frame_writer_open(&encrypted_f, "encrypted.raw");
+            frame_writer_print(&encrypted_f);
         }
         
+        /* every option has been read, a misspelt one is an error */
+        cli_options_check_used();
+
         /* variables for calculating execution time and controlling frame rate */
         printf("\nStarting operations on original_f...\n");
-        exec_start = clock(); //start counting execution time
-        frame_start = clock();
-        frame_end = frame_start;
+        frame_pacer_start(&pacer);
+        frame_metrics_start(&metrics);
     
-        delay = 0.0;
-        
         printf("\nEncrypting...\n");
     }
 
-    /* generate p, q, n, phi, e, and d for RSA encryption and decryption */
-    rsa_generate_components(&rsa_components);
+    /* rank 0 counted the frames of the file */
+    MPI_Bcast(&frames, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+
+    const size_t header_words = rsa_stream_header_words(&rsa_components);
+
+    /* MPI-IO: every rank opens the original and the encrypted file */
+    if (mpi_io.enabled) {
+        frame_mpi_io_open(&mpi_io, argv[2], 0, geometry.frame_bytes, "encrypted.raw", sizeof(unsigned int)*header_words,
+                          sizeof(unsigned int)*encrypted_words);
+    }
+
+    /* hybrid mode: rank 0 starts the stream, the other ranks unwrap its session key from the header */
+    if (header_words > 0) {
+        unsigned int *header = (unsigned int*)malloc(sizeof(unsigned int)*header_words);
+        if (!rank) {
+            rsa_begin_stream(&rsa_components, header);
+            if (mpi_io.enabled) {
+                frame_mpi_io_write_header(&mpi_io, header);
+            }
+            else {
+                frame_writer_write(&encrypted_f, header, sizeof(unsigned int)*header_words);
+            }
+        }
+        MPI_Bcast(header, (int) header_words, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+        if (rank) {
+            rsa_open_stream(&rsa_components, header);
+        }
+        free(header);
+    }
     
-    uint16_t *original_frame = (uint16_t*)malloc(sizeof(uint16_t)*DIM);
-    unsigned int *encrypted_frame = (unsigned int*)malloc(sizeof(unsigned int)*DIM);  
+    /* rank 0 reads the frames of all nodes and writes their results through the pipeline, see frame_pipeline.h */
+    if (!rank && !mpi_io.enabled) {
+        printf("\nAllocating memory for buffers...\n");
+        frame_pipeline_init(&pipeline, &source, &pacer, &metrics, &encrypted_f, frames, size, sizeof(unsigned int)*encrypted_words);
+        frame_pipeline_run(&pipeline);
+    }
     
-    /* cycle through frames in original_buffer and perform operations on individual frames */
-	for (int f = 0; f < frames/size; f++) {
-        if (!rank) {
-            /* Wait until next frame is available based on frame rate (frame_freq)*/
-            clock_t current_time = clock();
-            while ((((float) (current_time - frame_start) / CLOCKS_PER_SEC)) <  size*frame_freq) {
-                //printf("\nTime passed:   %0.6lf seconds\n", (float) (current_time - frame_start) / CLOCKS_PER_SEC);
-                //printf("."); //Waiting on the next frame...\n");
-                current_time = clock();
-            };        
-            
-            frame_start = clock();
-            delay = delay + (((float) (frame_end - frame_start) / CLOCKS_PER_SEC));
+    uint16_t *original_frame = (uint16_t*)malloc(sizeof(uint16_t)*pixels);
+    unsigned int *encrypted_frame = (unsigned int*)malloc(sizeof(unsigned int)*encrypted_words);  
+    
+    /* frames of every rank in a group for MPI_Scatterv and MPI_Gatherv, 0 for a rank the last group leaves out */
+    int *scatter_counts = (int*)malloc(sizeof(int)*size);
+    int *gather_counts = (int*)malloc(sizeof(int)*size);
+    int *scatter_offsets = (int*)malloc(sizeof(int)*size);
+    int *gather_offsets = (int*)malloc(sizeof(int)*size);
+    for (int r = 0; r < size; r++) {
+        scatter_offsets[r] = r * (int) pixels;
+        gather_offsets[r] = r * (int) encrypted_words;
+    }
+    
+    /* cycle through the frames of the original file and perform operations on individual frames */
+	for (long f = 0; f*size < frames; f++) {
+        /* the last group of a video can leave the highest ranks without a frame */
+        int group = (frames - f*size < size) ? (int) (frames - f*size) : size;
+        int active = rank < group;
+        if (mpi_io.enabled) {
+            /* every rank reads its own frame and writes its result at its offset, rank 0 records the times of all */
+            struct frame_metrics_times_struct times;
+            if (!rank) {
+                frame_pacer_wait(&pacer, f*size + group - 1);
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+            times.start = frame_metrics_now();
+            frame_mpi_io_read(&mpi_io, f*size + rank, active, original_frame);
+            times.ingested = frame_metrics_now();
+            if (active) {
+                rsa_encrypt_frame(original_frame, pixels, (uint64_t) f*size + rank, &rsa_components, encrypted_frame);
+            }
+            times.computed = frame_metrics_now();
+            frame_mpi_io_write(&mpi_io, f*size + rank, active, encrypted_frame);
+            times.written = frame_metrics_now();
+            frame_mpi_io_record(&mpi_io, &metrics, &pacer, f*size, group, &times);
+            continue;
         }
         
+        /* rank 0 takes the frames of all nodes from the pipeline */
+        const struct frame_pipeline_slot_struct *input = (!rank) ? frame_pipeline_input(&pipeline) : NULL;
+        
         /* MPI Barrier */
         MPI_Barrier(MPI_COMM_WORLD);
         
         /* MPI Scatter */
-        MPI_Scatter(&original_buffer[f*DIM*size], DIM, MPI_UINT16_T, original_frame, DIM, MPI_UINT16_T, 0, MPI_COMM_WORLD); //Check here
+        const uint16_t *group_frames = (!rank) ? (const uint16_t *) input->data : NULL;
+        for (int r = 0; r < size; r++) {
+            scatter_counts[r] = (r < group) ? (int) pixels : 0;
+            gather_counts[r] = (r < group) ? (int) encrypted_words : 0;
+        }
+        MPI_Scatterv(group_frames, scatter_counts, scatter_offsets, MPI_UINT16_T, original_frame, scatter_counts[rank], MPI_UINT16_T, 0, MPI_COMM_WORLD);
         
-        /* encrypt a frame */     
-        rsa_encrypt_frame(original_frame, &rsa_components, encrypted_frame);
+        /* encrypt a frame */
+        if (active) {
+            rsa_encrypt_frame(original_frame, pixels, (uint64_t) f*size + rank, &rsa_components, encrypted_frame);
+        }
         
         /* MPI Gather */
-        MPI_Gather(encrypted_frame, DIM, MPI_UNSIGNED, encrypted_buffer, DIM, MPI_UNSIGNED, 0, MPI_COMM_WORLD); //Check here
+        unsigned int *encrypted_buffer = (!rank) ? (unsigned int *) frame_pipeline_output(&pipeline)->data : NULL;
+        MPI_Gatherv(encrypted_frame, gather_counts[rank], MPI_UNSIGNED, encrypted_buffer, gather_counts, gather_offsets, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
         
         /* MPI Barrier */
         MPI_Barrier(MPI_COMM_WORLD);
         
         if (!rank) {
-            /* write encrypted frame to output file */
-            fwrite(encrypted_buffer, size*DIM, sizeof(unsigned int), encrypted_f);
-      
-            /* Capture when we got finished processing frame */
-            frame_end = clock();
+            /* hand the encrypted frames to the writer */
+            frame_pipeline_computed(&pipeline);
         }
-        
     }
     
     if (!rank) {
-        exec_end = clock(); //stop counting execution time
-        printf("\nExecution Time:   %0.6lf seconds\n", (float) (exec_end - exec_start) / CLOCKS_PER_SEC);
-        printf("\nTotal Delay Time:   %0.6lf seconds\n", (float) delay);
+        if (!mpi_io.enabled) {
+            frame_pipeline_free(&pipeline);
+        }
+        frame_metrics_report(&metrics);
+        frame_pacer_report(&pacer);
+        frame_metrics_free(&metrics);
     }
     
     free(original_frame);
+    free(scatter_counts);
+    free(gather_counts);
+    free(scatter_offsets);
+    free(gather_offsets);
     free(encrypted_frame);
     rsa_free_components(&rsa_components);
 
+    if (mpi_io.enabled) {
+        frame_mpi_io_close(&mpi_io);
+    }
     if (!rank) {
-        free(original_buffer);
-        free(encrypted_buffer);
-        fclose(encrypted_f);
+        frame_source_close(&source);
+        if (!mpi_io.enabled) {
+            frame_writer_close(&encrypted_f);
+        }
     }
     
     /* Finialize MPI */
@@ -1,6 +1,6 @@
 /****************************************************************************************************************
 This file contains the source code for a RSA encryption. It was written by Zhanneta Plokhovska 
-(zhp3@pitt.edu). It encrypts raw video files (256 x 256 pixels frame size, 2 bytes per pixel).
+(zhp3@pitt.edu). It encrypts raw video files (256 x 256 pixels frame size by default, see --geometry, 2 bytes per pixel).
 ****************************************************************************************************************/
 
 /* standard c libraries */
@@ -18,146 +18,73 @@ This file contains the source code for a RSA encryption. It was written by Zhann
 /* other open source c libraries */
 #include <gmp.h>
 
-#define IMAGE_WIDTH 256
-#define IMAGE_HEIGHT 256
-#define DIM 65536 //IMAGE_WIDTH*IMAGE_HEIGHT
-
-struct rsa_components_struct {
-    mpz_t p; // prime number 1
-    mpz_t q; // prime number 2
-    mpz_t p_minus_1; // prime number 1
-    mpz_t q_minus_1; // prime number 2
-    mpz_t n; // n = p * q
-    mpz_t phi; // phi = (p - 1) * (q - 1), must not share factor with e
-    mpz_t e; // 2 < e < phi
-    mpz_t d; // (d * e) % phi = 1
-};
-
-/********************************************************
-This function performs encryption. It accepts encrypted 
-frame and rsa parameters. Each uint16_t in the frame is 
-ciphered using RSA algorithm. Stores output in
-encrypted_frame.
-********************************************************/
-void rsa_encrypt_frame(uint16_t *original_frame, struct rsa_components_struct *rsa_components, unsigned int *encrypted_frame)
-{
-    /* using gmp library to deal with very large numbers */
-    
-    /* initialize gmp variables */
-    mpz_t encrypted_pixel;
-    mpz_t base;
-    mpz_init(encrypted_pixel);
-    mpz_init(base);
-    
-    for (int i = 0; i < DIM; i++)
-    {
-        /* set gmp variables */
-        mpz_set_ui(encrypted_pixel, 0);
-        mpz_set_ui(base, (unsigned int ) original_frame[i]);
-        
-        /* void mpz_powm (mpz_t rop, const mpz_t base, const mpz_t exp, const mpz_t mod) */
-        /* Set rop to (base raised to exp) modulo mod. */
-        mpz_powm(encrypted_pixel, base, rsa_components->e, rsa_components->n);
-
-        /* convert back from mpz_t to uint16_t */
-        encrypted_frame[i] = (unsigned int) mpz_get_ui(encrypted_pixel);
-        
-        /* Debugging
-        if (i == 0) {
-            gmp_printf ("encrypted_pixel is an mpz %Zd\n", encrypted_pixel);
-            printf("\noriginal_frame[0] = %d\n", original_frame[i]);
-            printf("\nencrypted_frame[0] = %d\n", encrypted_frame[i]);
-        }
-        */
-    }
-    
-    /* free gmp variables */
-    mpz_clear(encrypted_pixel);
-    mpz_clear(base);
-        
-    return;
-}
-
-/********************************************************
-Used to generate rsa components needed for encryption
-and decryption. Stores output in rsa_components.
-********************************************************/
-void rsa_generate_components(struct rsa_components_struct *rsa_components) {   
-    /* for testing purposes assign rsa components statically */
-    
-    /* initialize gmp variables */
-    mpz_init(rsa_components->p);
-    mpz_init(rsa_components->q);
-    mpz_init(rsa_components->p_minus_1);
-    mpz_init(rsa_components->q_minus_1);
-    mpz_init(rsa_components->n);
-    mpz_init(rsa_components->phi);
-    mpz_init(rsa_components->e);
-    mpz_init(rsa_components->d);
-    
-    /* set/calculate gmp variables */
-    mpz_set_ui(rsa_components->p, 52223);
-    mpz_set_ui(rsa_components->q, 50833);
-    mpz_mul(rsa_components->n, rsa_components->p, rsa_components->q);
-    mpz_sub_ui(rsa_components->p_minus_1, rsa_components->p, 1);
-    mpz_sub_ui(rsa_components->q_minus_1, rsa_components->q, 1);
-    mpz_mul(rsa_components->phi, rsa_components->p_minus_1, rsa_components->q_minus_1);
-    mpz_set_ui(rsa_components->e, 7);
-    mpz_set_ui(rsa_components->d, 758442487);
-    
-    return;   
-}
-
-void rsa_free_components(struct rsa_components_struct *rsa_components) {   
-    
-    /* clear gmp variables */
-    mpz_clear(rsa_components->p);
-    mpz_clear(rsa_components->q);
-    mpz_clear(rsa_components->p_minus_1);
-    mpz_clear(rsa_components->q_minus_1);
-    mpz_clear(rsa_components->n);
-    mpz_clear(rsa_components->phi);
-    mpz_clear(rsa_components->e);
-    mpz_clear(rsa_components->d);
-    
-    return;   
-}
+/* shared project sources */
+#include "cli_options.h"
+#include "frame_geometry.h"
+#include "frame_metrics.h"
+#include "frame_pacer.h"
+#include "frame_pipeline.h"
+#include "frame_schedule.h"
+#include "frame_source.h"
+#include "frame_writer.h"
+#include "rsa_components.h"
+#include "thread_placement.h"
 
 /* 
-    ./program num_of_frames filename.raw framerate(optional)
+    ./program num_of_frames|all filename.raw framerate(optional) [--geometry=WxH] [--depth=bits]
+              [--rsa-key=path] [--rsa-key-out=path] [--rsa-bits=N] [--rsa-mode=direct|hybrid]
+              [--rsa-backend=auto|gmp|native] [--rsa-crt=auto|on|off] [--rsa-kernels=auto|avx2|scalar]
+              [--chacha20-kernels=auto|avx2|sse2|scalar] [--rsa-window=auto|N] [--rsa-plan=auto|on|off]
+              [--rsa-encrypt-table=on|off] [--rsa-decrypt-index=on|off] [--rsa-gmp-arena=on|off]
+              [--omp-frames=N] [--omp-chunk=pixels] [--omp-schedule=static|dynamic|guided]
+              [--placement=spread|compact|none] [--pacing=realtime|fast|Nx] [--metrics-json=path] [--metrics-csv=path]
+              [--input=mmap|read] [--input-ring=N] [--pipeline=on|off] [--pipeline-depth=N]
+              [--writer=auto|uring|thread] [--writer-direct=on|off] [--writer-depth=N] [--writer-block=bytes]
 */
 int main(int argc, char **argv)
 {
     char original_filename[50];
     float frame_freq;
-    uint16_t *original_buffer;
-    unsigned int *encrypted_buffer;
     struct rsa_components_struct rsa_components;
-    clock_t exec_start, exec_end, frame_start, frame_end;
-    float delay;
-	int frames;
-    FILE *original_f;
-	FILE *encrypted_f;
-    
-    /* Get number of threads */
-    int num_of_threads = omp_get_num_threads();
-    printf("\nNumber of threads: %d\n", num_of_threads);
+    struct frame_pacer_struct pacer; // deadlines of the incoming frames
+    struct frame_metrics_struct metrics; // wall clock stage times of every frame
+	long frames;
+	struct frame_writer_struct encrypted_f;
      
+    /* --geometry=WxH and --depth=bits, everything else is positional */
+    argc = cli_options_parse(argc, argv);
+    struct frame_geometry_struct geometry;
+    frame_geometry_from_options(&geometry);
+    const size_t pixels = geometry.pixels;
+    
     if (argc < 3) {
-        printf("\nError: Invalid arguments. Please run the program as follows: ./program num_of_frames filename.raw framerate(optional)\n");
+        printf("\nError: Invalid arguments. Please run the program as follows: ./program num_of_frames|all filename.raw framerate(optional) [--geometry=WxH] [--depth=bits]\n"
+               "              [--rsa-key=path] [--rsa-key-out=path] [--rsa-bits=N] [--rsa-mode=direct|hybrid]\n"
+               "              [--rsa-backend=auto|gmp|native] [--rsa-crt=auto|on|off] [--rsa-kernels=auto|avx2|scalar]\n"
+               "              [--chacha20-kernels=auto|avx2|sse2|scalar] [--rsa-window=auto|N] [--rsa-plan=auto|on|off]\n"
+               "              [--rsa-encrypt-table=on|off] [--rsa-decrypt-index=on|off] [--rsa-gmp-arena=on|off]\n"
+               "              [--omp-frames=N] [--omp-chunk=pixels] [--omp-schedule=static|dynamic|guided]\n"
+               "              [--placement=spread|compact|none] [--pacing=realtime|fast|Nx] [--metrics-json=path] [--metrics-csv=path]\n"
+               "              [--input=mmap|read] [--input-ring=N] [--pipeline=on|off] [--pipeline-depth=N]\n"
+               "              [--writer=auto|uring|thread] [--writer-direct=on|off] [--writer-depth=N] [--writer-block=bytes]\n");
         exit(0);
     }
     
-    frames = atoi(argv[1]);
-    
     printf("\nReading input arguments...\n");
     
-    printf("\nFrame count = %d\n", frames);
-
     strcpy(original_filename, argv[2]);
     
     printf("\nVideo filename = %s\n", original_filename);
+    frame_geometry_print(&geometry);
+
+    /* the pipeline saves the cpus of the process before the threads are pinned */
+    struct frame_pipeline_struct pipeline; // reader, compute and writer stages
+    frame_pipeline_from_options(&pipeline);
 
+    /* pin the OpenMP threads before anything touches the buffers */
+    struct thread_placement_struct placement;
+    thread_placement_from_options(&placement);
+    thread_placement_print(&placement);
     
     if (argc == 4) {
         frame_freq = (float) 1.0/atof(argv[3]); //optionally user can provide his own framerate
@@ -166,108 +93,106 @@ int main(int argc, char **argv)
         frame_freq = (float) 1.0/30.0; //default frame rate is 30 frames/sec
     }   
     
-    printf("\nFrame frequency = %f sec\n", frame_freq);    
+    printf("\nFrame frequency = %f sec\n", frame_freq);
+    frame_pacer_from_options(&pacer, frame_freq);
+    frame_pacer_print(&pacer);
+    frame_metrics_from_options(&metrics, pixels);
+    frame_pipeline_print(&pipeline);
     
-    /* open original file */
+    /* map the original file, frames are paged in as they are encrypted */
     printf("\nOpening original video file...\n");
-    original_f = fopen(original_filename, "r");
-    if (original_f == NULL) {
-        printf("\nError: Pointer to original_f is NULL.\n");
-        exit(1);
+    struct frame_source_struct source;
+    frame_source_open(&source, original_filename, 0, geometry.frame_bytes);
+    frame_source_print(&source);
+    frames = frame_source_count(&source, argv[1]);
+    printf("\nFrame count = %ld\n", frames);
+  
+    /* generate p, q, n, phi, e, and d for RSA encryption and decryption */
+    rsa_generate_components(&rsa_components, geometry.depth);
+    rsa_print_components(&rsa_components);
+    const size_t encrypted_words = rsa_encrypted_frame_words(&rsa_components, pixels);
+
+    /* frames in flight across the threads, split into parts when there are fewer frames than threads */
+    struct frame_schedule_struct schedule;
+    frame_schedule_from_options(&schedule, pixels, rsa_frame_part_pixels(&rsa_components));
+    frame_schedule_print(&schedule);
+
+    /* open encrypted file */
+    printf("\nOpening output file...\n");
+    frame_writer_open(&encrypted_f, "encrypted.raw");
+    frame_writer_print(&encrypted_f);
+    
+    /* hybrid mode: the session key, wrapped with the RSA key, goes first */
+    const size_t header_words = rsa_stream_header_words(&rsa_components);
+    if (header_words > 0) {
+        unsigned int *header = (unsigned int*)malloc(sizeof(unsigned int)*header_words);
+        rsa_begin_stream(&rsa_components, header);
+        frame_writer_write(&encrypted_f, header, sizeof(unsigned int)*header_words);
+        free(header);
     }
     
-    /* calculate filesize, number of frames, and identify start and end pointers */
-    printf("\nCalculating filesize, number of frames, and identifying start and end pointers...\n");
-    //printf("\nPointer of original_f = %p\n", original_f);
-    long int position;
-    fseek(original_f, 0, SEEK_END); //seek the end of file
-    long const int filesize = ftell(original_f); //get the size of the file
-    position = ftell(original_f);
-    //printf("\nOffset of original_f pointer (end) = %ld\n", position);
-    rewind(original_f); //set position back to beginning    
-    position = ftell(original_f);
-    //printf("\nOffset of original_f pointer (start) = %ld \n", position);
-  
-    /* allocate memory for buffer to hold original video file */
+    /* batches of frames in flight go through the pipeline, see frame_pipeline.h */
     printf("\nAllocating memory for buffers...\n");
-    original_buffer = (uint16_t*)malloc(sizeof(uint16_t)*(filesize));
-    if (original_buffer == NULL) {
-        printf("Memory could not be allocated for the 16-bit original_buffer\n");
-        exit(1);
-    }
-    encrypted_buffer = (unsigned int*)malloc(sizeof(unsigned int)*num_of_threads*DIM); // number of frames =  number of nodes
-    if (encrypted_buffer == NULL) {
-        printf("Memory could not be allocated for the 32-bit encrypted_buffer\n");
-        exit(1);
+    frame_pipeline_init(&pipeline, &source, &pacer, &metrics, &encrypted_f, frames, schedule.frames, sizeof(unsigned int)*encrypted_words);
+
+    /* place the pages of every frame in flight on the memory node of the thread that encrypts it */
+    for (long s = 0; s < pipeline.reads.capacity && pipeline.threaded; s++) {
+        frame_schedule_first_touch(&schedule, schedule.frames, pipeline.reads.slots[s].data, sizeof(uint16_t)*pixels);
     }
-    
-    /* read original file into original_buffer */
-    printf("\nReading original_f...\n");
-    fread(original_buffer, sizeof(uint16_t), filesize, original_f);
-    //printf("\nOffset of original_f pointer (after reading) = %p\n", original_f);    
-    fclose(original_f);
-    
-    /* open encrypted file */
-    printf("\nOpening output file...\n");
-    encrypted_f = fopen("encrypted.raw", "w");
-    if (encrypted_f == NULL) {
-        printf("\nError: Pointer to encrypted_f is NULL.\n");
-        exit(1);
+    for (long s = 0; s < pipeline.writes.capacity; s++) {
+        frame_schedule_first_touch(&schedule, schedule.frames, pipeline.writes.slots[s].data, sizeof(unsigned int)*encrypted_words);
     }
     
+    /* every option has been read, a misspelt one is an error */
+    cli_options_check_used();
+
     /* variables for calculating execution time and controlling frame rate */
     printf("\nStarting operations on original_f...\n");
-    exec_start = clock(); //start counting execution time
-    frame_start = clock();
-    frame_end = frame_start;
+    frame_pacer_start(&pacer);
+    frame_metrics_start(&metrics);
+    frame_pipeline_run(&pipeline);
 
-    delay = 0.0;
-    
     printf("\nEncrypting...\n");
-
-    /* generate p, q, n, phi, e, and d for RSA encryption and decryption */
-    rsa_generate_components(&rsa_components);
-    
-    /* cycle through frames in original_buffer and perform operations on individual frames */
-	for (int f = 0; f < frames/num_of_threads; f++) {
-        /* Wait until next frame is available based on frame rate (frame_freq)*/
-        clock_t current_time = clock();
-        while ((((float) (current_time - frame_start) / CLOCKS_PER_SEC)) <  num_of_threads*frame_freq) {
-            //printf("\nTime passed:   %0.6lf seconds\n", (float) (current_time - frame_start) / CLOCKS_PER_SEC);
-            //printf("."); //Waiting on the next frame...\n");
-            current_time = clock();
-        };        
-        
-        frame_start = clock();
-        delay = delay + (((float) (frame_end - frame_start) / CLOCKS_PER_SEC));
-
-        int i;
-        #pragma omp parallel shared(num_of_threads, original_buffer, rsa_components, encrypted_buffer, f, DIM) private(i)
-        {
-            #pragma omp for
-            for(i = 0; i < num_of_threads; i++) {
-                /* encrypt a frame */     
-                rsa_encrypt_frame(&original_buffer[f*DIM*num_of_threads+i], &rsa_components, &encrypted_buffer[i]);
-            }
+    thread_placement_start(&placement);
+    
+    /* cycle through the frames of the original file and perform operations on batches of frames in flight */
+    const struct frame_pipeline_slot_struct *input;
+    while ((input = frame_pipeline_input(&pipeline)) != NULL) {
+        struct frame_schedule_batch_struct batch;
+        frame_schedule_batch(&schedule, input->count, &batch);
+        long f = input->first;
+        const uint16_t *batch_frames = (const uint16_t *) input->data;
+        unsigned int *encrypted_buffer = (unsigned int *) frame_pipeline_output(&pipeline)->data;
+
+        /* every work item is a part of one frame of the batch, whole frames when there are enough of them */
+        long items = (long) frame_schedule_items(&batch);
+        #pragma omp parallel for schedule(runtime) shared(schedule, batch, batch_frames, rsa_components, encrypted_buffer, f, pixels, encrypted_words)
+        for (long item = 0; item < items; item++) {
+            int i;
+            size_t first, count;
+            frame_schedule_item(&schedule, &batch, (size_t) item, &i, &first, &count);
+
+            /* encrypt a part of a frame */
+            rsa_encrypt_frame_part(&batch_frames[(size_t) i*pixels], pixels, first, count, (uint64_t) (f+i),
+                                   &rsa_components, &encrypted_buffer[i*encrypted_words]);
+            thread_placement_count(&placement, count);
         }
         
-        /* write encrypted frame to output file */
-        fwrite(encrypted_buffer, num_of_threads*DIM, sizeof(unsigned int), encrypted_f);
-      
-        /* Capture when we got finished processing frame */
-        frame_end = clock();
-        
+        /* hand the encrypted frames to the writer */
+        frame_pipeline_computed(&pipeline);
     }
+    frame_pipeline_free(&pipeline);
     
-    exec_end = clock(); //stop counting execution time
-    printf("\nExecution Time:   %0.6lf seconds\n", (float) (exec_end - exec_start) / CLOCKS_PER_SEC);
-    printf("\nTotal Delay Time:   %0.6lf seconds\n", (float) delay);
+    frame_metrics_report(&metrics);
+    frame_pacer_report(&pacer);
+    thread_placement_report(&placement, pixels);
     
     rsa_free_components(&rsa_components);
+    frame_metrics_free(&metrics);
+    thread_placement_free(&placement);
 
-    free(original_buffer);
-    free(encrypted_buffer);
-    fclose(encrypted_f);
+    frame_source_close(&source);
+    frame_writer_close(&encrypted_f);
     
     return 0;
 }
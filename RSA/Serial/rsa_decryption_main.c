@@ -1,6 +1,6 @@
 /****************************************************************************************************************
 This file contains the source code for a RSA decryption. It was written by Zhanneta Plokhovska 
-(zhp3@pitt.edu). It decrypts raw video files (256 x 256 pixels frame size, 4 bytes per pixel).
+(zhp3@pitt.edu). It decrypts raw video files (256 x 256 pixels frame size by default, see --geometry, 4 bytes per pixel).
 ****************************************************************************************************************/
 
 /* standard c libraries */
@@ -15,239 +15,136 @@ This file contains the source code for a RSA decryption. It was written by Zhann
 /* other open source c libraries */
 #include <gmp.h>
 
-#define IMAGE_WIDTH 256
-#define IMAGE_HEIGHT 256
-#define DIM 65536 //IMAGE_WIDTH*IMAGE_HEIGHT
-
-struct rsa_components_struct {
-    mpz_t p; // prime number 1
-    mpz_t q; // prime number 2
-    mpz_t p_minus_1; // prime number 1
-    mpz_t q_minus_1; // prime number 2
-    mpz_t n; // n = p * q
-    mpz_t phi; // phi = (p - 1) * (q - 1), must not share factor with e
-    mpz_t e; // 2 < e < phi
-    mpz_t d; // (d * e) % phi = 1
-};
-
-/********************************************************
-This function performs decryption. It accepts encrypted 
-frame and rsa parameters. Each uint16_t in the frame is 
-deciphered using RSA algorithm. Stores output in
-decrypted_frame.
-********************************************************/
-void rsa_decrypt_frame(unsigned int *encrypted_frame, struct rsa_components_struct *rsa_components, uint16_t *decrypted_frame)
-{
-    /* using gmp library to deal with very large numbers */
-    
-    /* initialize gmp variables */
-    mpz_t dencrypted_pixel;
-    mpz_t base;
-    mpz_init(dencrypted_pixel);
-    mpz_init(base);
-    
-    for (int i = 0; i < DIM; i++)
-    {
-        /* set gmp variables */
-        mpz_set_ui(base, (unsigned int ) encrypted_frame[i]);
-        
-        /* void mpz_powm (mpz_t rop, const mpz_t base, const mpz_t exp, const mpz_t mod) */
-        /* Set rop to (base raised to exp) modulo mod. */
-        mpz_powm(dencrypted_pixel, base, rsa_components->d, rsa_components->n);
-
-        /* convert back from mpz_t to uint16_t */
-        decrypted_frame[i] = (uint16_t) mpz_get_ui(dencrypted_pixel);
-        
-        /* Debugging
-        if (i == 0) {
-            printf("\nencrypted_frame[0] = %d\n", encrypted_frame[i]);
-            printf("\nencrypted_frame[0] = %d\n", decrypted_frame[i]);
-        }
-        */
-    }
-    
-    /* free gmp variables */
-    mpz_clear(dencrypted_pixel);
-    mpz_clear(base);
-        
-    return;
-}
-
-/********************************************************
-Used to generate rsa components needed for encryption
-and decryption. Stores output in rsa_components.
-********************************************************/
-void rsa_generate_components(struct rsa_components_struct *rsa_components) {   
-    /* for testing purposes assign rsa components statically */
-    
-    /* initialize gmp variables */
-    mpz_init(rsa_components->p);
-    mpz_init(rsa_components->q);
-    mpz_init(rsa_components->p_minus_1);
-    mpz_init(rsa_components->q_minus_1);
-    mpz_init(rsa_components->n);
-    mpz_init(rsa_components->phi);
-    mpz_init(rsa_components->e);
-    mpz_init(rsa_components->d);
-    
-    /* set/calculate gmp variables */
-    mpz_set_ui(rsa_components->p, 52223);
-    mpz_set_ui(rsa_components->q, 50833);
-    mpz_mul(rsa_components->n, rsa_components->p, rsa_components->q);
-    mpz_sub_ui(rsa_components->p_minus_1, rsa_components->p, 1);
-    mpz_sub_ui(rsa_components->q_minus_1, rsa_components->q, 1);
-    mpz_mul(rsa_components->phi, rsa_components->p_minus_1, rsa_components->q_minus_1);
-    mpz_set_ui(rsa_components->e, 7);
-    mpz_set_ui(rsa_components->d, 758442487);
-    
-    return;   
-}
-
-void rsa_free_components(struct rsa_components_struct *rsa_components) {   
-    
-    /* clear gmp variables */
-    mpz_clear(rsa_components->p);
-    mpz_clear(rsa_components->q);
-    mpz_clear(rsa_components->p_minus_1);
-    mpz_clear(rsa_components->q_minus_1);
-    mpz_clear(rsa_components->n);
-    mpz_clear(rsa_components->phi);
-    mpz_clear(rsa_components->e);
-    mpz_clear(rsa_components->d);
-    
-    return;   
-}
+/* shared project sources */
+#include "cli_options.h"
+#include "frame_geometry.h"
+#include "frame_metrics.h"
+#include "frame_pacer.h"
+#include "frame_pipeline.h"
+#include "frame_source.h"
+#include "frame_writer.h"
+#include "rsa_components.h"
 
 /* 
-    ./program filename.raw framerate(optional)
+    ./program filename.raw framerate(optional) [--geometry=WxH] [--depth=bits]
+              [--rsa-key=path] [--rsa-key-out=path] [--rsa-bits=N] [--rsa-mode=direct|hybrid]
+              [--rsa-backend=auto|gmp|native] [--rsa-crt=auto|on|off] [--rsa-kernels=auto|avx2|scalar]
+              [--chacha20-kernels=auto|avx2|sse2|scalar] [--rsa-window=auto|N] [--rsa-plan=auto|on|off]
+              [--rsa-encrypt-table=on|off] [--rsa-decrypt-index=on|off] [--rsa-gmp-arena=on|off]
+              [--pacing=realtime|fast|Nx] [--metrics-json=path] [--metrics-csv=path]
+              [--input=mmap|read] [--input-ring=N] [--pipeline=on|off] [--pipeline-depth=N]
+              [--writer=auto|uring|thread] [--writer-direct=on|off] [--writer-depth=N] [--writer-block=bytes]
 */
 int main(int argc, char **argv)
 {
     char original_filename[50];
     float frame_freq = (float) 1.0/30.0; //default frame rate is 30 frames/sec
+    struct frame_pacer_struct pacer; // deadlines of the incoming frames
+    struct frame_metrics_struct metrics; // wall clock stage times of every frame
     
     printf("\nReading input arguments...\n");
     
+    /* --geometry=WxH and --depth=bits, everything else is positional */
+    argc = cli_options_parse(argc, argv);
+    struct frame_geometry_struct geometry;
+    frame_geometry_from_options(&geometry);
+    const size_t pixels = geometry.pixels;
+    
     if (argc < 2) {
-        printf("\nError: Invalid arguments. Please run the program as follows: ./program filename.raw\n");
+        printf("\nError: Invalid arguments. Please run the program as follows: ./program filename.raw framerate(optional) [--geometry=WxH] [--depth=bits]\n"
+               "              [--rsa-key=path] [--rsa-key-out=path] [--rsa-bits=N] [--rsa-mode=direct|hybrid]\n"
+               "              [--rsa-backend=auto|gmp|native] [--rsa-crt=auto|on|off] [--rsa-kernels=auto|avx2|scalar]\n"
+               "              [--chacha20-kernels=auto|avx2|sse2|scalar] [--rsa-window=auto|N] [--rsa-plan=auto|on|off]\n"
+               "              [--rsa-encrypt-table=on|off] [--rsa-decrypt-index=on|off] [--rsa-gmp-arena=on|off]\n"
+               "              [--pacing=realtime|fast|Nx] [--metrics-json=path] [--metrics-csv=path]\n"
+               "              [--input=mmap|read] [--input-ring=N] [--pipeline=on|off] [--pipeline-depth=N]\n"
+               "              [--writer=auto|uring|thread] [--writer-direct=on|off] [--writer-depth=N] [--writer-block=bytes]\n");
         exit(0);
     }
         
     strcpy(original_filename, argv[1]);
     
     printf("\nVideo filename = %s\n", original_filename);
+    frame_geometry_print(&geometry);
 
     
     if (argc > 2) {
         frame_freq = (float) 1.0/atof(argv[2]); //optionally user can provide his own framerate
     }
     
-    printf("\nFrame frequency = %f sec\n", frame_freq);    
+    printf("\nFrame frequency = %f sec\n", frame_freq);
+    frame_pacer_from_options(&pacer, frame_freq);
+    frame_pacer_print(&pacer);
+    frame_metrics_from_options(&metrics, pixels);
+    struct frame_pipeline_struct pipeline; // reader, compute and writer stages
+    frame_pipeline_from_options(&pipeline);
+    frame_pipeline_print(&pipeline);
     
     char decrypted_filename[50] = "decrypted.raw";
     
     /* declare file variables */
-	FILE *original_f;
-	FILE *decrypted_f;
-    
-    /* open original file */
-	printf("\nOpening original video file...\n");
-	original_f = fopen(original_filename, "r");
-	if (original_f == NULL) {
-		printf("\nError: Pointer to original_f is NULL.\n");
-        exit(1);
-	}
-    
-	/* calculate filesize, number of frames, and identify start and end pointers */
-    printf("\nCalculating filesize, number of frames, and identifying start and end pointers...\n");
-    //printf("\nPointer of original_f = %p\n", original_f);
-	long int position;
-    fseek(original_f, 0, SEEK_END); //seek the end of file
-	long const int filesize = ftell(original_f); //get the size of the file
-	int frames = filesize/(DIM*4);
-	printf("\nFrame count = %d\n", frames);
-	position = ftell(original_f);
-	//printf("\nOffset of original_f pointer (end) = %ld\n", position);
-	rewind(original_f); //set position back to beginning    
-    position = ftell(original_f);
-	//printf("\nOffset of original_f pointer (start) = %ld \n", position);
-    
-    /* allocate memory for buffer to hold original video file */
-    printf("\nAllocating memory for buffers...\n");
-    unsigned int *original_buffer;
-	original_buffer = (unsigned int*)malloc(sizeof(unsigned int)*(filesize));
-	if (original_buffer == NULL) {
-		printf("Memory could not be allocated for the 16-bit original_buffer\n");
-		exit(1);
-	}
-    
-    /* read original file into original_buffer */
-	printf("\nReading original_f...\n");
-	fread(original_buffer, sizeof(unsigned int), filesize, original_f);
-	//printf("\nOffset of original_f pointer (after reading) = %p\n", original_f);    
-    fclose(original_f);
+	struct frame_writer_struct decrypted_f;
     
     /* generate p, q, n, phi, e, and d for RSA encryption and decryption */
     struct rsa_components_struct rsa_components;
-    rsa_generate_components(&rsa_components);
+    rsa_generate_components(&rsa_components, geometry.depth);
+    rsa_print_components(&rsa_components);
+    const size_t encrypted_words = rsa_encrypted_frame_words(&rsa_components, pixels);
+    const size_t header_words = rsa_stream_header_words(&rsa_components);
+    
+    /* map the encrypted file, frames are paged in as they are decrypted */
+    printf("\nOpening original video file...\n");
+    struct frame_source_struct source;
+    frame_source_open(&source, original_filename, header_words*sizeof(unsigned int), encrypted_words*sizeof(unsigned int));
+    frame_source_print(&source);
+    long frames = source.frames;
+    printf("\nFrame count = %ld\n", frames);
+    
+    /* hybrid mode: unwrap the session key of the stream header */
+    rsa_open_stream(&rsa_components, (const unsigned int *) frame_source_header(&source));
     
     /* open decrypted file */
     printf("\nOpening output file...\n");
-	decrypted_f = fopen(decrypted_filename, "w");
-	if (decrypted_f == NULL) {
-		printf("\nError: Pointer to decrypted_f is NULL.\n");
-        exit(1);
-	}
+    frame_writer_open(&decrypted_f, decrypted_filename);
+    frame_writer_print(&decrypted_f);
+    
+    /* frames are read, decrypted and written one at a time */
+    frame_pipeline_init(&pipeline, &source, &pacer, &metrics, &decrypted_f, frames, 1, sizeof(uint16_t)*pixels);
     
+    /* every option has been read, a misspelt one is an error */
+    cli_options_check_used();
+
     /* variables for calculating execution time and controlling frame rate */
-    clock_t exec_start, exec_end, frame_start, frame_end;
     printf("\nStarting operations on original_f...\n");
-    exec_start = clock(); //start counting execution time
-    frame_start = clock();
-    frame_end = frame_start;
-    
-    float delay = 0.0;
-    
-    /* cycle through frames in original_buffer and perform operations on individual frames */
-	for (int f = 0; f < frames; f++) {
-        /* Wait until next frame is available based on frame rate (frame_freq)*/
-        clock_t current_time = clock();
-        printf("\nExecution Time:   %0.6lf seconds\n", (float) current_time/CLOCKS_PER_SEC);
-        while ((((float) (current_time - frame_start) / CLOCKS_PER_SEC)) <  frame_freq) {
-            //printf("\nTime passed:   %0.6lf seconds\n", (float) (current_time - frame_start) / CLOCKS_PER_SEC);
-            //printf("."); //Waiting on the next frame...\n");
-            current_time = clock();
-        };        
-        
-        frame_start = clock();
-        delay = delay + (((float) (frame_end - frame_start) / CLOCKS_PER_SEC));
-        
-        printf("\nFrame number = %d\n", f);
-        unsigned int *original_frame = &original_buffer[f*DIM];
+    frame_pacer_start(&pacer);
+    frame_metrics_start(&metrics);
+    frame_pipeline_run(&pipeline);
+    
+    /* cycle through the frames of the encrypted file and perform operations on individual frames */
+    const struct frame_pipeline_slot_struct *input;
+    while ((input = frame_pipeline_input(&pipeline)) != NULL) {
+        long f = input->first;
+        printf("\nFrame number = %ld\n", f);
+        const unsigned int *original_frame = (const unsigned int *) input->data;
         
         /* decrypt a frame */
         printf("\nDecrypting...\n");
-        uint16_t *decrypted_frame;
-        decrypted_frame = (uint16_t*)malloc(sizeof(uint16_t)*DIM);
-        rsa_decrypt_frame(original_frame, &rsa_components, decrypted_frame);
-
-        /* write decrypted frame to output file */
-        fwrite(decrypted_frame, DIM, sizeof(uint16_t), decrypted_f);
-        
-        free(decrypted_frame);
+        struct frame_pipeline_slot_struct *output = frame_pipeline_output(&pipeline);
+        rsa_decrypt_frame(original_frame, pixels, f, &rsa_components, (uint16_t *) output->data);
         
-        /* Capture when we got finished processing frame */
-        frame_end = clock();
+        /* hand the decrypted frame to the writer */
+        frame_pipeline_computed(&pipeline);
     }
+    frame_pipeline_free(&pipeline);
     
-    exec_end = clock(); //stop counting execution time
-    printf("\nExecution Time:   %0.6lf seconds\n", (float) (exec_end - exec_start) / CLOCKS_PER_SEC);
-    printf("\nTotal Delay Time:   %0.6lf seconds\n", (float) delay);
+    frame_metrics_report(&metrics);
+    frame_pacer_report(&pacer);
     
     rsa_free_components(&rsa_components);
-    free(original_buffer);
+    frame_metrics_free(&metrics);
+    frame_source_close(&source);
     
-    fclose(decrypted_f);
+    frame_writer_close(&decrypted_f);
     
     return 0;
 }